@@ -0,0 +1,274 @@
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include "md5.h"
+#include "hasher.h"
+#include "md5_multi.h"
+#include "file.h"
+#include "searcher.h"
+#include "tree_generator.h"
+
+namespace fs = std::filesystem;
+
+//===========================================================
+//generated trees live in temporary directory until the end of process
+class BenchTrees
+{
+public:
+    static BenchTrees& Get() {
+        static BenchTrees trees;
+        return trees;
+    }
+
+    fl::TreeOptions& Options() {
+        return m_options;
+    }
+
+    //tree made by options given in command line
+    const std::string& Tree() {
+        if (m_tree.empty()) {
+            m_tree = (m_root / "tree").string();
+            auto stats = fl::GenerateTree(m_tree, m_options);
+            std::cerr << "Generated " << stats.files << " files (" << stats.bytes << " bytes): "
+                      << stats.unique << " unique, " << stats.dups << " copies, "
+                      << stats.hardlinks << " hardlinks, " << stats.collisions << " collisions\n";
+        }
+        return m_tree;
+    }
+
+    //single file of given size
+    std::string SizedFile(std::size_t size) {
+        const auto path = m_root / ("file_" + std::to_string(size));
+        if (!fs::exists(path)) {
+            fl::TreeOptions options;
+            options.files = 1;
+            options.dirs = 1;
+            options.min_size = size;
+            options.max_size = size;
+            fl::GenerateTree((m_root / "sized").string(), options);
+            fs::rename(m_root / "sized" / "d0" / "f0", path);
+        }
+        return path.string();
+    }
+
+private:
+    BenchTrees() : m_root(fs::temp_directory_path() / ("dups_bench_" + std::to_string(::getpid()))) {
+        fs::create_directories(m_root);
+    }
+
+    ~BenchTrees() {
+        std::error_code ec;
+        fs::remove_all(m_root, ec);
+    }
+
+    fs::path            m_root;
+    fl::TreeOptions     m_options;
+    std::string         m_tree;
+};
+
+//===========================================================
+static void BM_MD5Add(benchmark::State& state) {
+    std::vector<char> buf(static_cast<std::size_t>(state.range(0)), 'x');
+    MD5 md5;
+    for (auto _ : state) {
+        md5.add(buf.data(), buf.size());
+    }
+    benchmark::DoNotOptimize(md5.getHash());
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_MD5Add)->RangeMultiplier(8)->Range(64, 1 << 20);
+
+static void BM_HasherAdd(benchmark::State& state) {
+    const auto kind = static_cast<fl::HashKind>(state.range(0));
+    std::vector<char> buf(1 << 20, 'x');
+    auto hasher = fl::Hasher::Create(kind);
+    for (auto _ : state) {
+        hasher->Add(buf.data(), buf.size());
+    }
+    benchmark::DoNotOptimize(hasher->GetHash());
+    state.SetLabel(fl::HashKindName(kind));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * buf.size()));
+}
+BENCHMARK(BM_HasherAdd)->DenseRange(static_cast<int>(fl::HashKind::XXH3), static_cast<int>(fl::HashKind::SHA256));
+
+//multi-buffer MD5, argument is kernel. Bytes of all lanes are counted
+static void BM_MultiMD5(benchmark::State& state) {
+    const auto kernel = static_cast<fl::MultiMD5::Kernel>(state.range(0));
+    if (!fl::MultiMD5::IsSupported(kernel)) {
+        state.SkipWithError("kernel is not supported by CPU");
+        return;
+    }
+    const auto lanes = fl::MultiMD5::LanesOf(kernel);
+    std::vector<std::vector<char>> bufs(lanes, std::vector<char>(1 << 20, 'x'));
+    std::vector<const void*> ptrs;
+    for (const auto& b : bufs) {
+        ptrs.push_back(b.data());
+    }
+    fl::MultiMD5 md5(lanes, kernel);
+    for (auto _ : state) {
+        md5.Add(ptrs.data(), bufs[0].size());
+    }
+    benchmark::DoNotOptimize(md5.GetHashes());
+    state.SetLabel(fl::MultiMD5::KernelName(kernel));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * lanes * bufs[0].size()));
+}
+BENCHMARK(BM_MultiMD5)->DenseRange(static_cast<int>(fl::MultiMD5::Kernel::Scalar), static_cast<int>(fl::MultiMD5::Kernel::AVX512));
+
+//read and hash file from page cache, new File every time so nothing is memoized
+static void BM_FileGetHashSum(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto path = BenchTrees::Get().SizedFile(size);
+    for (auto _ : state) {
+        fl::File f(path);
+        benchmark::DoNotOptimize(f.GetHashSum());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * size));
+}
+BENCHMARK(BM_FileGetHashSum)->RangeMultiplier(16)->Range(4 << 10, 64 << 20)->Unit(benchmark::kMicrosecond);
+
+static void BM_GroupBySize(benchmark::State& state) {
+    fl::DupsSearcher ds;
+    ds.SetRecursive(true);
+    const auto content = ds.GetDirectoryContent(BenchTrees::Get().Tree());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ds.GroupBySize(content));
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * content.size()));
+}
+BENCHMARK(BM_GroupBySize);
+
+//subdirectory d0 of tree against d1, argument is number of jobs
+static void BM_GetDuplicatedPairs(benchmark::State& state) {
+    fl::DupsSearcher ds(static_cast<std::size_t>(state.range(0)));
+    const auto& tree = BenchTrees::Get().Tree();
+    std::size_t pairs = 0;
+    for (auto _ : state) {
+        //fresh files without calculated hashes
+        state.PauseTiming();
+        auto d0 = ds.GetDirectoryContent(tree + "/d0");
+        auto d1 = ds.GetDirectoryContent(tree + "/d1");
+        state.ResumeTiming();
+
+        auto grouped = ds.GroupBySize(d0);
+        pairs = ds.GetDuplicatedPairs(d1, grouped).size();
+    }
+    state.counters["pairs"] = static_cast<double>(pairs);
+}
+BENCHMARK(BM_GetDuplicatedPairs)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond);
+
+//argument is number of jobs
+static void BM_Traversal(benchmark::State& state) {
+    fl::DupsSearcher ds(static_cast<std::size_t>(state.range(0)));
+    ds.SetRecursive(true);
+    const auto& tree = BenchTrees::Get().Tree();
+    std::size_t files = 0;
+    for (auto _ : state) {
+        files = ds.GetDirectoryContent(tree).size();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * files));
+}
+BENCHMARK(BM_Traversal)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond);
+
+//===========================================================
+static void PrintUsage() {
+    std::cerr << "Usage: dups_bench [BENCHMARK OPTIONS] [TREE OPTIONS]\n"
+              << "       dups_bench --generate DIR [TREE OPTIONS]\n"
+              << "Tree options:\n"
+              << "  --files=N             number of files (default 1000)\n"
+              << "  --dirs=N              number of subdirectories (default 2)\n"
+              << "  --min-size=BYTES      (default 1)\n"
+              << "  --max-size=BYTES      (default 262144)\n"
+              << "  --uniform             uniform sizes instead of log-uniform\n"
+              << "  --dup-ratio=R         share of copies (default 0.2)\n"
+              << "  --hardlink-ratio=R    share of hardlinks (default 0.05)\n"
+              << "  --collision-ratio=R   share of same size files with other content (default 0.1)\n"
+              << "  --seed=N              (default 1)\n";
+}
+
+//options left after benchmark::Initialize
+static bool ParseTreeOptions(int argc, char** argv, fl::TreeOptions& options, std::string& generate_dir) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg{ argv[i] };
+        const auto eq = arg.find('=');
+        const auto name = arg.substr(0, eq);
+        const auto value = eq != std::string::npos ? arg.substr(eq + 1) : std::string{};
+
+        try {
+            if (name == "--generate" && i + 1 < argc) {
+                generate_dir = argv[++i];
+            }
+            else if (name == "--files") {
+                options.files = std::stoull(value);
+            }
+            else if (name == "--dirs") {
+                options.dirs = std::stoull(value);
+            }
+            else if (name == "--min-size") {
+                options.min_size = std::stoull(value);
+            }
+            else if (name == "--max-size") {
+                options.max_size = std::stoull(value);
+            }
+            else if (name == "--uniform") {
+                options.distribution = fl::TreeOptions::SizeDistribution::Uniform;
+            }
+            else if (name == "--dup-ratio") {
+                options.dup_ratio = std::stod(value);
+            }
+            else if (name == "--hardlink-ratio") {
+                options.hardlink_ratio = std::stod(value);
+            }
+            else if (name == "--collision-ratio") {
+                options.collision_ratio = std::stod(value);
+            }
+            else if (name == "--seed") {
+                options.seed = std::stoull(value);
+            }
+            else {
+                std::cerr << "Unknown option: " << arg << "\n";
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Invalid value: " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+
+    std::string generate_dir;
+    auto& options = BenchTrees::Get().Options();
+    if (!ParseTreeOptions(argc, argv, options, generate_dir)) {
+        PrintUsage();
+        return 1;
+    }
+
+    //just make tree for manual runs of dups
+    if (!generate_dir.empty()) {
+        try {
+            auto stats = fl::GenerateTree(generate_dir, options);
+            std::cout << stats.files << " files, " << stats.bytes << " bytes\n";
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "tree_generator.h"
+
+namespace fs = std::filesystem;
+
+namespace fl {
+
+namespace {
+
+    //splitmix64: tiny, fast and identical on every platform, unlike std distributions
+    class Random
+    {
+    public:
+        explicit Random(std::uint64_t seed) : m_state(seed) {}
+
+        std::uint64_t Next() {
+            std::uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        //[0, n)
+        std::uint64_t Below(std::uint64_t n) {
+            return n != 0 ? Next() % n : 0;
+        }
+
+        //[0, 1)
+        double Real() {
+            return static_cast<double>(Next() >> 11) / static_cast<double>(1ULL << 53);
+        }
+
+    private:
+        std::uint64_t   m_state;
+    };
+
+    //content is defined by its seed, so copies and collisions are generated without keeping data
+    struct Content
+    {
+        std::size_t     size{ 0 };
+        std::uint64_t   seed{ 0 };
+        std::size_t     flip_pos{ SIZE_MAX };   //byte inverted to make collision, SIZE_MAX - none
+    };
+
+    std::size_t RandomSize(Random& rnd, const TreeOptions& options) {
+        const auto lo = std::max<std::size_t>(options.min_size, 1);
+        const auto hi = std::max(options.max_size, lo);
+        if (options.distribution == TreeOptions::SizeDistribution::Uniform) {
+            return lo + rnd.Below(hi - lo + 1);
+        }
+        const auto llo = std::log2(static_cast<double>(lo));
+        const auto lhi = std::log2(static_cast<double>(hi));
+        const auto size = static_cast<std::size_t>(std::exp2(llo + (lhi - llo) * rnd.Real()));
+        return std::clamp(size, lo, hi);
+    }
+
+    void WriteContent(const fs::path& path, const Content& c) {
+        std::vector<char> buf(c.size);
+        Random rnd(c.seed);
+        for (std::size_t i = 0; i < buf.size(); i += sizeof(std::uint64_t)) {
+            const auto v = rnd.Next();
+            std::copy_n(reinterpret_cast<const char*>(&v), std::min(sizeof(v), buf.size() - i), buf.data() + i);
+        }
+        if (c.flip_pos < buf.size()) {
+            buf[c.flip_pos] = static_cast<char>(~buf[c.flip_pos]);
+        }
+
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        if (!ofs) {
+            throw fs::filesystem_error("Cannot write file", path, std::make_error_code(std::errc::io_error));
+        }
+    }
+
+}
+
+TreeStats GenerateTree(const std::string& root, const TreeOptions& options) {
+    Random rnd(options.seed);
+    TreeStats stats;
+
+    const auto dirs = std::max<std::size_t>(options.dirs, 1);
+    for (std::size_t d = 0; d < dirs; ++d) {
+        fs::create_directories(fs::path(root) / ("d" + std::to_string(d)));
+    }
+
+    std::vector<Content> contents;  //unique contents written so far
+    std::vector<fs::path> paths;    //the first file of every content
+    for (std::size_t i = 0; i < options.files; ++i) {
+        const auto path = fs::path(root) / ("d" + std::to_string(rnd.Below(dirs))) / ("f" + std::to_string(i));
+        if (fs::exists(path)) {
+            fs::remove(path);
+        }
+
+        const auto r = rnd.Real();
+        const auto src = static_cast<std::size_t>(rnd.Below(contents.size()));
+        if (!contents.empty() && r < options.hardlink_ratio) {
+            fs::create_hard_link(paths[src], path);
+            ++stats.hardlinks;
+        }
+        else if (!contents.empty() && r < options.hardlink_ratio + options.dup_ratio) {
+            WriteContent(path, contents[src]);
+            stats.bytes += contents[src].size;
+            ++stats.dups;
+        }
+        else {
+            Content c;
+            c.seed = rnd.Next();
+            if (!contents.empty() && r < options.hardlink_ratio + options.dup_ratio + options.collision_ratio) {
+                //the same size and mostly the same bytes, so only full comparison can tell the difference
+                c = contents[src];
+                c.flip_pos = static_cast<std::size_t>(rnd.Below(c.size));
+                ++stats.collisions;
+            }
+            else {
+                c.size = RandomSize(rnd, options);
+                ++stats.unique;
+            }
+            WriteContent(path, c);
+            stats.bytes += c.size;
+            contents.push_back(c);
+            paths.push_back(path);
+        }
+        ++stats.files;
+    }
+
+    return stats;
+}
+
+}
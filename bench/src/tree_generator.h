@@ -0,0 +1,46 @@
+#ifndef __TREE_GENERATOR_H__
+#define __TREE_GENERATOR_H__
+
+#include <string>
+#include <cstdint>
+
+namespace fl {
+
+//settings of synthetic directory tree. The same settings always give the same tree
+struct TreeOptions
+{
+    enum class SizeDistribution
+    {
+        Uniform,        //sizes uniformly distributed in [min_size, max_size]
+        LogUniform      //every power of two is equally likely: many small files, few big ones
+    };
+
+    std::size_t         files{ 1000 };              //total number of files including copies and links
+    std::size_t         dirs{ 2 };                  //files are spread over subdirectories d0, d1, ...
+    std::size_t         min_size{ 1 };
+    std::size_t         max_size{ 256 * 1024 };
+    SizeDistribution    distribution{ SizeDistribution::LogUniform };
+    double              dup_ratio{ 0.2 };           //share of files which are copies of another file
+    double              hardlink_ratio{ 0.05 };     //share of files which are hardlinks to another file
+    double              collision_ratio{ 0.1 };     //share of files with size of another file but different content
+    std::uint64_t       seed{ 1 };
+};
+
+//what was really generated
+struct TreeStats
+{
+    std::size_t     files{ 0 };
+    std::size_t     unique{ 0 };
+    std::size_t     dups{ 0 };
+    std::size_t     hardlinks{ 0 };
+    std::size_t     collisions{ 0 };
+    std::uint64_t   bytes{ 0 };     //bytes on disk, hardlinks are not counted
+};
+
+//create tree in root directory (it is created if doesn't exist, existing files are overwritten).
+//Throws std::filesystem::filesystem_error on failure
+TreeStats GenerateTree(const std::string& root, const TreeOptions& options);
+
+}
+
+#endif // ! __TREE_GENERATOR_H__
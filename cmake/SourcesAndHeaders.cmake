@@ -1,7 +1,32 @@
 set(sources
     src/md5.cpp
+    src/sha256.cpp
+    src/hasher.cpp
+    src/digest.cpp
+    src/path_pool.cpp
     src/file.cpp
+    src/file_stamp.cpp
+    src/file_reader.cpp
+    src/hash_cache.cpp
     src/searcher.cpp
+    src/thread_pool.cpp
+    src/dir_walker.cpp
+    src/result_writer.cpp
+    src/stats.cpp
+    src/byte_comparer.cpp
+    src/io_uring_ring.cpp
+    src/batch_hasher.cpp
+    src/page_cache.cpp
+    src/md5_multi.cpp
+    src/multi_hasher.cpp
+    src/dir_index.cpp
+    src/live_index.cpp
+    src/spill_file.cpp
+    src/external_searcher.cpp
+    src/io_scheduler.cpp
+    src/extent_map.cpp
+    src/search_budget.cpp
+    src/block_sampler.cpp
 )
 
 set(exe_sources
@@ -10,10 +35,51 @@ set(exe_sources
 )
 
 set(headers
+    include/digest.h
+    include/path_pool.h
     include/file.h
+    include/file_stamp.h
+    include/file_reader.h
+    include/hash_cache.h
+    include/hasher.h
     include/searcher.h
+    include/thread_pool.h
+    include/dir_walker.h
+    include/result_writer.h
+    include/stats.h
+    include/byte_comparer.h
+    include/batch_hasher.h
+    include/md5_multi.h
+    include/multi_hasher.h
+    include/dir_index.h
+    include/live_index.h
+    include/external_searcher.h
+    include/io_scheduler.h
+    include/extent_map.h
+    include/search_budget.h
+    include/block_sampler.h
 )
 
 set(test_sources
     src/file_test.cpp
+    src/searcher_test.cpp
+    src/hasher_test.cpp
+    src/hash_cache_test.cpp
+    src/result_writer_test.cpp
+    src/stats_test.cpp
+    src/byte_comparer_test.cpp
+    src/batch_hasher_test.cpp
+    src/multi_hasher_test.cpp
+    src/dir_index_test.cpp
+    src/live_index_test.cpp
+    src/external_searcher_test.cpp
+    src/io_scheduler_test.cpp
+    src/extent_map_test.cpp
+    src/search_budget_test.cpp
+    src/block_sampler_test.cpp
+)
+
+set(bench_sources
+    src/tree_generator.cpp
+    src/dups_bench.cpp
 )
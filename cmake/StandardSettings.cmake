@@ -19,6 +19,12 @@ option(${PROJECT_NAME}_WARNINGS_AS_ERRORS "Treat compiler warnings as errors." O
 option(${PROJECT_NAME}_ENABLE_UNIT_TESTING "Enable unit tests for the projects (from the `test` subfolder)." OFF)
 option(${PROJECT_NAME}_USE_GTEST "Use the GoogleTest project for creating unit tests." ON)
 
+#
+# Benchmarks
+#
+
+option(${PROJECT_NAME}_ENABLE_BENCHMARKS "Build the `${PROJECT_NAME}_bench` target (from the `bench` subfolder), requires Google Benchmark." OFF)
+
 #
 # Static analyzers
 #
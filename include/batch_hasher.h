@@ -0,0 +1,62 @@
+#ifndef __BATCH_HASHER_H__
+#define __BATCH_HASHER_H__
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "file.h"
+
+namespace fl {
+
+class IoUringRing;
+class SearchBudget;
+
+//Calculates hashes of many files at once by io_uring: reads of several files are in flight together
+//and completed blocks are passed to hashers in order of their offsets.
+//Read buffers are allocated and registered in kernel once for all files.
+//Files which cannot be read this way (no io_uring in kernel, errors, file is changed) are hashed by File itself.
+//Object is used by one thread.
+class BatchHasher
+{
+public:
+    using Callback = std::function<void(const fl::File*)>;
+
+    //buffer_size, queue_depth and page cache settings of options are used.
+    //Direct cache mode is not supported by the ring, such files are read by File
+    explicit BatchHasher(const ReadOptions& options);
+    ~BatchHasher();
+
+    BatchHasher(const BatchHasher&) = delete;
+    BatchHasher& operator=(const BatchHasher&) = delete;
+
+    //io_uring is available, otherwise files are read by pread one by one
+    bool IsAsync() const;
+
+    //number of files read at once, not more than queue depth (default). One file keeps reads of rotational
+    //device in order of files
+    void SetMaxFiles(std::size_t max_files);
+
+    //calculate full or sample hashes of files. on_done is called for every file when its hash is known
+    //(or file is found not valid). Once budget is stopped, files being read are abandoned and the rest
+    //is not read: they are passed to on_done without hash
+    void Run(const std::vector<const fl::File*>& files, bool full, const Callback& on_done = nullptr,
+             const SearchBudget* budget = nullptr);
+
+private:
+    struct Job;
+
+    //hash file in usual way
+    static void CalcSync(const fl::File* f, bool full, const SearchBudget* budget);
+
+    ReadOptions                     m_options;
+    std::size_t                     m_block_size;
+    std::size_t                     m_depth;
+    std::size_t                     m_max_files;
+    std::unique_ptr<IoUringRing>    m_ring;
+    char*                           m_buffers{ nullptr };
+};
+
+}
+
+#endif // ! __BATCH_HASHER_H__
@@ -0,0 +1,47 @@
+#ifndef __BLOCK_SAMPLER_H__
+#define __BLOCK_SAMPLER_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "file.h"
+
+namespace fl {
+
+//Fingerprint of big file: hash of blocks at offsets spread across the file.
+//Offsets depend only on file size, so files of the same size are sampled at the same places in every run.
+//File is split into BlocksNum() equal strata, every stratum gives one block at pseudo random page aligned
+//offset inside it. Number of blocks grows by 8 with every doubling of size, up to MaxBlocks:
+//file of the smallest sampled size gives 8 blocks (512 KiB), files 128 times bigger give 64 blocks (4 MiB).
+//Files with different fingerprints differ, files with the same one still need full hash.
+class BlockSampler
+{
+public:
+    static constexpr std::size_t BlockSize = 64 * 1024;
+    static constexpr std::size_t MaxBlocks = 64;
+
+    //min_size - the smallest sampled file, 0 - sampling is off
+    explicit BlockSampler(std::uint64_t min_size) : m_min_size(min_size) {}
+
+    bool IsSampled(std::uint64_t size) const {
+        return m_min_size != 0 && size >= m_min_size && size >= 2 * BlockSize;
+    }
+
+    //0 if file of this size is not sampled
+    std::size_t BlocksNum(std::uint64_t size) const;
+
+    //ascending offsets of blocks
+    std::vector<std::uint64_t> Offsets(std::uint64_t size) const;
+
+    //hash of blocks of file by algorithm of File::GetHashKind() read with File::GetReadOptions().
+    //Empty if file is not sampled or can't be read entirely
+    Digest Hash(const fl::File& file) const;
+
+private:
+    std::uint64_t   m_min_size;
+};
+
+}
+
+#endif // ! __BLOCK_SAMPLER_H__
@@ -0,0 +1,61 @@
+#ifndef __BYTE_COMPARER_H__
+#define __BYTE_COMPARER_H__
+
+#include <vector>
+#include <functional>
+
+#include "file.h"
+
+namespace fl {
+
+class SearchBudget;
+
+//Splits files of the same size into groups of byte-identical content without hashing.
+//All files of a group are read block by block in lockstep and the group is split as soon as
+//their blocks differ, so reading stops at the first difference and files left alone are closed at once.
+//Groups bigger than the limit of open files are pre-split by hashes of blocks, files are opened one by one
+//for that. Results are always confirmed by exact comparison.
+class ByteComparer
+{
+public:
+    struct Options
+    {
+        std::size_t     block_size{ 64 * 1024 };
+        std::size_t     max_open_files{ 256 };  //not less than 2
+        //comparison stops between blocks once budget is stopped (deadline is passed or search is cancelled)
+        const SearchBudget* budget{ nullptr };
+    };
+
+    //indexes of files in the list passed to Split, ascending
+    using Group = std::vector<std::size_t>;
+    //return false if group is not interesting even if its files are identical, it is dropped at once.
+    //Filter can accept a single file (e.g. it stands for several links), such group is returned without reading.
+    //By default all groups of two and more files are interesting
+    using GroupFilter = std::function<bool(const Group&)>;
+
+    explicit ByteComparer(const Options& options, GroupFilter filter = nullptr);
+
+    //files must have the same size. Files which cannot be read are skipped.
+    //Return groups of identical files accepted by filter, groups are ordered by their first file.
+    //If budget stops the comparison, no groups are returned and stopped is set
+    std::vector<Group> Split(const std::vector<const fl::File*>& files, bool* stopped = nullptr) const;
+
+private:
+    bool Keep(const Group& group) const;
+    bool IsStopped() const;
+
+    //exact comparison of group which fits the limit of open files.
+    //Groups rejected by keep are dropped, the rest are put into res
+    void Lockstep(const std::vector<const fl::File*>& files, const Group& group,
+                  const GroupFilter& keep, std::vector<Group>& res) const;
+
+    //exact comparison of group which doesn't fit the limit: first file against batches of other files
+    void CompareWithFirst(const std::vector<const fl::File*>& files, Group group, std::vector<Group>& res) const;
+
+    Options         m_options;
+    GroupFilter     m_filter;
+};
+
+}
+
+#endif // ! __BYTE_COMPARER_H__
@@ -0,0 +1,63 @@
+#ifndef __DIGEST_H__
+#define __DIGEST_H__
+
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+namespace fl {
+
+//result of hash calculation stored as raw bytes (without heap allocation).
+//Size depends on algorithm, the longest one is sha256
+struct Digest
+{
+    static constexpr std::size_t MaxSize = 32;
+
+    std::array<std::uint8_t, MaxSize>   bytes{};
+    std::uint8_t                        size{ 0 };
+
+    Digest() = default;
+    Digest(const void* data, std::size_t data_size);
+
+    //not calculated yet
+    bool empty() const {
+        return size == 0;
+    }
+
+    void clear() {
+        *this = Digest{};
+    }
+
+    //lower case hex string
+    std::string ToHex() const;
+
+    bool operator==(const Digest& other) const {
+        return size == other.size && std::memcmp(bytes.data(), other.bytes.data(), size) == 0;
+    }
+
+    bool operator!=(const Digest& other) const {
+        return !(*this == other);
+    }
+
+    bool operator<(const Digest& other) const {
+        if (size != other.size) {
+            return size < other.size;
+        }
+        return std::memcmp(bytes.data(), other.bytes.data(), size) < 0;
+    }
+};
+
+//for unordered containers. Digest is already a good hash, just take its beginning
+struct DigestHash
+{
+    std::size_t operator()(const Digest& d) const {
+        std::size_t res = 0;
+        std::memcpy(&res, d.bytes.data(), sizeof(res));
+        return res ^ d.size;
+    }
+};
+
+}
+
+#endif // ! __DIGEST_H__
@@ -0,0 +1,90 @@
+#ifndef __DIR_INDEX_H__
+#define __DIR_INDEX_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+#include "file.h"
+
+namespace fl {
+
+//Binary snapshot of directory tree: paths, sizes, inode ids, mtimes and digests of its files.
+//File is written once by Write and then mapped into memory as is, nothing is parsed on loading.
+//Layout (host byte order):
+//  header (64 bytes): "DUPSIDX1", version, hash kind, sample size, number of entries, offsets of entries and names
+//  entries (128 bytes each): sorted by size, then by path, so files of given size are found by binary search
+//  names: paths relative to root of snapshot, root itself is the first name
+//Snapshot is valid only for the hash algorithm and sample size it is made with.
+class DirIndex
+{
+public:
+    DirIndex() = default;
+    ~DirIndex();
+
+    DirIndex(const DirIndex&) = delete;
+    DirIndex& operator=(const DirIndex&) = delete;
+
+    //write snapshot of content of root directory atomically (via temporary file and rename).
+    //Files must have full and sample hashes calculated with current File settings, invalid files are skipped
+    static bool Write(const std::string& path, const std::string& root, const std::vector<fl::File>& content);
+
+    //file starts with snapshot signature
+    static bool IsSnapshot(const std::string& path);
+
+    //map snapshot. Return false if file can't be read, is damaged or of other version
+    bool Load(const std::string& path);
+
+    bool IsLoaded() const {
+        return m_data != nullptr;
+    }
+
+    const std::string& GetRoot() const {
+        return m_root;
+    }
+    HashKind GetHashKind() const;
+    std::size_t GetSampleSize() const;
+    //number of files
+    std::size_t Size() const;
+
+    //different sizes of files in ascending order, all entries are read
+    std::vector<std::uint64_t> Sizes() const;
+
+    //positions [first, last) of entries of files with given size
+    std::pair<std::size_t, std::size_t> EqualRange(std::uint64_t size) const;
+
+    //files of given ranges of entries with stamps and hashes of snapshot, file system is not touched.
+    //Paths are root of snapshot joined with relative paths
+    std::vector<fl::File> GetFiles(const std::vector<std::pair<std::size_t, std::size_t>>& ranges) const;
+
+private:
+    struct Header;
+    struct Entry;
+
+    const Header* GetHeader() const;
+    const Entry* GetEntries() const;
+
+    void Unload();
+
+    const char*     m_data{ nullptr };
+    std::size_t     m_size{ 0 };
+    std::string     m_root;
+};
+
+//input of search: live directory content or snapshot
+struct SearchInput
+{
+    std::unique_ptr<DirIndex>   index;      //nullptr for directory
+    std::vector<fl::File>       content;    //content of directory or selected files of snapshot
+};
+
+//fill content of snapshot inputs by files which size can give clusters present in at least min_dirs inputs.
+//Content of directory inputs must be filled already. Only the smallest inputs are scanned by size,
+//sizes are looked up in other snapshots by binary search, so big snapshots are touched only in a few pages
+void JoinSnapshots(std::vector<SearchInput>& inputs, std::size_t min_dirs);
+
+}
+
+#endif // ! __DIR_INDEX_H__
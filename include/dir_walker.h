@@ -0,0 +1,119 @@
+#ifndef __DIR_WALKER_H__
+#define __DIR_WALKER_H__
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <utility>
+#include <functional>
+#include <exception>
+
+#include "file.h"
+
+namespace fl {
+
+//Collect regular files of directory tree.
+//Subdirectories are scanned by several threads, idle thread steals directories from queues of others.
+//Subdirectory is opened relative to descriptor of its parent (openat), so the kernel doesn't resolve
+//the whole path again for every directory.
+//Every directory is scanned once even if it is reachable by several paths (bind mounts, symlinks).
+class DirWalker
+{
+public:
+    struct Options
+    {
+        //number of threads (0 - all available cores)
+        std::size_t     jobs{ 1 };
+        //scan subdirectories
+        bool            recursive{ true };
+        //go into symlinks to directories
+        bool            follow_symlinks{ true };
+    };
+
+    //files of one directory
+    using FilesCallback = std::function<void(std::vector<fl::File>&& files)>;
+
+    explicit DirWalker(const Options& options) : m_options(options) {}
+
+    //List of valid regular files. Throw std::filesystem::filesystem_error if root can't be opened.
+    //Errors in subdirectories are ignored.
+    std::vector<fl::File> Walk(const std::string& root);
+
+    //The same, but files are passed to on_files right after scanning of their directory, nothing is kept.
+    //on_files is called concurrently if jobs != 1
+    void Walk(const std::string& root, const FilesCallback& on_files);
+
+private:
+    //descriptor of scanned directory, kept open while its subdirectories wait in queues
+    class DirFd
+    {
+    public:
+        DirFd(int fd, std::atomic<std::size_t>& open_num);
+        ~DirFd();
+
+        DirFd(const DirFd&) = delete;
+        DirFd& operator=(const DirFd&) = delete;
+
+        int Get() const {
+            return m_fd;
+        }
+
+    private:
+        int                         m_fd;
+        std::atomic<std::size_t>&   m_open_num;
+    };
+
+    struct PendingDir
+    {
+        //nullptr - open by full path
+        std::shared_ptr<const DirFd>    parent;
+        std::string                     path;
+        //position of the last component in path
+        std::size_t                     name_pos{ 0 };
+    };
+
+    struct WorkQueue
+    {
+        std::mutex                  mutex;
+        std::deque<PendingDir>      dirs;
+    };
+
+    void WorkerLoop(std::size_t worker);
+    bool PopDir(std::size_t worker, PendingDir& dir);
+    bool HasDirs();
+    void PushDir(std::size_t worker, PendingDir dir);
+    void ScanDir(std::size_t worker, const PendingDir& dir);
+    //open directory relative to its parent if it is possible
+    int OpenDir(const PendingDir& dir) const;
+    //wake up idle workers: there is new directory or nothing left
+    void Notify(bool all);
+    //return false if directory has been already visited
+    bool MarkVisited(int dir_fd);
+
+    Options                                     m_options;
+    FilesCallback                               m_on_files;
+    std::vector<WorkQueue>                      m_queues;
+    std::vector<std::vector<fl::File>>          m_found;
+    //number of directories in queues or being scanned
+    std::atomic<std::size_t>                    m_pending{ 0 };
+    //idle workers wait for new directories or for the end of walk
+    std::mutex                                  m_idle_mutex;
+    std::condition_variable                     m_idle_cv;
+    //descriptors of directories kept for their subdirectories
+    std::atomic<std::size_t>                    m_open_dirs{ 0 };
+    //the first exception of on_files stops all workers
+    std::atomic<bool>                           m_failed{ false };
+    std::exception_ptr                          m_error;
+
+    std::mutex                                  m_visited_mutex;
+    std::set<std::pair<std::uint64_t, std::uint64_t>>   m_visited;
+};
+
+}
+
+#endif // ! __DIR_WALKER_H__
@@ -0,0 +1,19 @@
+#ifndef __EXTENT_MAP_H__
+#define __EXTENT_MAP_H__
+
+#include <string>
+
+#include "digest.h"
+
+namespace fl {
+
+//Key of physical layout of file content, taken by FIEMAP.
+//Files with the same key are the same data on disk (reflinks on btrfs, XFS), so they are equal without reading.
+//Key covers device, size and every extent (logical and physical offset, length). It is empty if file system
+//doesn't report extents, if some extent is not shared or if its place doesn't identify data: delayed
+//allocation, inline, compressed or encrypted extents
+Digest SharedExtentsKey(const std::string& file_path);
+
+}
+
+#endif // ! __EXTENT_MAP_H__
@@ -0,0 +1,47 @@
+#ifndef __EXTERNAL_SEARCHER_H__
+#define __EXTERNAL_SEARCHER_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "searcher.h"
+
+namespace fl {
+
+//Search of clusters in trees which files don't fit into memory.
+//Scanned files become fixed size records (size, inode, stamp, path id) collected into sorted by size
+//runs in temporary files, paths go to one more temporary file. Runs are merged by size and only
+//size buckets which can give clusters are loaded as Files and passed to DupsSearcher by batches.
+//Memory is bounded by max_memory except a single size bucket bigger than a quarter of it
+//(it is searched at once).
+class ExternalSearcher
+{
+public:
+    //the least budget, smaller values are raised to it
+    static constexpr std::size_t MinMemory = 64 * 1024;
+
+    //scanning, hashing and compare mode are taken from searcher, temporary files are put into spill_dir
+    ExternalSearcher(DupsSearcher& searcher, std::size_t max_memory, std::string spill_dir);
+
+    //clusters of files of dirs, see DupsSearcher::GetDuplicatedClusters. Order of clusters is not defined.
+    //Throw std::filesystem::filesystem_error for wrong directory, std::system_error for failed temporary file
+    void GetDuplicatedClusters(const std::vector<std::string>& dirs, std::size_t min_dirs,
+                               const DupsSearcher::ClusterCallback& on_cluster);
+
+    //number of sorted runs written by the last search (including runs of intermediate merges)
+    std::size_t GetRunsNum() const {
+        return m_runs_num;
+    }
+
+private:
+    DupsSearcher&   m_searcher;
+    std::size_t     m_max_memory;
+    std::string     m_spill_dir;
+    std::size_t     m_runs_num{ 0 };
+};
+
+}
+
+#endif // ! __EXTERNAL_SEARCHER_H__
@@ -4,6 +4,13 @@
 
 #include <string>
 
+#include "hasher.h"
+#include "digest.h"
+#include "path_pool.h"
+#include "file_reader.h"
+#include "file_stamp.h"
+#include "hash_cache.h"
+
 namespace fl {
 
 //represents a regular file in file system
@@ -11,8 +18,11 @@ class File
 {
 public:
     File() = default;   //default for containers
-    //one file - one file path
+    //one file - one file path. Attributes are taken by one stat call
     explicit File(const std::string& str);
+    //file with already known attributes (from directory scanning), no file system calls
+    File(const std::string& str, const FileStamp& stamp);
+    File(PathRef path, const FileStamp& stamp);
 
     File(File&& f);
     File& operator=(File&& f);
@@ -22,25 +32,76 @@ public:
 
     //size of file
     std::size_t GetFileSize() const;
-    //hash sum
-    const std::string& GetHashSum() const;
+    //hash sum. Reading stopped by budget (deadline, cancellation) leaves file valid without hash
+    const Digest& GetHashSum(const SearchBudget* budget = nullptr) const;
+    //hash sum of the first and the last GetSampleSize() bytes of file.
+    //Cheap pre-filter: files with different sample hashes can't be the same.
+    //For small files (not more than two samples) it is the hash of whole file and it equals GetHashSum()
+    const Digest& GetSampleHashSum(const SearchBudget* budget = nullptr) const;
+    //hash sum is already calculated (GetHashSum() doesn't read file)
+    bool HasHashSum() const {
+        return !m_hash_val.empty();
+    }
+    //sample hash is already calculated (GetSampleHashSum() doesn't read file)
+    bool HasSampleHashSum() const {
+        return !m_sample_hash_val.empty() || (SampleIsWholeFile() && !m_hash_val.empty());
+    }
+    //sample hash is the hash of whole file, so it is calculated by GetHashSum()
+    bool SampleIsWholeFile() const;
+    //take hash from hash cache without reading file. Return true if hash is known after the call
+    bool FindCachedHashSum() const;
+    bool FindCachedSampleHashSum() const;
+    //set hash calculated by other reader of file content (batch reading), it is put into hash cache too.
+    //Does nothing if hash is already known or file is not valid
+    void SetHashSum(const Digest& hash) const;
+    void SetSampleHashSum(const Digest& hash) const;
+    //copy already calculated hashes from other object of the same file (hardlink, symlink).
+    //Does nothing and returns false if files are not the same in file system or file is changed between their stamps
+    bool TakeHashesFrom(const File& other) const;
     //check object is valid. If not other methods return invalid values
     //Object can be not valid just after construction (if file path is wrong or it is not file)
     //or when we try to calc hash.
     bool IsOk() const;
 
-    const std::string& GetFilePath() const {
-        return m_file_path;
+    //path is kept in pool of its directory, full path is built on request
+    std::string GetFilePath() const {
+        return m_path.GetPath();
+    }
+
+    //identity and change markers taken during construction
+    const FileStamp& GetStamp() const {
+        return m_stamp;
     }
 
     //static for fast checking file is valid regular file
     static bool FileIsOk(const std::string& file_path);
 
+    //size of head/tail blocks for sample hash. 0 disables sample stage.
+    //Should be set before any hash calculation.
+    static void SetSampleSize(std::size_t sample_size);
+    static std::size_t GetSampleSize();
+
+    //algorithm of sample and full hashes (xxh3 by default).
+    //Should be set before any hash calculation.
+    static void SetHashKind(HashKind kind);
+    static HashKind GetHashKind();
+
+    //buffer size and mmap usage for reading file content.
+    //Should be set before any hash calculation.
+    static void SetReadOptions(const ReadOptions& options);
+    static const ReadOptions& GetReadOptions();
+
+    //persistent storage of hashes. Hashes are taken from it if file is not changed
+    //and new calculated hashes are put into it. nullptr (default) - no cache
+    static void SetHashCache(HashCache* cache);
+    static HashCache* GetHashCache();
+
 private:
-    std::string                 m_file_path;
-    std::size_t                 m_file_size{ 0 };
+    PathRef                     m_path;
+    FileStamp                   m_stamp;
     //mutable in order to calc hash in case if really neccessary
-    mutable std::string         m_hash_val;
+    mutable Digest              m_hash_val;
+    mutable Digest              m_sample_hash_val;
     mutable bool                m_is_valid{ false };
 };
 
@@ -0,0 +1,104 @@
+#ifndef __FILE_READER_H__
+#define __FILE_READER_H__
+
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace fl {
+
+class PageCache;
+class SearchBudget;
+
+//how content of candidates is read for hashing
+enum class IoEngine
+{
+    Pread,  //blocking reads of one file by one thread
+    Uring   //many reads of many files in flight by io_uring, pread if kernel doesn't allow it
+};
+
+//what reading of content does with page cache
+enum class CacheMode
+{
+    Keep,   //pages stay in cache as usual
+    Drop,   //pages brought into cache by reading are evicted after hashing, pages cached before stay
+    Direct  //O_DIRECT reads bypass cache (Drop if file system doesn't support it)
+};
+
+//settings of reading file content
+struct ReadOptions
+{
+    //size of one read request. Buffer is aligned to page size.
+    std::size_t     buffer_size{ 1024 * 1024 };
+    //files (ranges) not smaller than this are mapped into memory instead of reading. 0 - never use mmap.
+    //SIGBUS of file truncated while it is consumed is caught and gives short read
+    std::uint64_t   mmap_threshold{ 0 };
+    IoEngine        engine{ IoEngine::Pread };
+    //reads in flight per thread for Uring engine, each needs buffer_size bytes
+    std::size_t     queue_depth{ 32 };
+    //sequential access hint on open and readahead of the next buffer while current one is hashed
+    bool            advise{ true };
+    CacheMode       cache{ CacheMode::Keep };
+    //order reads of rotational devices by physical offset and limit their concurrent readers (IoScheduler)
+    bool            schedule{ true };
+    //concurrent readers of one rotational device
+    std::size_t     rotational_jobs{ 1 };
+    //ask file system where content is: holes of sparse files (SEEK_HOLE) are hashed as zeros without reading,
+    //files sharing all extents with each other (FIEMAP, reflinks) are equal without reading
+    bool            extents{ true };
+};
+
+//Sequential reading of regular file by big buffers.
+//Content is passed to consumer by whole buffers, so consumer (hasher) is not called for every small piece.
+class FileReader
+{
+public:
+    //data is valid only inside the call. Consumer of mapped data is left by siglongjmp if file is truncated
+    //under it, so it must not hold objects with destructors (locks, allocations) while it reads data
+    using Consumer = std::function<void(const char* data, std::size_t size)>;
+
+    //special length for reading till the end of file
+    static constexpr std::uint64_t ToEnd = UINT64_MAX;
+
+    //reading stops between buffers once budget is stopped (deadline is passed or search is cancelled)
+    FileReader(const std::string& file_path, const ReadOptions& options, const SearchBudget* budget = nullptr);
+    ~FileReader();
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    bool IsOpen() const;
+
+    //read not more than length bytes starting from offset and pass them to consumer.
+    //Return number of passed bytes, it is less than length if file is shorter, in case of error or if budget is stopped
+    std::uint64_t Read(std::uint64_t offset, std::uint64_t length, const Consumer& consumer);
+
+private:
+    //data ranges are read, holes between them are passed as zeros
+    std::uint64_t ReadSparse(std::uint64_t offset, std::uint64_t length, const Consumer& consumer);
+    //read range as is by one of ways below
+    std::uint64_t ReadData(std::uint64_t offset, std::uint64_t length, const Consumer& consumer);
+    std::uint64_t ReadByBuffer(std::uint64_t offset, std::uint64_t length, const Consumer& consumer);
+    std::uint64_t ReadByMap(std::uint64_t offset, std::uint64_t length, const Consumer& consumer);
+    //O_DIRECT reading by aligned blocks, data before offset is skipped
+    std::uint64_t ReadDirect(std::uint64_t offset, std::uint64_t length, const Consumer& consumer);
+    //file system refused O_DIRECT: continue with usual reads and evict pages after them
+    void DisableDirect();
+    //budget doesn't allow to pass the next buffer
+    bool IsStopped() const;
+    //pass length zero bytes (hole) to consumer
+    std::uint64_t PassZeros(std::uint64_t length, const Consumer& consumer) const;
+
+    ReadOptions                 m_options;
+    const SearchBudget*         m_budget{ nullptr };
+    int                         m_fd{ -1 };
+    //file has less blocks than its size needs, size is taken on open
+    bool                        m_sparse{ false };
+    std::uint64_t               m_size{ 0 };
+    std::unique_ptr<PageCache>  m_cache;
+};
+
+}
+
+#endif // ! __FILE_READER_H__
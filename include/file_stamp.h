@@ -0,0 +1,54 @@
+#ifndef __FILE_STAMP_H__
+#define __FILE_STAMP_H__
+
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <functional>
+
+namespace fl {
+
+//identity of file in file system: (device, inode)
+using FileId = std::pair<std::uint64_t, std::uint64_t>;
+
+//hash of identity for unordered containers
+struct FileIdHash
+{
+    std::size_t operator()(const FileId& id) const {
+        return std::hash<std::uint64_t>()(id.first * 0x9e3779b97f4a7c15ull ^ id.second);
+    }
+};
+
+//identity of file and markers of its changes.
+//Everything we need to know about file from file system, taken by one stat call
+struct FileStamp
+{
+    std::uint64_t   dev{ 0 };
+    std::uint64_t   ino{ 0 };
+    std::uint64_t   size{ 0 };
+    std::int64_t    mtime_ns{ 0 };
+    std::int64_t    ctime_ns{ 0 };
+    //type and permissions (st_mode)
+    std::uint32_t   mode{ 0 };
+
+    bool IsRegular() const;
+    bool IsDir() const;
+
+    FileId GetId() const {
+        return FileId{ dev, ino };
+    }
+
+    //the same file in file system (hardlinks, symlinks)
+    bool SameFile(const FileStamp& other) const {
+        return dev == other.dev && ino == other.ino;
+    }
+
+    //take stamp of file from file system, symlinks are followed
+    static bool Get(const std::string& file_path, FileStamp& stamp);
+    //take stamp of entry of opened directory. Uses statx where it is available
+    static bool GetAt(int dir_fd, const char* name, bool follow_symlinks, FileStamp& stamp);
+};
+
+}
+
+#endif // ! __FILE_STAMP_H__
@@ -0,0 +1,82 @@
+#ifndef __HASH_CACHE_H__
+#define __HASH_CACHE_H__
+
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <unordered_map>
+#include <shared_mutex>
+
+#include "hasher.h"
+#include "file_stamp.h"
+#include "digest.h"
+
+namespace fl {
+
+//Persistent storage of calculated hashes between runs.
+//Hash is taken from cache only if size, mtime and ctime of file are not changed.
+//Cache is valid only for the same hash algorithm and sample size, otherwise it is ignored.
+//Every run is a generation of cache: entries looked up or stored by a run are marked by it, entries
+//not used by the last GetMaxAge() runs (deleted, replaced or not scanned files) are not saved any more.
+//All methods are thread safe.
+class HashCache
+{
+public:
+    //runs an entry is kept without use by default
+    static constexpr std::uint32_t DefaultMaxAge = 10;
+
+    HashCache(HashKind kind, std::size_t sample_size) : m_kind(kind), m_sample_size(sample_size) {}
+
+    //entries not used by this number of runs (including current one) are dropped on save, not less than 1
+    void SetMaxAge(std::uint32_t runs) {
+        m_max_age = runs != 0 ? runs : 1;
+    }
+
+    std::uint32_t GetMaxAge() const {
+        return m_max_age;
+    }
+
+    //load cache from file. Return false if file doesn't exist, is damaged or made for other settings,
+    //in this case cache is empty
+    bool Load(const std::string& path);
+    //write used and not too old entries into file atomically (via temporary file and rename).
+    //Does nothing if nothing changed and all entries are used by this run
+    bool Save(const std::string& path) const;
+
+    //return false if there is no valid hash for file
+    bool FindHash(const FileStamp& stamp, Digest& hash) const;
+    bool FindSampleHash(const FileStamp& stamp, Digest& hash) const;
+
+    void PutHash(const FileStamp& stamp, const Digest& hash);
+    void PutSampleHash(const FileStamp& stamp, const Digest& hash);
+
+    std::size_t Size() const;
+
+private:
+    struct Entry
+    {
+        FileStamp       stamp;
+        Digest          sample_hash;
+        Digest          hash;
+        //generation of the last run which used entry, marked under shared lock
+        mutable std::atomic<std::uint32_t>  used{ 0 };
+    };
+
+    const Entry* FindEntry(const FileStamp& stamp) const;
+    Entry& GetEntry(const FileStamp& stamp);
+    //entry is used by one of the last m_max_age runs
+    bool IsAlive(const Entry& e) const;
+
+    HashKind                                        m_kind;
+    std::size_t                                     m_sample_size;
+    std::uint32_t                                   m_max_age{ DefaultMaxAge };
+    //current run, the next after the one which saved loaded file
+    std::uint32_t                                   m_generation{ 1 };
+    mutable std::shared_mutex                       m_mutex;
+    std::unordered_map<FileId, Entry, FileIdHash>   m_entries;
+    bool                                            m_changed{ false };
+};
+
+}
+
+#endif // ! __HASH_CACHE_H__
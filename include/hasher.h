@@ -0,0 +1,41 @@
+#ifndef __HASHER_H__
+#define __HASHER_H__
+
+#include <string>
+#include <memory>
+
+#include "digest.h"
+
+namespace fl {
+
+//supported hash algorithms
+enum class HashKind {
+    XXH3,       //fast non-cryptographic 128-bit hash, default for candidates grouping
+    MD5,
+    SHA256
+};
+
+//streaming hash calculation with runtime selectable algorithm
+class Hasher
+{
+public:
+    virtual ~Hasher() = default;
+
+    //add next portion of data
+    virtual void Add(const void* data, std::size_t size) = 0;
+    //hash of all added data
+    virtual Digest GetHash() = 0;
+    //start new calculation
+    virtual void Reset() = 0;
+
+    static std::unique_ptr<Hasher> Create(HashKind kind);
+};
+
+//"xxh3", "md5", "sha256"
+const char* HashKindName(HashKind kind);
+//return false if name is unknown
+bool ParseHashKind(const std::string& name, HashKind& kind);
+
+}
+
+#endif // ! __HASHER_H__
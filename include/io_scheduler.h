@@ -0,0 +1,84 @@
+#ifndef __IO_SCHEDULER_H__
+#define __IO_SCHEDULER_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <functional>
+#include <unordered_set>
+
+#include "file.h"
+#include "file_reader.h"
+
+namespace fl {
+
+//Order and concurrency of reading of many files for hashing.
+//Files are grouped by device (st_dev). Rotational devices (queue/rotational in sysfs) get
+//ReadOptions::rotational_jobs concurrent readers, their files are read in order of physical offset of the
+//first extent (FIEMAP), files with the first page in page cache (preadv2 with RWF_NOWAIT) go before them.
+//Other devices (SSD, network and virtual file systems) get all threads and files keep their order:
+//there is nothing to win by probing them.
+class IoScheduler
+{
+public:
+    //what is known about place of file content
+    struct Placement
+    {
+        bool            resident{ false };          //the first page is in page cache
+        std::uint64_t   physical{ UINT64_MAX };     //offset of the first extent on device, unknown ones go last
+    };
+    //probe of file placement, called concurrently for different files
+    using Locator = std::function<Placement(const fl::File&)>;
+    //files read together by one worker, e.g. by one ring or in SIMD lanes
+    using Batch = std::vector<const fl::File*>;
+
+    //locator is Locate() by default
+    explicit IoScheduler(const ReadOptions& options, Locator locator = nullptr)
+        : m_options(options), m_locator(locator ? std::move(locator) : Locator(Locate)) {}
+
+    //files in order of reading: files of rotational devices are opened for probing by up to threads threads
+    //(it touches only metadata), devices are interleaved in order to keep all of them busy
+    std::vector<const fl::File*> Order(const std::vector<const fl::File*>& files, std::size_t threads = 1);
+
+    //call func for every file by up to threads threads, files of each device are taken in given order
+    //and not more than DeviceLimit() of them at once. Files found in page cache by Order() cost no seeks,
+    //they are not limited. The first exception of func is rethrown
+    void Run(const std::vector<const fl::File*>& files, std::size_t threads,
+             const std::function<void(const fl::File*)>& func) const;
+
+    //placement of file: its first page in page cache by preadv2 with RWF_NOWAIT, its first extent by FIEMAP
+    static Placement Locate(const fl::File& f);
+
+    //split files into batches of up to size files of one device, files found in page cache by Order()
+    //are batched apart from the rest. Batches are ordered by their first files
+    std::vector<Batch> Batches(const std::vector<const fl::File*>& files, std::size_t size) const;
+
+    //call func for every batch by up to threads threads as Run() does for files: batch belongs to the device
+    //of its first file and is not limited if all its files are found in page cache. Batches are not empty.
+    //func gets index of the worker (less than threads) for state kept between batches, e.g. a ring
+    void RunBatches(const std::vector<Batch>& batches, std::size_t threads,
+                    const std::function<void(std::size_t, const Batch&)>& func) const;
+
+    //number of concurrent readers of device
+    std::size_t DeviceLimit(std::uint64_t dev, std::size_t threads) const;
+
+    //device (st_dev) is rotational. Detected once by sysfs, unknown devices are not rotational
+    static bool IsRotational(std::uint64_t dev);
+    //override detection, e.g. for disks behind controllers which report it wrong
+    static void SetRotational(std::uint64_t dev, bool rotational);
+
+private:
+    //call func(worker, unit) for units by up to threads threads, unit is read from device of heads[unit],
+    //it is not limited if cached[unit]
+    void Dispatch(const std::vector<const fl::File*>& heads, const std::vector<bool>& cached, std::size_t threads,
+                  const std::function<void(std::size_t, std::size_t)>& func) const;
+
+    ReadOptions                             m_options;
+    Locator                                 m_locator;
+    std::unordered_set<const fl::File*>     m_resident;
+};
+
+}
+
+#endif // ! __IO_SCHEDULER_H__
@@ -0,0 +1,91 @@
+#ifndef __LIVE_INDEX_H__
+#define __LIVE_INDEX_H__
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "file.h"
+#include "searcher.h"
+
+namespace fl {
+
+//Files of several directories kept up to date by inotify events for repeated searches.
+//Directories are scanned once, after that only changed and new files are restated. Hashes live in
+//File objects between queries, so a query reads only files changed since the previous one.
+//If event queue overflows the whole input is rescanned: stamps are compared with known files
+//and hashes of unchanged files are kept. Symlinks to directories are followed by scanning but not watched.
+class LiveIndex
+{
+public:
+    //directories are scanned by searcher (recursively if it is set there)
+    LiveIndex(DupsSearcher& searcher, std::vector<std::string> dirs);
+    ~LiveIndex();
+
+    LiveIndex(const LiveIndex&) = delete;
+    LiveIndex& operator=(const LiveIndex&) = delete;
+
+    //subscribe to changes and scan all directories.
+    //Throw std::system_error if inotify is not available, std::filesystem::filesystem_error for wrong directory
+    void Build();
+
+    //descriptor to poll for readiness of events
+    int GetFd() const {
+        return m_fd;
+    }
+
+    //read and apply all queued events, wait for the first one no longer than timeout_ms
+    //(-1 - infinitely, 0 - don't wait). Return number of applied events
+    std::size_t Update(int timeout_ms = 0);
+
+    //clusters of current content, see DupsSearcher::GetDuplicatedClusters
+    void Query(std::size_t min_dirs, const DupsSearcher::ClusterCallback& on_cluster);
+    std::vector<DupsSearcher::DupsCluster> Query(std::size_t min_dirs);
+
+    const std::vector<std::vector<fl::File>>& GetContents() const {
+        return m_contents;
+    }
+
+    //number of directories rescanned after overflows, creation and moves of directories
+    std::size_t GetRescans() const {
+        return m_rescans;
+    }
+
+private:
+    struct Watch
+    {
+        std::size_t     input{ 0 };
+        std::string     dir;
+    };
+
+    using Changes = std::set<std::pair<std::size_t, std::string>>;
+
+    //watch dir and its subdirectories in recursive mode. Return false if dir itself can't be watched
+    bool AddWatches(std::size_t input, const std::string& dir);
+    void RemoveWatches(std::size_t input, const std::string& dir);
+    void HandleEvent(int wd, std::uint32_t mask, const char* name, Changes& changes);
+    //forget files under dir and scan it again, known hashes of unchanged files are kept
+    void Rescan(std::size_t input, const std::string& dir);
+    //stat file again, it is removed if it is not a regular file any more
+    void UpdateFile(std::size_t input, const std::string& path);
+    void RemoveFile(std::size_t input, const std::string& path);
+    //remove files under dir, return them by path
+    std::unordered_map<std::string, fl::File> RemoveDir(std::size_t input, const std::string& dir);
+    void Insert(std::size_t input, fl::File&& file);
+
+    DupsSearcher&                                               m_searcher;
+    std::vector<std::string>                                    m_dirs;
+    int                                                         m_fd{ -1 };
+    //one directory can be watched for several inputs
+    std::unordered_map<int, std::vector<Watch>>                 m_watches;
+    std::vector<std::vector<fl::File>>                          m_contents;
+    //position of file in content by path
+    std::vector<std::unordered_map<std::string, std::size_t>>   m_positions;
+    std::size_t                                                 m_rescans{ 0 };
+};
+
+}
+
+#endif // ! __LIVE_INDEX_H__
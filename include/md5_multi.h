@@ -0,0 +1,66 @@
+#ifndef __MD5_MULTI_H__
+#define __MD5_MULTI_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "digest.h"
+
+namespace fl {
+
+//Multi-buffer MD5: independent streams of the same length are hashed in lanes of SIMD registers.
+//Rounds of one MD5 stream depend on each other and can't be vectorized, but every lane of a vector
+//instruction can run its own stream. Digests are the same as of MD5 class.
+//Kernel is selected at runtime by CPU features.
+class MultiMD5
+{
+public:
+    enum class Kernel
+    {
+        Scalar,     //1 lane, any CPU
+        SSE2,       //4 lanes
+        AVX2,       //8 lanes
+        AVX512      //16 lanes
+    };
+
+    static constexpr std::size_t MaxLanes = 16;
+    static constexpr std::size_t BlockSize = 64;
+
+    //the widest kernel supported by CPU
+    static Kernel Best();
+    static bool IsSupported(Kernel kernel);
+    static std::size_t LanesOf(Kernel kernel);
+    //"scalar", "sse2", "avx2", "avx512"
+    static const char* KernelName(Kernel kernel);
+
+    //streams - number of streams hashed together, from 1 to LanesOf(kernel).
+    //Kernel must be supported by CPU
+    explicit MultiMD5(std::size_t streams, Kernel kernel = Best());
+
+    //add size bytes to every stream, data[i] is data of stream i
+    void Add(const void* const* data, std::size_t size);
+
+    //digests of all streams, object must be reset after it
+    std::vector<Digest> GetHashes();
+
+    void Reset();
+
+private:
+    using BlocksFunc = void (*)(std::uint32_t* state, const std::uint8_t* const* data, std::size_t blocks);
+
+    //process buffered blocks of all streams
+    void ProcessBuffer();
+
+    BlocksFunc                  m_blocks;
+    std::size_t                 m_lanes;
+    std::size_t                 m_streams;
+    std::vector<std::uint32_t>  m_state;        //a, b, c, d words by lanes
+    std::vector<std::uint8_t>   m_buffer;       //not full block of every stream
+    std::size_t                 m_buffer_size{ 0 };
+    std::uint64_t               m_num_bytes{ 0 };
+};
+
+}
+
+#endif // ! __MD5_MULTI_H__
@@ -0,0 +1,49 @@
+#ifndef __MULTI_HASHER_H__
+#define __MULTI_HASHER_H__
+
+#include <vector>
+#include <functional>
+
+#include "file.h"
+
+namespace fl {
+
+class SearchBudget;
+
+//Calculates full hashes of files of the same size together by multi-buffer MD5:
+//files are read in lockstep and their blocks are hashed by one stream of SIMD instructions, lane per file.
+//Used only for MD5, other algorithms (and CPUs without SIMD) hash files one by one.
+//Object is used by one thread.
+class MultiHasher
+{
+public:
+    using Callback = std::function<void(const fl::File*)>;
+
+    //buffer_size of options is used, files are read by FileReader with these options
+    explicit MultiHasher(const ReadOptions& options);
+
+    //number of files worth hashing together for current hash algorithm, 1 - no gain
+    static std::size_t Width();
+
+    //split files into batches of the same size on the same device, not more than Width() files in batch.
+    //Batches are ordered by their first files
+    static std::vector<std::vector<const fl::File*>> Batches(const std::vector<const fl::File*>& files);
+
+    //calculate full hashes of files. Files of the same size are hashed together by Width() files,
+    //others in usual way. on_done is called for every file when its hash is known (or file is found not valid).
+    //Once budget is stopped, files being read are abandoned and the rest is not read: they are left without hash
+    void Run(const std::vector<const fl::File*>& files, const Callback& on_done = nullptr,
+             const SearchBudget* budget = nullptr);
+
+private:
+    //files have the same size and valid, not more than Width()
+    void RunLanes(const std::vector<const fl::File*>& files, const SearchBudget* budget);
+
+    ReadOptions         m_options;
+    std::size_t         m_chunk;
+    std::vector<char>   m_buffers;  //chunk of every lane
+};
+
+}
+
+#endif // ! __MULTI_HASHER_H__
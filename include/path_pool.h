@@ -0,0 +1,65 @@
+#ifndef __PATH_POOL_H__
+#define __PATH_POOL_H__
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace fl {
+
+//Names of files of one directory kept in one buffer.
+//Files refer to it instead of keeping own copy of full path.
+//Filled during directory scanning and never changed after that.
+//Offsets are 32 bit, so one pool holds up to MaxSize bytes of names
+class PathPool
+{
+public:
+    static constexpr std::size_t MaxSize = UINT32_MAX;
+
+    explicit PathPool(std::string dir) : m_dir(std::move(dir)) {}
+
+    //name of len bytes fits into pool
+    bool CanAdd(std::size_t len) const {
+        return len <= MaxSize - m_names.size();
+    }
+
+    //append name and return its offset in buffer. Throw std::length_error if it doesn't fit
+    std::uint32_t Add(const char* name, std::size_t len);
+
+    //full path of name with given position
+    std::string GetPath(std::uint32_t offset, std::uint32_t len) const;
+
+    const std::string& GetDir() const {
+        return m_dir;
+    }
+
+private:
+    std::string     m_dir;
+    std::string     m_names;
+};
+
+//path of file - reference to name in PathPool of its directory
+class PathRef
+{
+public:
+    PathRef() = default;
+    //standalone path with its own pool
+    explicit PathRef(const std::string& path);
+    PathRef(std::shared_ptr<const PathPool> pool, std::uint32_t offset, std::uint32_t len) :
+        m_pool(std::move(pool)), m_offset(offset), m_len(len) {}
+
+    std::string GetPath() const;
+
+    bool empty() const {
+        return !m_pool;
+    }
+
+private:
+    std::shared_ptr<const PathPool>     m_pool;
+    std::uint32_t                       m_offset{ 0 };
+    std::uint32_t                       m_len{ 0 };
+};
+
+}
+
+#endif // ! __PATH_POOL_H__
@@ -0,0 +1,92 @@
+#ifndef __RESULT_WRITER_H__
+#define __RESULT_WRITER_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+
+#include "searcher.h"
+
+namespace fl {
+
+//formats of search results. Hash is empty if files were compared byte by byte or they share extents.
+//Binary stream starts with "DUPSRES1", then records in host byte order:
+//u64 file size, u8 hash size, hash bytes, u32 number of files, and for each file u32 dir index, u32 path length, path
+enum class OutputFormat
+{
+    Text,       //human readable lines
+    JSONL,      //one JSON object per cluster: {"size":N,"hash":"hex","dirs":N,"files":[{"dir":N,"path":"..."}]},
+                //already deduplicated cluster has "shared":true after "dirs".
+                //Unresolved candidates of budgeted search: {"size":N,"unresolved":true,"dirs":N,"files":[...]}
+    Nul,        //every path ends with '\0', empty path ends cluster
+    Binary      //compact records described above
+};
+
+const char* OutputFormatName(OutputFormat format);
+//"text", "jsonl", "nul", "binary"
+bool ParseOutputFormat(const std::string& name, OutputFormat& format);
+
+//userspace buffer in front of file descriptor, data goes to write(2) by big chunks
+class OutputBuffer
+{
+public:
+    static constexpr std::size_t DefaultSize = 1 << 20;
+
+    explicit OutputBuffer(int fd, std::size_t size = DefaultSize);
+    //flush the rest, errors are ignored here
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void Write(const void* data, std::size_t len);
+    void Write(const std::string& str) {
+        Write(str.data(), str.size());
+    }
+    void Write(const char* str) {
+        Write(str, std::strlen(str));
+    }
+    void Put(char c) {
+        if (m_used == m_buf.size()) {
+            Flush();
+        }
+        m_buf[m_used++] = c;
+    }
+
+    //throw std::system_error if descriptor is not writable
+    void Flush();
+
+private:
+    int                 m_fd;
+    std::vector<char>   m_buf;
+    std::size_t         m_used{ 0 };
+};
+
+//writes every cluster as soon as it is passed, in one of output formats
+class ResultWriter
+{
+public:
+    virtual ~ResultWriter() = default;
+
+    virtual void Write(const DupsSearcher::DupsCluster& cluster) = 0;
+    //group of candidates not compared by budgeted search. Only text and JSONL formats write them
+    virtual void WriteUnresolved(const std::vector<DupsSearcher::TaggedFile>&) {}
+
+    void Flush() {
+        m_out.Flush();
+    }
+
+    //pairs - text format prints pairs "file of dir 1 = file of dir 0" like two dirs mode,
+    //other formats always write clusters
+    static std::unique_ptr<ResultWriter> Create(OutputFormat format, int fd, bool pairs = false);
+
+protected:
+    explicit ResultWriter(int fd) : m_out(fd) {}
+
+    OutputBuffer    m_out;
+};
+
+}
+
+#endif // ! __RESULT_WRITER_H__
@@ -0,0 +1,73 @@
+#ifndef __SEARCH_BUDGET_H__
+#define __SEARCH_BUDGET_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace fl {
+
+//Limits of search by time and by bytes read, and its cancellation.
+//Bytes of every file are taken from budget before it is read. File bigger than the rest of bytes is refused
+//alone, smaller files are still read. Once deadline is passed, all bytes are taken or search is cancelled,
+//budget is exhausted and stays so: no file is read any more.
+//Passed deadline and cancellation also stop files being read: readers check IsStopped() between their chunks
+//and abandon the file without hash sum. Bytes taken before the limit is reached are read till the end.
+//Take(), Cancel() and getters are thread safe, Cancel() is async signal safe.
+class SearchBudget
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SearchBudget() = default;
+
+    SearchBudget(const SearchBudget&) = delete;
+    SearchBudget& operator=(const SearchBudget&) = delete;
+
+    //no reading after this point of time
+    void SetDeadline(Clock::time_point deadline) {
+        m_deadline = deadline;
+    }
+
+    //not more than bytes are read, 0 - no limit
+    void SetMaxRead(std::uint64_t bytes) {
+        m_max_read = bytes;
+    }
+
+    //stop search, files being read now are abandoned at their next chunk
+    void Cancel() {
+        m_cancelled.store(true, std::memory_order_relaxed);
+        m_exhausted.store(true, std::memory_order_relaxed);
+    }
+
+    //reserve bytes for reading of file. Return false if they don't fit the rest of bytes
+    //or budget is exhausted by this call or before it
+    bool Take(std::uint64_t bytes);
+
+    bool IsExhausted() const {
+        return m_exhausted.load(std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const {
+        return m_cancelled.load(std::memory_order_relaxed);
+    }
+
+    //deadline is passed or search is cancelled: reading of files started before must be abandoned
+    bool IsStopped() const;
+
+    //bytes reserved by successful Take() calls
+    std::uint64_t GetTaken() const {
+        return m_taken.load(std::memory_order_relaxed);
+    }
+
+private:
+    Clock::time_point               m_deadline{ Clock::time_point::max() };
+    std::uint64_t                   m_max_read{ 0 };
+    std::atomic<std::uint64_t>      m_taken{ 0 };
+    std::atomic<bool>               m_exhausted{ false };
+    std::atomic<bool>               m_cancelled{ false };
+};
+
+}
+
+#endif // ! __SEARCH_BUDGET_H__
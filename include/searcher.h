@@ -3,8 +3,10 @@
 
 #include <vector>
 #include <unordered_map>
+#include <functional>
 
 #include "file.h"
+#include "search_budget.h"
 
 namespace fl {
 
@@ -16,25 +18,208 @@ public:
     //alias for pair of two pathes
     using TheSameFailsName = std::pair<std::string, std::string>;
 
-    //alias for data type - table for relation "size" -> "files of this size"
-    using GroupedFiles = std::unordered_map<std::size_t, std::vector<fl::File>>;
+    //alias for data type - table for relation "size" -> "files of this size".
+    //Files are not copied, table refers to objects of content it is made from
+    using GroupedFiles = std::unordered_map<std::size_t, std::vector<const fl::File*>>;
+
+    //equivalence class - files with the same content from both sides.
+    //Pointers refer to objects of content and grouped files passed to search
+    struct DupsClass
+    {
+        std::vector<const fl::File*>    content_files;
+        std::vector<const fl::File*>    grouped_files;
+    };
+
+    //file with index of directory (input) it is found in
+    struct TaggedFile
+    {
+        const fl::File*     file{ nullptr };
+        std::size_t         dir_idx{ 0 };
+    };
+
+    //files with the same content found in several inputs.
+    //Files are ordered by index of input, then by position in input content
+    struct DupsCluster
+    {
+        std::vector<TaggedFile>     files;
+        std::size_t                 dirs_num{ 0 };  //number of different inputs in files
+        bool                        shared{ false };    //all files share the same extents (reflinks or links
+                                                        //to one inode), already deduplicated
+    };
+
+    //how content of files of the same size is compared in GetDuplicatedClusters
+    enum class CompareMode
+    {
+        Hash,   //sample hash, then full hash
+        Bytes   //files of size group are read in lockstep and compared byte by byte, no hashes at all
+    };
+
+    //called for every found cluster
+    using ClusterCallback = std::function<void(const DupsCluster&)>;
+    //called for every group of candidates left not compared by budgeted search
+    using UnresolvedCallback = std::function<void(const std::vector<TaggedFile>&)>;
+
+    //result of budgeted search
+    struct PartialClusters
+    {
+        std::vector<DupsCluster>                clusters;       //confirmed clusters
+        std::vector<std::vector<TaggedFile>>    unresolved;     //groups of files which can still have duplicates
+    };
 
     DupsSearcher() = default;
+    //jobs - number of threads used for hash calculation (0 - all available cores).
+    //1 means calculate hashes lazily in the caller's thread.
+    explicit DupsSearcher(std::size_t jobs) : m_jobs(jobs) {}
+
+    std::size_t GetJobs() const {
+        return m_jobs;
+    }
+
+    //scan subdirectories in GetDirectoryContent (off by default)
+    void SetRecursive(bool recursive) {
+        m_recursive = recursive;
+    }
+
+    bool IsRecursive() const {
+        return m_recursive;
+    }
+
+    void SetCompareMode(CompareMode mode) {
+        m_compare_mode = mode;
+    }
+
+    CompareMode GetCompareMode() const {
+        return m_compare_mode;
+    }
+
+    //limit of files opened at once by Bytes compare mode, shared by all threads
+    void SetMaxOpenFiles(std::size_t max_open_files) {
+        m_max_open_files = max_open_files;
+    }
+
+    std::size_t GetMaxOpenFiles() const {
+        return m_max_open_files;
+    }
+
+    //files not smaller than this are compared by blocks spread across them (BlockSampler) after sample hash
+    //and before full hash, 0 - off. Used by GetDuplicatedClusters in Hash compare mode
+    void SetBlocksMinSize(std::uint64_t min_size) {
+        m_blocks_min_size = min_size;
+    }
+
+    std::uint64_t GetBlocksMinSize() const {
+        return m_blocks_min_size;
+    }
 
-    //List of valid files from specified directory
+    //List of valid files from specified directory (and its subdirectories in recursive mode).
+    //Directories are scanned by GetJobs() threads
     std::vector<fl::File> GetDirectoryContent(const std::string& dir_path);
 
-    //group list of files by their sizes
+    //group list of files by their sizes. Content must outlive result
     GroupedFiles GroupBySize(const std::vector<fl::File>& content);
 
     //Create list of pairs of names identical files
-    //Use list of files from one directory and files grouped by size from another
-    std::vector<TheSameFailsName> GetDuplicatedPairs(const std::vector<fl::File>& content, const GroupedFiles& grouped);
+    //Use list of files from one directory and files grouped by size from another.
+    //If same_inode_pairs is specified, links to the same file (hardlinks, symlinks) are put there
+    //instead of result, their content is not compared at all
+    std::vector<TheSameFailsName> GetDuplicatedPairs(const std::vector<fl::File>& content, const GroupedFiles& grouped,
+                                                     std::vector<TheSameFailsName>* same_inode_pairs = nullptr);
+
+    //Split files having duplicates into classes of the same content.
+    //Files of every size bucket are joined by hash tables, no pairwise comparisons.
+    //Classes are ordered by the first appearance of their files in content
+    std::vector<DupsClass> GetDuplicatedClasses(const std::vector<fl::File>& content, const GroupedFiles& grouped);
 
     //Do the same but return just list of files from the first directory that has duplicates in grouped files
     std::vector<fl::File> GetDuplicatedFiles(const std::vector<fl::File>& content, const GroupedFiles& grouped);
 
+    //Find clusters of identical files among any number of inputs at once.
+    //All files go to one index tagged by input, so every cluster is found in a single pass.
+    //Only clusters of at least two files present in at least min_dirs inputs are returned
+    //(min_dirs == contents.size() means "present in all inputs"). Size and sample groups which
+    //cannot reach min_dirs inputs are dropped before the next, more expensive, hashing stage.
+    //In Bytes compare mode clusters are confirmed byte by byte and files have no hashes.
+    //Clusters are ordered by the first appearance of their files
+    std::vector<DupsCluster> GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs);
+
+    //Streaming variant of the method above: cluster is passed to on_cluster as soon as all files of its size
+    //are hashed, nothing is accumulated. Order of clusters is not defined if jobs != 1.
+    //on_cluster is never called concurrently, its exception is rethrown
+    void GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs,
+                               const ClusterCallback& on_cluster);
+
+    //The same search limited by budget: files are read only while budget has time and bytes for them.
+    //Every cluster confirmed by then is passed to on_cluster. Candidates which were not compared are passed
+    //to on_unresolved by groups of files of the same size (and sample hash, if it is known). Files of confirmed
+    //clusters are not repeated there, but unresolved file of the same size can be one more copy of them.
+    //Nothing is unresolved if budget is not exhausted by the end. Callbacks are never called concurrently
+    void GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs,
+                               SearchBudget& budget, const ClusterCallback& on_cluster,
+                               const UnresolvedCallback& on_unresolved);
+
+    //collecting variant of budgeted search, clusters are ordered as by the first method
+    PartialClusters GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs,
+                                          SearchBudget& budget);
+
+    //Calculate hash sums of all files that can be compared by the methods above:
+    //files from content with size present in grouped and files of these size groups.
+    //At first sample hashes are calculated, then full hashes only for files with matched samples.
+    //Only one file of each inode is read, other links to it get the same hashes.
+    //Size groups of links to one inode are not read at all.
+    //Hashes are calculated in parallel if jobs != 1
+    void CalcHashSums(const std::vector<fl::File>& content, const GroupedFiles& grouped) const;
+
+    //Calculate sample and full hashes of every file of content (for snapshots of directory).
+    //Only one file of each inode is read, hashes are calculated in parallel if jobs != 1
+    void CalcAllHashSums(const std::vector<fl::File>& content) const;
+
 private:
+    //calculate sample (full == false) or full hashes of files.
+    //Only one file of each inode is read, other links to it get the same hashes
+    void CalcHashes(const std::vector<const fl::File*>& files, bool full, SearchBudget* budget = nullptr) const;
+
+    //calculate full hashes of every group and call on_group(index of group) once all hashes of the group are ready.
+    //Links to the same inode must be in the same group. With budget bytes of group are taken at once,
+    //group which doesn't fit is finished without hashes
+    void CalcGroupHashes(const std::vector<std::vector<const fl::File*>>& groups,
+                         const std::function<void(std::size_t)>& on_group, SearchBudget* budget = nullptr) const;
+
+    //calculate hashes of different inodes by GetJobs() threads with engine of File::GetReadOptions().
+    //on_done (may be empty) is called for every file, concurrently if jobs != 1.
+    //With budget files not admitted by it are not read, on_done is called for them too (admitted - files are
+    //taken from budget already). Files being read when budget is stopped are left without hash
+    void HashFiles(const std::vector<const fl::File*>& files, bool full,
+                   const std::function<void(const fl::File*)>& on_done, SearchBudget* budget = nullptr,
+                   bool admitted = false) const;
+
+    //clusters search of all GetDuplicatedClusters methods, budget and on_unresolved may be empty
+    void SearchClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs,
+                        const ClusterCallback& on_cluster, SearchBudget* budget,
+                        const UnresolvedCallback& on_unresolved);
+
+    //files of size buckets which share all extents with other file of their bucket (reflinks) are the same.
+    //Buckets made of one such set are passed to on_cluster as shared without reading and removed, in other ones
+    //every file of set is mapped in shared_with to the first file of set: only that file is read
+    void FindSharedExtents(std::vector<std::vector<TaggedFile>>& buckets, std::size_t min_dirs,
+                           const ClusterCallback& on_cluster,
+                           std::unordered_map<const fl::File*, const fl::File*>& shared_with) const;
+
+    //split buckets of sizes sampled by blocks by fingerprints of files and drop files with unique ones.
+    //Copies of shared extents take fingerprint of their set, files not admitted by budget keep their bucket
+    void FilterByBlocks(std::vector<std::vector<TaggedFile>>& buckets, std::size_t min_dirs,
+                        const std::unordered_map<const fl::File*, const fl::File*>& shared_with,
+                        SearchBudget* budget) const;
+
+    //find clusters in every size bucket by byte comparison (Bytes compare mode)
+    void CompareBuckets(const std::vector<std::vector<TaggedFile>>& buckets, std::size_t min_dirs,
+                        const ClusterCallback& on_cluster, SearchBudget* budget,
+                        const UnresolvedCallback& on_unresolved) const;
+
+    std::size_t     m_jobs{ 1 };
+    bool            m_recursive{ false };
+    CompareMode     m_compare_mode{ CompareMode::Hash };
+    std::size_t     m_max_open_files{ 256 };
+    std::uint64_t   m_blocks_min_size{ 1ULL << 30 };
 
 };
 
@@ -0,0 +1,114 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace fl {
+
+//Process wide counters and phase timers of search.
+//Counters are relaxed atomics and timers are taken once per phase, so they are always on.
+//Only reporting is optional.
+class Stats
+{
+public:
+    enum class Counter
+    {
+        StatCalls,          //stat/statx of directory entries
+        DirsRead,           //directories opened by walker
+        FilesOpened,        //files opened for reading content
+        BytesRead,          //bytes got from read/mmap
+        BytesHashed,        //bytes passed to hashers
+        SampleHashes,       //head/tail hashes calculated
+        FullHashes,         //full hashes calculated
+        CacheHits,          //hashes taken from hash cache
+        LinksShared,        //hashes copied between links to the same inode
+        AvoidedBySize,      //files not hashed at all as their size is unique
+        AvoidedBySample,    //files not hashed fully as their sample is unique
+        AvoidedByInode,     //files not read as all files of their size are links to one inode
+        CacheResident,      //bytes read which were in page cache already
+        CacheMissed,        //bytes read which were not in page cache
+        CacheDropped,       //bytes evicted from page cache after hashing (drop cache mode)
+        DirectRead,         //bytes read by O_DIRECT bypassing page cache
+        SpilledBytes,       //records and paths written to disk by memory-bounded search
+        SpillRuns,          //sorted runs of records written by memory-bounded search
+        SeekOrdered,        //files of rotational devices ordered by physical offset before reading
+        ResidentFirst,      //files of rotational devices moved ahead as their content is in page cache
+        HoleBytes,          //bytes of holes of sparse files hashed as zeros without reading
+        SharedExtents,      //files not read as they share all extents with other file of cluster (reflinks)
+        BlockSamples,       //fingerprints of big files by blocks spread across them
+        AvoidedByBlocks,    //big files not hashed fully as their fingerprint is unique
+        Count_
+    };
+
+    //phases follow each other except Output: found clusters are joined and written
+    //during full hashing, so time of writing is counted in both
+    enum class Phase
+    {
+        Scan,           //directory traversal
+        Group,          //grouping by size
+        SampleHash,
+        FullHash,
+        Compare,        //matching of hashes
+        Output,         //write(2) of buffered results
+        Count_
+    };
+
+    static void Add(Counter counter, std::uint64_t value = 1) {
+        s_counters[static_cast<std::size_t>(counter)].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static std::uint64_t Get(Counter counter) {
+        return s_counters[static_cast<std::size_t>(counter)].value.load(std::memory_order_relaxed);
+    }
+
+    static void AddTime(Phase phase, std::uint64_t wall_ns, std::uint64_t cpu_ns);
+    //total time of phase, ns. CPU time is of all threads of the process
+    static std::uint64_t GetWallTime(Phase phase);
+    static std::uint64_t GetCpuTime(Phase phase);
+
+    //maximum resident set size of the process, bytes
+    static std::uint64_t GetPeakRss();
+
+    static void Reset();
+
+    static const char* CounterName(Counter counter);
+    static const char* PhaseName(Phase phase);
+
+    //human readable report
+    static void PrintSummary(std::ostream& os);
+    //the same as one JSON object
+    static void PrintJson(std::ostream& os);
+
+private:
+    //counters updated by every worker for every file don't share cache lines
+    struct alignas(64) PaddedCounter
+    {
+        std::atomic<std::uint64_t>  value{ 0 };
+    };
+
+    static PaddedCounter                s_counters[static_cast<std::size_t>(Counter::Count_)];
+    static std::atomic<std::uint64_t>   s_wall_ns[static_cast<std::size_t>(Phase::Count_)];
+    static std::atomic<std::uint64_t>   s_cpu_ns[static_cast<std::size_t>(Phase::Count_)];
+};
+
+//adds wall and CPU time of its scope to phase
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(Stats::Phase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    Stats::Phase    m_phase;
+    std::uint64_t   m_wall_start;
+    std::uint64_t   m_cpu_start;
+};
+
+}
+
+#endif // ! __STATS_H__
@@ -0,0 +1,56 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+namespace fl {
+
+//fixed size pool of worker threads.
+//Tasks are executed in order of submission, Wait() blocks until all submitted tasks are done.
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    //0 means "as many as hardware allows"
+    explicit ThreadPool(std::size_t threads_num);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //put task into queue
+    void Submit(Task task);
+
+    //wait all submitted tasks. Rethrow the first exception thrown by any task
+    void Wait();
+
+    std::size_t GetThreadsNum() const {
+        return m_workers.size();
+    }
+
+    //number of threads for given value of --jobs option
+    static std::size_t ThreadsNum(std::size_t jobs);
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread>    m_workers;
+    std::queue<Task>            m_tasks;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_task_cv;
+    std::condition_variable     m_done_cv;
+    std::size_t                 m_active{ 0 };
+    bool                        m_stop{ false };
+    std::exception_ptr          m_error;
+};
+
+}
+
+#endif // ! __THREAD_POOL_H__
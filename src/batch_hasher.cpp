@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <deque>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "batch_hasher.h"
+#include "io_uring_ring.h"
+#include "page_cache.h"
+#include "search_budget.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    constexpr std::size_t BUFFER_ALIGNMENT = 4096;
+}
+
+//file being hashed: ranges to read, reads in flight in order of offsets
+struct BatchHasher::Job
+{
+    const fl::File*                                     file{ nullptr };
+    bool                                                full{ true };
+    int                                                 fd{ -1 };
+    std::unique_ptr<Hasher>                             hasher;
+    std::unique_ptr<PageCache>                          cache;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;    //offset, length
+    std::size_t                                         range_idx{ 0 };
+    std::uint64_t                                       range_pos{ 0 };
+    std::uint64_t                                       hashed{ 0 };
+    std::deque<std::size_t>                             inflight;   //slots
+    bool                                                failed{ false };
+    //budget is stopped, file is left without hash
+    bool                                                abandoned{ false };
+
+    bool HasMoreToRead() const {
+        return !failed && !abandoned && range_idx < ranges.size();
+    }
+
+    std::uint64_t Expected() const {
+        std::uint64_t total = 0;
+        for (const auto& r : ranges) {
+            total += r.second;
+        }
+        return total;
+    }
+};
+
+BatchHasher::BatchHasher(const ReadOptions& options) : m_options(options),
+                                                       m_block_size(options.buffer_size != 0 ? options.buffer_size : ReadOptions{}.buffer_size),
+                                                       m_depth(std::max<std::size_t>(options.queue_depth, 1)),
+                                                       m_max_files(m_depth) {
+    m_block_size = (m_block_size + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+
+    m_ring = std::make_unique<IoUringRing>(static_cast<unsigned>(m_depth));
+    if (!m_ring->IsOk()) {
+        return;
+    }
+
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, BUFFER_ALIGNMENT, m_block_size * m_depth) != 0) {
+        m_ring.reset();
+        return;
+    }
+    m_buffers = static_cast<char*>(ptr);
+
+    //not registered buffers work too, just a bit slower
+    std::vector<iovec> iovs(m_depth);
+    for (std::size_t i = 0; i < m_depth; ++i) {
+        iovs[i].iov_base = m_buffers + i * m_block_size;
+        iovs[i].iov_len = m_block_size;
+    }
+    m_ring->RegisterBuffers(iovs);
+}
+
+BatchHasher::~BatchHasher() {
+    //ring is closed before its buffers are released
+    m_ring.reset();
+    std::free(m_buffers);
+}
+
+bool BatchHasher::IsAsync() const {
+    return m_ring && m_ring->IsOk();
+}
+
+void BatchHasher::SetMaxFiles(std::size_t max_files) {
+    m_max_files = max_files == 0 ? m_depth : std::min(max_files, m_depth);
+}
+
+void BatchHasher::CalcSync(const fl::File* f, bool full, const SearchBudget* budget) {
+    if (full) {
+        f->GetHashSum(budget);
+    }
+    else {
+        f->GetSampleHashSum(budget);
+    }
+}
+
+void BatchHasher::Run(const std::vector<const fl::File*>& files, bool full, const Callback& on_done,
+                      const SearchBudget* budget) {
+    auto done = [&on_done](const fl::File* f) {
+        if (on_done) {
+            on_done(f);
+        }
+    };
+
+    //O_DIRECT needs aligned ranges, it is done by usual reading
+    if (!IsAsync() || m_options.cache == CacheMode::Direct) {
+        for (const auto* f : files) {
+            CalcSync(f, full, budget);
+            done(f);
+        }
+        return;
+    }
+
+    struct Slot
+    {
+        iovec           iov{};
+        Job*            job{ nullptr };
+        std::uint64_t   offset{ 0 };
+        std::uint32_t   len{ 0 };
+        bool            completed{ false };
+        int             res{ 0 };
+    };
+    std::vector<Slot> slots(m_depth);
+    std::vector<std::size_t> free_slots;
+    for (std::size_t i = 0; i < m_depth; ++i) {
+        slots[i].iov.iov_base = m_buffers + i * m_block_size;
+        free_slots.push_back(m_depth - 1 - i);
+    }
+    std::size_t inflight = 0;
+
+    std::vector<std::unique_ptr<Job>> active;
+    //budget is stopped: files are not started any more
+    bool stopped = false;
+
+    //hash is ready or job failed and has nothing in flight
+    auto finish = [&](Job& job) {
+        job.cache.reset();
+        if (job.fd >= 0) {
+            ::close(job.fd);
+            job.fd = -1;
+        }
+        if (job.abandoned) {
+            done(job.file);
+            return;
+        }
+        if (!job.failed && job.hashed == job.Expected()) {
+            if (job.full) {
+                job.file->SetHashSum(job.hasher->GetHash());
+                Stats::Add(Stats::Counter::FullHashes);
+            }
+            else {
+                job.file->SetSampleHashSum(job.hasher->GetHash());
+                Stats::Add(Stats::Counter::SampleHashes);
+            }
+        }
+        //failed or short files are checked by usual reading which marks them not valid,
+        //sample of small file is taken from its full hash
+        CalcSync(job.file, full, budget);
+        done(job.file);
+    };
+
+    auto start = [&](const fl::File* f) {
+        const bool sample_only = !full && !f->SampleIsWholeFile();
+        if (!f->IsOk() || stopped || (sample_only ? f->FindCachedSampleHashSum() : f->FindCachedHashSum())) {
+            CalcSync(f, full, budget);
+            done(f);
+            return;
+        }
+
+        auto job = std::make_unique<Job>();
+        job->file = f;
+        job->full = !sample_only;
+        const std::uint64_t size = f->GetFileSize();
+        if (job->full) {
+            if (size != 0) {
+                job->ranges.emplace_back(0, size);
+            }
+        }
+        else {
+            const std::uint64_t sample_size = File::GetSampleSize();
+            job->ranges.emplace_back(0, sample_size);
+            job->ranges.emplace_back(size - sample_size, sample_size);
+        }
+
+        job->fd = ::open(f->GetFilePath().c_str(), O_RDONLY | O_CLOEXEC);
+        if (job->fd < 0) {
+            job->failed = true;
+            finish(*job);
+            return;
+        }
+        Stats::Add(Stats::Counter::FilesOpened);
+        job->cache = std::make_unique<PageCache>(job->fd, m_options);
+        job->hasher = Hasher::Create(File::GetHashKind());
+        if (!job->HasMoreToRead()) {
+            finish(*job);
+            return;
+        }
+        active.push_back(std::move(job));
+    };
+
+    auto issue = [&](Job& job) {
+        const auto& range = job.ranges[job.range_idx];
+        const auto len = static_cast<std::uint32_t>(std::min<std::uint64_t>(m_block_size, range.second - job.range_pos));
+        const auto idx = free_slots.back();
+        auto& slot = slots[idx];
+        slot.iov.iov_len = len;
+        slot.job = &job;
+        slot.offset = range.first + job.range_pos;
+        slot.len = len;
+        slot.completed = false;
+        job.cache->Probe(slot.offset, len);
+        if (!m_ring->QueueRead(job.fd, &slot.iov, static_cast<int>(idx), slot.offset, idx)) {
+            return false;
+        }
+        free_slots.pop_back();
+        job.inflight.push_back(idx);
+        ++inflight;
+
+        job.range_pos += len;
+        if (job.range_pos == range.second) {
+            ++job.range_idx;
+            job.range_pos = 0;
+        }
+        return true;
+    };
+
+    std::size_t next = 0;
+    std::size_t rr = 0;
+    bool broken = false;
+    for (;;) {
+        //reads in flight are completed, but no more are issued: jobs are finished without hash
+        if (!stopped && budget && budget->IsStopped()) {
+            stopped = true;
+        }
+        if (stopped) {
+            for (auto& job_ptr : active) {
+                job_ptr->abandoned = true;
+            }
+        }
+
+        //remove finished jobs
+        for (auto& job_ptr : active) {
+            if (job_ptr->inflight.empty() && !job_ptr->HasMoreToRead()) {
+                finish(*job_ptr);
+                job_ptr.reset();
+            }
+        }
+        active.erase(std::remove(active.begin(), active.end(), nullptr), active.end());
+
+        //new files first, so many files are read at once, then more reads of open files
+        bool progress = true;
+        while (!free_slots.empty() && progress) {
+            progress = false;
+            if (active.size() < m_max_files && next < files.size()) {
+                start(files[next++]);
+                progress = true;
+                continue;
+            }
+            for (std::size_t k = 0; k < active.size() && !free_slots.empty(); ++k) {
+                auto& job = *active[(rr + k) % active.size()];
+                if (job.HasMoreToRead() && issue(job)) {
+                    progress = true;
+                }
+            }
+            ++rr;
+        }
+
+        //all files are started and all jobs are finished
+        if (inflight == 0) {
+            break;
+        }
+
+        if (!m_ring->SubmitAndWait()) {
+            broken = true;
+            break;
+        }
+
+        std::uint64_t user_data = 0;
+        int res = 0;
+        while (m_ring->PopCompletion(user_data, res)) {
+            auto& slot = slots[user_data];
+            slot.completed = true;
+            slot.res = res;
+            --inflight;
+        }
+
+        //pass completed blocks to hashers in order of offsets
+        for (auto& job_ptr : active) {
+            auto& job = *job_ptr;
+            while (!job.inflight.empty() && slots[job.inflight.front()].completed) {
+                const auto idx = job.inflight.front();
+                auto& slot = slots[idx];
+                if (!job.failed) {
+                    if (slot.res < 0 || static_cast<std::uint32_t>(slot.res) != slot.len) {
+                        //error or file became shorter
+                        job.failed = true;
+                    }
+                    else {
+                        job.hasher->Add(slot.iov.iov_base, slot.len);
+                        job.hashed += slot.len;
+                        job.cache->Done(slot.offset, slot.len);
+                        Stats::Add(Stats::Counter::BytesRead, slot.len);
+                        Stats::Add(Stats::Counter::BytesHashed, slot.len);
+                    }
+                }
+                job.inflight.pop_front();
+                free_slots.push_back(idx);
+            }
+        }
+    }
+
+    if (broken) {
+        //ring doesn't work any more: the rest is read in usual way.
+        //Buffers stay allocated until the ring is closed
+        for (auto& job_ptr : active) {
+            job_ptr->failed = true;
+            finish(*job_ptr);
+        }
+        while (next < files.size()) {
+            const auto* f = files[next++];
+            CalcSync(f, full, budget);
+            done(f);
+        }
+        m_ring.reset();
+    }
+}
+
+}
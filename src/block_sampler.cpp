@@ -0,0 +1,74 @@
+#include <algorithm>
+
+#include "block_sampler.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    constexpr std::uint64_t PAGE_SIZE = 4096;
+
+    //splitmix64: stateless mixing of size and number of block
+    std::uint64_t Mix(std::uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+}
+
+std::size_t BlockSampler::BlocksNum(std::uint64_t size) const {
+    if (!IsSampled(size)) {
+        return 0;
+    }
+    std::size_t doublings = 0;
+    for (auto s = size / m_min_size; s > 1; s >>= 1) {
+        ++doublings;
+    }
+    //file can't have more blocks than fit in it
+    return std::min<std::uint64_t>({ 8 * (doublings + 1), MaxBlocks, size / BlockSize });
+}
+
+std::vector<std::uint64_t> BlockSampler::Offsets(std::uint64_t size) const {
+    const auto num = BlocksNum(size);
+    std::vector<std::uint64_t> res;
+    res.reserve(num);
+    //strata start at page boundaries, the tail after the last one is never sampled
+    const auto stratum = num != 0 ? size / num / PAGE_SIZE * PAGE_SIZE : 0;
+    for (std::size_t i = 0; i < num; ++i) {
+        //block fits into its stratum, so blocks don't overlap
+        const auto room = stratum - BlockSize;
+        const auto shift = room != 0 ? Mix(size ^ Mix(i)) % room / PAGE_SIZE * PAGE_SIZE : 0;
+        res.push_back(i * stratum + shift);
+    }
+    return res;
+}
+
+Digest BlockSampler::Hash(const fl::File& file) const {
+    const auto size = file.GetFileSize();
+    const auto offsets = Offsets(size);
+    if (offsets.empty() || !file.IsOk()) {
+        return Digest{};
+    }
+
+    FileReader reader(file.GetFilePath(), File::GetReadOptions());
+    if (!reader.IsOpen()) {
+        return Digest{};
+    }
+    auto hasher = Hasher::Create(File::GetHashKind());
+    auto add = [&hasher](const char* data, std::size_t len) {
+        hasher->Add(data, len);
+    };
+    std::uint64_t bytes_red = 0;
+    for (auto offset : offsets) {
+        bytes_red += reader.Read(offset, BlockSize, add);
+    }
+    Stats::Add(Stats::Counter::BytesHashed, bytes_red);
+    if (bytes_red != offsets.size() * BlockSize) {
+        return Digest{};
+    }
+    Stats::Add(Stats::Counter::BlockSamples);
+    return hasher->GetHash();
+}
+
+}
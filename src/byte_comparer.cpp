@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "byte_comparer.h"
+#include "hasher.h"
+#include "search_budget.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+
+    //open descriptors of group, closed when they are not needed any more
+    class OpenFiles
+    {
+    public:
+        explicit OpenFiles(std::size_t n) : m_fds(n, -1) {}
+        ~OpenFiles() {
+            for (std::size_t i = 0; i < m_fds.size(); ++i) {
+                Close(i);
+            }
+        }
+
+        OpenFiles(const OpenFiles&) = delete;
+        OpenFiles& operator=(const OpenFiles&) = delete;
+
+        bool Open(std::size_t i, const std::string& path) {
+            m_fds[i] = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (m_fds[i] < 0) {
+                return false;
+            }
+            Stats::Add(Stats::Counter::FilesOpened);
+            return true;
+        }
+
+        void Close(std::size_t i) {
+            if (m_fds[i] >= 0) {
+                ::close(m_fds[i]);
+                m_fds[i] = -1;
+            }
+        }
+
+        int Get(std::size_t i) const {
+            return m_fds[i];
+        }
+
+    private:
+        std::vector<int>    m_fds;
+    };
+
+    //read exactly len bytes or fail
+    bool ReadBlock(int fd, char* buf, std::size_t len, std::uint64_t offset) {
+        std::size_t done = 0;
+        while (done < len) {
+            auto n = ::pread(fd, buf + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        Stats::Add(Stats::Counter::BytesRead, done);
+        return done == len;
+    }
+}
+
+ByteComparer::ByteComparer(const Options& options, GroupFilter filter) : m_options(options),
+                                                                         m_filter(std::move(filter)) {
+    m_options.block_size = std::max<std::size_t>(m_options.block_size, 1);
+    m_options.max_open_files = std::max<std::size_t>(m_options.max_open_files, 2);
+}
+
+bool ByteComparer::Keep(const Group& group) const {
+    if (group.empty()) {
+        return false;
+    }
+    return m_filter ? m_filter(group) : group.size() > 1;
+}
+
+bool ByteComparer::IsStopped() const {
+    return m_options.budget && m_options.budget->IsStopped();
+}
+
+std::vector<ByteComparer::Group> ByteComparer::Split(const std::vector<const fl::File*>& files, bool* stopped) const {
+    std::vector<Group> res;
+    if (stopped) {
+        *stopped = false;
+    }
+
+    Group all;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (files[i]->IsOk()) {
+            all.push_back(i);
+        }
+    }
+    if (all.empty()) {
+        return res;
+    }
+
+    const std::uint64_t file_size = files[all.front()]->GetFileSize();
+    auto keep = [this](const Group& g) { return Keep(g); };
+
+    //groups waiting for pre-split at given offset
+    std::vector<std::pair<Group, std::uint64_t>> todo;
+    todo.emplace_back(std::move(all), 0);
+    std::vector<char> buf(m_options.block_size);
+    while (!todo.empty() && !IsStopped()) {
+        auto group = std::move(todo.back().first);
+        const auto offset = todo.back().second;
+        todo.pop_back();
+
+        if (!Keep(group)) {
+            continue;
+        }
+        if (group.size() <= m_options.max_open_files) {
+            //bytes before offset are matched by hash only, compare them too
+            Lockstep(files, group, keep, res);
+            continue;
+        }
+        if (offset >= file_size) {
+            //too many files with the same hashes of all blocks
+            CompareWithFirst(files, std::move(group), res);
+            continue;
+        }
+
+        //pre-split by hash of block at offset, one file is open at a time
+        const auto len = static_cast<std::size_t>(std::min<std::uint64_t>(m_options.block_size, file_size - offset));
+        std::vector<Group> parts;
+        std::unordered_map<Digest, std::size_t, DigestHash> part_idx;
+        auto hasher = Hasher::Create(HashKind::XXH3);
+        for (auto i : group) {
+            if (IsStopped()) {
+                break;
+            }
+            OpenFiles f(1);
+            if (!f.Open(0, files[i]->GetFilePath()) || !ReadBlock(f.Get(0), buf.data(), len, offset)) {
+                continue;
+            }
+            hasher->Reset();
+            hasher->Add(buf.data(), len);
+            auto ins = part_idx.emplace(hasher->GetHash(), parts.size());
+            if (ins.second) {
+                parts.emplace_back();
+            }
+            parts[ins.first->second].push_back(i);
+        }
+        //stack: push in reverse order to process parts in order of their first files
+        for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+            todo.emplace_back(std::move(*it), offset + len);
+        }
+    }
+
+    //groups are not confirmed: files not compared yet can belong to them
+    if (IsStopped()) {
+        if (stopped) {
+            *stopped = true;
+        }
+        return {};
+    }
+
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+void ByteComparer::Lockstep(const std::vector<const fl::File*>& files, const Group& group,
+                            const GroupFilter& keep, std::vector<Group>& res) const {
+    const auto n = group.size();
+    const std::uint64_t file_size = files[group.front()]->GetFileSize();
+    const auto block = m_options.block_size;
+
+    //positions in group
+    using Positions = std::vector<std::size_t>;
+    auto to_group = [&group](const Positions& ps) {
+        Group g;
+        g.reserve(ps.size());
+        for (auto p : ps) {
+            g.push_back(group[p]);
+        }
+        return g;
+    };
+
+    OpenFiles fds(n);
+    Positions opened;
+    for (std::size_t p = 0; p < n; ++p) {
+        if (fds.Open(p, files[group[p]]->GetFilePath())) {
+            opened.push_back(p);
+        }
+    }
+
+    std::vector<char> buffers(n * std::min<std::uint64_t>(block, std::max<std::uint64_t>(file_size, 1)));
+    const auto stride = buffers.size() / n;
+    auto buf = [&buffers, stride](std::size_t p) { return buffers.data() + p * stride; };
+
+    //single file has nothing to compare with
+    std::vector<Positions> active;
+    auto add_active = [&](Positions&& ps, std::vector<Positions>& to) {
+        if (ps.empty() || !keep(to_group(ps))) {
+            for (auto p : ps) {
+                fds.Close(p);
+            }
+        }
+        else if (ps.size() == 1) {
+            res.push_back(to_group(ps));
+            fds.Close(ps.front());
+        }
+        else {
+            to.push_back(std::move(ps));
+        }
+    };
+    add_active(std::move(opened), active);
+
+    for (std::uint64_t offset = 0; offset < file_size && !active.empty(); offset += block) {
+        if (IsStopped()) {
+            //the caller drops all groups
+            return;
+        }
+        const auto len = static_cast<std::size_t>(std::min<std::uint64_t>(block, file_size - offset));
+
+        std::vector<Positions> next;
+        for (const auto& ps : active) {
+            Positions remaining;
+            for (auto p : ps) {
+                if (ReadBlock(fds.Get(p), buf(p), len, offset)) {
+                    remaining.push_back(p);
+                }
+                else {
+                    //file is changed or unreadable
+                    fds.Close(p);
+                }
+            }
+
+            //split by content of block, order of files is kept
+            while (!remaining.empty()) {
+                Positions same{ remaining.front() };
+                Positions other;
+                for (std::size_t k = 1; k < remaining.size(); ++k) {
+                    if (std::memcmp(buf(remaining[k]), buf(same.front()), len) == 0) {
+                        same.push_back(remaining[k]);
+                    }
+                    else {
+                        other.push_back(remaining[k]);
+                    }
+                }
+
+                add_active(std::move(same), next);
+                remaining = std::move(other);
+            }
+        }
+        active = std::move(next);
+    }
+
+    for (const auto& ps : active) {
+        res.push_back(to_group(ps));
+    }
+}
+
+void ByteComparer::CompareWithFirst(const std::vector<const fl::File*>& files, Group group, std::vector<Group>& res) const {
+    const auto batch_size = m_options.max_open_files - 1;
+
+    while (Keep(group) && !IsStopped()) {
+        const auto first = group.front();
+        auto with_first = [first](const Group& g) { return g.front() == first; };
+
+        //files identical to the first one
+        Group same{ first };
+        for (std::size_t b = 1; b < group.size() && !IsStopped(); b += batch_size) {
+            Group batch{ first };
+            batch.insert(batch.end(), group.begin() + static_cast<std::ptrdiff_t>(b),
+                         group.begin() + static_cast<std::ptrdiff_t>(std::min(group.size(), b + batch_size)));
+
+            std::vector<Group> matched;
+            Lockstep(files, batch, with_first, matched);
+            if (!matched.empty()) {
+                same.insert(same.end(), matched.front().begin() + 1, matched.front().end());
+            }
+        }
+
+        if (Keep(same)) {
+            res.push_back(same);
+        }
+
+        //the rest can be identical to each other
+        Group rest;
+        std::set_difference(group.begin(), group.end(), same.begin(), same.end(), std::back_inserter(rest));
+        group = std::move(rest);
+    }
+}
+
+}
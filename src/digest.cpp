@@ -0,0 +1,23 @@
+#include <algorithm>
+
+#include "digest.h"
+
+namespace fl {
+
+Digest::Digest(const void* data, std::size_t data_size) {
+    size = static_cast<std::uint8_t>(std::min(data_size, MaxSize));
+    std::memcpy(bytes.data(), data, size);
+}
+
+std::string Digest::ToHex() const {
+    static const char dec2hex[16 + 1] = "0123456789abcdef";
+    std::string result;
+    result.reserve(2 * size);
+    for (std::size_t i = 0; i < size; ++i) {
+        result += dec2hex[(bytes[i] >> 4) & 15];
+        result += dec2hex[bytes[i] & 15];
+    }
+    return result;
+}
+
+}
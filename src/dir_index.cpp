@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dir_index.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    constexpr char MAGIC[8] = { 'D', 'U', 'P', 'S', 'I', 'D', 'X', '1' };
+    constexpr std::uint32_t VERSION = 1;
+}
+
+struct DirIndex::Header
+{
+    char            magic[8];
+    std::uint32_t   version;
+    std::uint32_t   hash_kind;
+    std::uint64_t   sample_size;
+    std::uint64_t   count;
+    std::uint64_t   entries_offset;
+    std::uint64_t   names_offset;
+    std::uint64_t   names_size;
+    std::uint32_t   root_len;       //root is at the beginning of names
+    std::uint32_t   reserved;
+};
+
+struct DirIndex::Entry
+{
+    std::uint64_t   size;
+    std::uint64_t   dev;
+    std::uint64_t   ino;
+    std::int64_t    mtime_ns;
+    std::int64_t    ctime_ns;
+    std::uint64_t   name_offset;    //relative path, absolute one if file is not under root
+    std::uint32_t   name_len;
+    std::uint32_t   mode;
+    std::uint8_t    hash_size;
+    std::uint8_t    sample_hash_size;
+    std::uint8_t    reserved[6];
+    std::uint8_t    hash[Digest::MaxSize];
+    std::uint8_t    sample_hash[Digest::MaxSize];
+};
+
+DirIndex::~DirIndex() {
+    Unload();
+}
+
+void DirIndex::Unload() {
+    if (m_data) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_root.clear();
+}
+
+bool DirIndex::Write(const std::string& path, const std::string& root, const std::vector<fl::File>& content) {
+    struct Item
+    {
+        const fl::File*     file;
+        std::string         name;
+    };
+    std::vector<Item> items;
+    const auto prefix = root.empty() || root.back() == '/' ? root : root + "/";
+    for (const auto& f : content) {
+        if (!f.IsOk() || !f.HasHashSum()) {
+            continue;
+        }
+        auto name = f.GetFilePath();
+        if (!prefix.empty() && name.compare(0, prefix.size(), prefix) == 0) {
+            name.erase(0, prefix.size());
+        }
+        items.push_back(Item{ &f, std::move(name) });
+    }
+    std::sort(items.begin(), items.end(), [](const Item& i1, const Item& i2) {
+        const auto s1 = i1.file->GetFileSize();
+        const auto s2 = i2.file->GetFileSize();
+        return s1 != s2 ? s1 < s2 : i1.name < i2.name;
+    });
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.hash_kind = static_cast<std::uint32_t>(File::GetHashKind());
+    header.sample_size = File::GetSampleSize();
+    header.count = items.size();
+    header.entries_offset = sizeof(Header);
+    header.names_offset = header.entries_offset + items.size() * sizeof(Entry);
+    header.root_len = static_cast<std::uint32_t>(root.size());
+
+    std::string names = root;
+    std::vector<Entry> entries(items.size());
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        const auto* f = items[i].file;
+        const auto& stamp = f->GetStamp();
+        auto& e = entries[i];
+        e = Entry{};
+        e.size = f->GetFileSize();
+        e.dev = stamp.dev;
+        e.ino = stamp.ino;
+        e.mtime_ns = stamp.mtime_ns;
+        e.ctime_ns = stamp.ctime_ns;
+        e.mode = stamp.mode;
+        e.name_offset = names.size();
+        e.name_len = static_cast<std::uint32_t>(items[i].name.size());
+        names += items[i].name;
+
+        const auto& hash = f->GetHashSum();
+        e.hash_size = hash.size;
+        std::memcpy(e.hash, hash.bytes.data(), hash.size);
+        const auto& sample = f->GetSampleHashSum();
+        e.sample_hash_size = sample.size;
+        std::memcpy(e.sample_hash, sample.bytes.data(), sample.size);
+    }
+    header.names_size = names.size();
+
+    const auto tmp_path = path + ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream ofs(tmp_path, std::ios_base::binary | std::ios_base::trunc);
+        if (!ofs.is_open()) {
+            return false;
+        }
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+        ofs.write(names.data(), static_cast<std::streamsize>(names.size()));
+        ofs.flush();
+        if (!ofs.good()) {
+            ofs.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    //data must be on disk before rename, otherwise after crash we can get empty snapshot
+    int fd = ::open(tmp_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool DirIndex::IsSnapshot(const std::string& path) {
+    std::ifstream ifs(path, std::ios_base::binary);
+    char magic[sizeof(MAGIC)] = {};
+    ifs.read(magic, sizeof(magic));
+    return ifs.good() && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool DirIndex::Load(const std::string& path) {
+    Unload();
+
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const char*>(addr);
+    m_size = size;
+
+    //everything entries refer to must be inside of file, names are checked on access
+    const auto* h = GetHeader();
+    const bool ok = std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                    h->version == VERSION &&
+                    h->hash_kind <= static_cast<std::uint32_t>(HashKind::SHA256) &&
+                    h->entries_offset == sizeof(Header) &&
+                    h->count <= (m_size - sizeof(Header)) / sizeof(Entry) &&
+                    h->names_offset == h->entries_offset + h->count * sizeof(Entry) &&
+                    h->names_size <= m_size - h->names_offset &&
+                    h->root_len <= h->names_size;
+    if (!ok) {
+        Unload();
+        return false;
+    }
+    m_root.assign(m_data + h->names_offset, h->root_len);
+    return true;
+}
+
+const DirIndex::Header* DirIndex::GetHeader() const {
+    static_assert(sizeof(Header) == 64, "header layout is a part of file format");
+    return static_cast<const Header*>(static_cast<const void*>(m_data));
+}
+
+const DirIndex::Entry* DirIndex::GetEntries() const {
+    static_assert(sizeof(Entry) == 128, "entry layout is a part of file format");
+    return static_cast<const Entry*>(static_cast<const void*>(m_data + GetHeader()->entries_offset));
+}
+
+HashKind DirIndex::GetHashKind() const {
+    return m_data ? static_cast<HashKind>(GetHeader()->hash_kind) : File::GetHashKind();
+}
+
+std::size_t DirIndex::GetSampleSize() const {
+    return m_data ? GetHeader()->sample_size : File::GetSampleSize();
+}
+
+std::size_t DirIndex::Size() const {
+    return m_data ? GetHeader()->count : 0;
+}
+
+std::pair<std::size_t, std::size_t> DirIndex::EqualRange(std::uint64_t size) const {
+    if (!m_data) {
+        return { 0, 0 };
+    }
+    const auto* first = GetEntries();
+    const auto* last = first + Size();
+    auto lo = std::lower_bound(first, last, size, [](const Entry& e, std::uint64_t s) { return e.size < s; });
+    auto hi = std::upper_bound(lo, last, size, [](std::uint64_t s, const Entry& e) { return s < e.size; });
+    return { static_cast<std::size_t>(lo - first), static_cast<std::size_t>(hi - first) };
+}
+
+std::vector<std::uint64_t> DirIndex::Sizes() const {
+    std::vector<std::uint64_t> sizes;
+    if (!m_data) {
+        return sizes;
+    }
+    const auto* entries = GetEntries();
+    for (std::size_t i = 0; i < Size(); ++i) {
+        if (sizes.empty() || sizes.back() != entries[i].size) {
+            sizes.push_back(entries[i].size);
+        }
+    }
+    return sizes;
+}
+
+std::vector<fl::File> DirIndex::GetFiles(const std::vector<std::pair<std::size_t, std::size_t>>& ranges) const {
+    std::vector<fl::File> files;
+    if (!m_data) {
+        return files;
+    }
+
+    const auto* h = GetHeader();
+    const auto* entries = GetEntries();
+    const char* names = m_data + h->names_offset;
+    auto name_ok = [h](const Entry& e) {
+        return e.name_len != 0 && e.name_offset <= h->names_size && e.name_len <= h->names_size - e.name_offset &&
+               e.hash_size <= Digest::MaxSize && e.sample_hash_size <= Digest::MaxSize;
+    };
+
+    //names of taken files are copied into pools once, files refer to them.
+    //A pool holds 4 GiB of names, the next one is started when it is full
+    std::vector<std::shared_ptr<PathPool>> pools{ std::make_shared<PathPool>(m_root),
+                                                  std::make_shared<PathPool>(std::string{}) };
+    std::size_t rel_idx = 0;
+    std::size_t abs_idx = 1;
+    std::vector<std::pair<std::size_t, std::uint32_t>> refs;    //pool, offset in it
+    for (const auto& r : ranges) {
+        for (auto i = r.first; i < r.second && i < h->count; ++i) {
+            const auto& e = entries[i];
+            if (!name_ok(e)) {
+                continue;
+            }
+            const char* name = names + e.name_offset;
+            auto& idx = name[0] == '/' ? abs_idx : rel_idx;
+            if (!pools[idx]->CanAdd(e.name_len)) {
+                pools.push_back(std::make_shared<PathPool>(pools[idx]->GetDir()));
+                idx = pools.size() - 1;
+            }
+            refs.emplace_back(idx, pools[idx]->Add(name, e.name_len));
+        }
+    }
+
+    std::size_t k = 0;
+    for (const auto& r : ranges) {
+        for (auto i = r.first; i < r.second && i < h->count; ++i) {
+            const auto& e = entries[i];
+            if (!name_ok(e)) {
+                continue;
+            }
+            FileStamp stamp;
+            stamp.dev = e.dev;
+            stamp.ino = e.ino;
+            stamp.size = e.size;
+            stamp.mtime_ns = e.mtime_ns;
+            stamp.ctime_ns = e.ctime_ns;
+            stamp.mode = e.mode;
+            const auto& ref = refs[k++];
+            files.emplace_back(PathRef(pools[ref.first], ref.second, e.name_len), stamp);
+            files.back().SetHashSum(Digest(e.hash, e.hash_size));
+            files.back().SetSampleHashSum(Digest(e.sample_hash, e.sample_hash_size));
+        }
+    }
+    return files;
+}
+
+void JoinSnapshots(std::vector<SearchInput>& inputs, std::size_t min_dirs) {
+    if (std::none_of(inputs.begin(), inputs.end(), [](const SearchInput& in) { return in.index != nullptr; })) {
+        return;
+    }
+    PhaseTimer timer(Stats::Phase::Scan);
+
+    const auto n = inputs.size();
+    const auto k = std::min(std::max<std::size_t>(min_dirs, 1), n);
+
+    //sorted sizes of all files of directories, to count files of size by binary search as in snapshots
+    std::vector<std::vector<std::uint64_t>> dir_sizes(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!inputs[i].index) {
+            for (const auto& f : inputs[i].content) {
+                dir_sizes[i].push_back(f.GetFileSize());
+            }
+            std::sort(dir_sizes[i].begin(), dir_sizes[i].end());
+        }
+    }
+    auto count = [&inputs, &dir_sizes](std::size_t i, std::uint64_t size) -> std::size_t {
+        if (inputs[i].index) {
+            const auto r = inputs[i].index->EqualRange(size);
+            return r.second - r.first;
+        }
+        const auto r = std::equal_range(dir_sizes[i].begin(), dir_sizes[i].end(), size);
+        return static_cast<std::size_t>(r.second - r.first);
+    };
+    auto files_num = [&inputs, &dir_sizes](std::size_t i) {
+        return inputs[i].index ? inputs[i].index->Size() : dir_sizes[i].size();
+    };
+
+    //size present in k inputs is present in any n - k + 1 of them: only the smallest ones are read through
+    std::vector<std::size_t> order(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&files_num](std::size_t i1, std::size_t i2) { return files_num(i1) < files_num(i2); });
+
+    std::vector<std::uint64_t> probe;
+    for (std::size_t j = 0; j < n - k + 1; ++j) {
+        const auto i = order[j];
+        if (inputs[i].index) {
+            const auto sizes = inputs[i].index->Sizes();
+            probe.insert(probe.end(), sizes.begin(), sizes.end());
+        }
+        else {
+            probe.insert(probe.end(), dir_sizes[i].begin(), dir_sizes[i].end());
+        }
+    }
+    std::sort(probe.begin(), probe.end());
+    probe.erase(std::unique(probe.begin(), probe.end()), probe.end());
+
+    //sizes of clusters: at least two files in at least k inputs
+    std::vector<std::uint64_t> sizes;
+    for (auto size : probe) {
+        std::size_t inputs_num = 0;
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto c = count(i, size);
+            inputs_num += c != 0 ? 1 : 0;
+            total += c;
+        }
+        if (inputs_num >= k && total >= 2) {
+            sizes.push_back(size);
+        }
+    }
+
+    for (auto& in : inputs) {
+        if (!in.index) {
+            continue;
+        }
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        for (auto size : sizes) {
+            const auto r = in.index->EqualRange(size);
+            if (r.first != r.second) {
+                ranges.push_back(r);
+            }
+        }
+        in.content = in.index->GetFiles(ranges);
+    }
+}
+
+}
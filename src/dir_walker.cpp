@@ -0,0 +1,365 @@
+#include <filesystem>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "dir_walker.h"
+#include "thread_pool.h"
+#include "path_pool.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    //directories kept open for their subdirectories, the rest are opened by full path
+    constexpr std::size_t MAX_OPEN_DIRS = 256;
+
+    //entry of directory reported by the kernel
+    struct DirEntry
+    {
+        const char*     name;
+        unsigned char   type;
+    };
+
+#ifdef __linux__
+    //layout of records returned by getdents64
+    struct LinuxDirent64
+    {
+        ino64_t         d_ino;
+        off64_t         d_off;
+        unsigned short  d_reclen;
+        unsigned char   d_type;
+        char            d_name[1];
+    };
+
+    //call func for every entry of opened directory by big portions
+    template<typename Func>
+    void ForEachEntry(int dir_fd, Func func) {
+        alignas(LinuxDirent64) char buffer[64 * 1024];
+        for (;;) {
+            auto n = ::syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+            if (n <= 0) {
+                break;
+            }
+            for (long pos = 0; pos < n;) {
+                const auto* de = reinterpret_cast<const LinuxDirent64*>(buffer + pos);
+                func(DirEntry{ de->d_name, de->d_type });
+                pos += de->d_reclen;
+            }
+        }
+    }
+#else
+    template<typename Func>
+    void ForEachEntry(int dir_fd, Func func) {
+        //readdir takes ownership of descriptor
+        int fd = ::dup(dir_fd);
+        DIR* dir = fd >= 0 ? ::fdopendir(fd) : nullptr;
+        if (!dir) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return;
+        }
+        while (const auto* de = ::readdir(dir)) {
+            func(DirEntry{ de->d_name, de->d_type });
+        }
+        ::closedir(dir);
+    }
+#endif
+
+    bool IsDotOrDotDot(const char* name) {
+        return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+    }
+
+    std::string JoinPath(const std::string& dir, const char* name) {
+        std::string res;
+        res.reserve(dir.size() + 1 + std::strlen(name));
+        res = dir;
+        if (res.empty() || res.back() != '/') {
+            res += '/';
+        }
+        res += name;
+        return res;
+    }
+}
+
+DirWalker::DirFd::DirFd(int fd, std::atomic<std::size_t>& open_num) : m_fd(fd), m_open_num(open_num) {
+    ++m_open_num;
+}
+
+DirWalker::DirFd::~DirFd() {
+    ::close(m_fd);
+    --m_open_num;
+}
+
+std::vector<fl::File> DirWalker::Walk(const std::string& root) {
+    m_found.assign(ThreadPool::ThreadsNum(m_options.jobs), {});
+    Walk(root, nullptr);
+
+    //merge results of all workers
+    std::vector<fl::File> res;
+    std::size_t total = 0;
+    for (const auto& found : m_found) {
+        total += found.size();
+    }
+    res.reserve(total);
+    for (auto& found : m_found) {
+        std::move(found.begin(), found.end(), std::back_inserter(res));
+    }
+    m_found.clear();
+    return res;
+}
+
+void DirWalker::Walk(const std::string& root, const FilesCallback& on_files) {
+    //check root in caller's thread in order to report error
+    int fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::filesystem::filesystem_error("cannot open directory", root,
+                                                std::error_code(errno, std::generic_category()));
+    }
+    ::close(fd);
+
+    const auto workers = ThreadPool::ThreadsNum(m_options.jobs);
+    m_queues = std::vector<WorkQueue>(workers);
+    m_on_files = on_files;
+    m_visited.clear();
+    m_failed = false;
+    m_error = nullptr;
+
+    m_pending = 1;
+    m_queues[0].dirs.push_back(PendingDir{ nullptr, root, 0 });
+
+    if (workers == 1) {
+        WorkerLoop(0);
+    }
+    else {
+        ThreadPool pool(workers);
+        for (std::size_t i = 0; i < workers; ++i) {
+            pool.Submit([this, i]() { WorkerLoop(i); });
+        }
+        pool.Wait();
+    }
+    m_on_files = nullptr;
+    m_queues.clear();
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+}
+
+void DirWalker::WorkerLoop(std::size_t worker) {
+    PendingDir dir;
+    while (m_pending != 0 && !m_failed) {
+        if (PopDir(worker, dir)) {
+            try {
+                ScanDir(worker, dir);
+            }
+            catch (...) {
+                //callback failed, the rest of tree is not needed
+                {
+                    std::lock_guard<std::mutex> lk(m_visited_mutex);
+                    if (!m_error) {
+                        m_error = std::current_exception();
+                    }
+                }
+                m_failed = true;
+            }
+            //parent is not kept by finished directory
+            dir = PendingDir{};
+            if (--m_pending == 0 || m_failed) {
+                Notify(true);
+            }
+            continue;
+        }
+
+        //others are scanning, they can produce new work
+        std::unique_lock<std::mutex> lk(m_idle_mutex);
+        m_idle_cv.wait(lk, [this]() { return m_pending == 0 || m_failed || HasDirs(); });
+    }
+}
+
+void DirWalker::Notify(bool all) {
+    //lock orders notification after check of waiting worker
+    std::lock_guard<std::mutex> lk(m_idle_mutex);
+    if (all) {
+        m_idle_cv.notify_all();
+    }
+    else {
+        m_idle_cv.notify_one();
+    }
+}
+
+bool DirWalker::HasDirs() {
+    for (auto& q : m_queues) {
+        std::lock_guard<std::mutex> lk(q.mutex);
+        if (!q.dirs.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DirWalker::PopDir(std::size_t worker, PendingDir& dir) {
+    //own queue - from back (depth first, hot in cache)
+    {
+        auto& q = m_queues[worker];
+        std::lock_guard<std::mutex> lk(q.mutex);
+        if (!q.dirs.empty()) {
+            dir = std::move(q.dirs.back());
+            q.dirs.pop_back();
+            return true;
+        }
+    }
+
+    //steal from others - from front (the oldest, usually the biggest subtrees)
+    for (std::size_t i = 1; i < m_queues.size(); ++i) {
+        auto& q = m_queues[(worker + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lk(q.mutex);
+        if (!q.dirs.empty()) {
+            dir = std::move(q.dirs.front());
+            q.dirs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirWalker::PushDir(std::size_t worker, PendingDir dir) {
+    ++m_pending;
+    {
+        auto& q = m_queues[worker];
+        std::lock_guard<std::mutex> lk(q.mutex);
+        q.dirs.push_back(std::move(dir));
+    }
+    if (m_queues.size() > 1) {
+        Notify(false);
+    }
+}
+
+int DirWalker::OpenDir(const PendingDir& dir) const {
+    if (dir.parent) {
+        //links to directories are opened only if they are followed
+        const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (m_options.follow_symlinks ? 0 : O_NOFOLLOW);
+        const int fd = ::openat(dir.parent->Get(), dir.path.c_str() + dir.name_pos, flags);
+        if (fd >= 0 || (errno != EMFILE && errno != ENFILE)) {
+            return fd;
+        }
+    }
+    return ::open(dir.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+bool DirWalker::MarkVisited(int dir_fd) {
+    struct stat st {};
+    Stats::Add(Stats::Counter::StatCalls);
+    if (::fstat(dir_fd, &st) != 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(m_visited_mutex);
+    return m_visited.emplace(st.st_dev, st.st_ino).second;
+}
+
+void DirWalker::ScanDir(std::size_t worker, const PendingDir& dir) {
+    const auto& dir_path = dir.path;
+    const int dir_fd = OpenDir(dir);
+    if (dir_fd < 0) {
+        return;
+    }
+    Stats::Add(Stats::Counter::DirsRead);
+    if (!MarkVisited(dir_fd)) {
+        ::close(dir_fd);
+        return;
+    }
+    //subdirectories are opened relative to this one while not too many directories are open
+    std::shared_ptr<const DirFd> self;
+    if (m_options.recursive && m_open_dirs < MAX_OPEN_DIRS) {
+        self = std::make_shared<const DirFd>(dir_fd, m_open_dirs);
+    }
+    auto push_dir = [&](const char* name) {
+        auto path = JoinPath(dir_path, name);
+        const auto name_pos = path.size() - std::strlen(name);
+        PushDir(worker, PendingDir{ self, std::move(path), name_pos });
+    };
+
+    //names of all files of directory are kept in one pool
+    auto pool = std::make_shared<PathPool>(dir_path);
+    struct FoundEntry
+    {
+        std::uint32_t   offset;
+        std::uint32_t   len;
+        FileStamp       stamp;
+    };
+    std::vector<FoundEntry> entries;
+
+    ForEachEntry(dir_fd, [&](const DirEntry& de) {
+        if (IsDotOrDotDot(de.name)) {
+            return;
+        }
+
+        if (de.type == DT_DIR) {
+            if (m_options.recursive) {
+                push_dir(de.name);
+            }
+            return;
+        }
+
+        //one stat call per entry gives both type and all attributes of File
+        FileStamp stamp;
+        if (de.type == DT_UNKNOWN && !m_options.follow_symlinks) {
+            //file system doesn't report type, links to directories must be recognized
+            if (!FileStamp::GetAt(dir_fd, de.name, false, stamp)) {
+                return;
+            }
+            if (stamp.IsDir()) {
+                if (m_options.recursive) {
+                    push_dir(de.name);
+                }
+                return;
+            }
+            if (S_ISLNK(stamp.mode) && !FileStamp::GetAt(dir_fd, de.name, true, stamp)) {
+                return;
+            }
+            if (!stamp.IsRegular()) {
+                return;
+            }
+        }
+        else if (!FileStamp::GetAt(dir_fd, de.name, true, stamp)) {
+            return;
+        }
+
+        if (stamp.IsRegular()) {
+            auto len = std::strlen(de.name);
+            entries.push_back(FoundEntry{ pool->Add(de.name, len), static_cast<std::uint32_t>(len), stamp });
+        }
+        else if (stamp.IsDir() && m_options.recursive &&
+                 (de.type != DT_LNK || m_options.follow_symlinks)) {
+            push_dir(de.name);
+        }
+    });
+
+    if (!self) {
+        ::close(dir_fd);
+    }
+    self.reset();
+
+    //pool is not changed any more, files can refer to it
+    std::shared_ptr<const PathPool> names = std::move(pool);
+    if (m_on_files) {
+        std::vector<fl::File> files;
+        files.reserve(entries.size());
+        for (const auto& e : entries) {
+            files.emplace_back(PathRef(names, e.offset, e.len), e.stamp);
+        }
+        m_on_files(std::move(files));
+        return;
+    }
+    auto& found = m_found[worker];
+    for (const auto& e : entries) {
+        found.emplace_back(PathRef(names, e.offset, e.len), e.stamp);
+    }
+}
+
+}
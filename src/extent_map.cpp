@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "extent_map.h"
+#include "hasher.h"
+
+namespace fl {
+
+namespace {
+    //extents got by one ioctl call
+    constexpr std::uint32_t EXTENTS_PER_CALL = 64;
+
+    //physical offset of such extents is not a place of file data
+    constexpr std::uint32_t UNSTABLE_FLAGS = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC |
+                                             FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_ENCRYPTED |
+                                             FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE |
+                                             FIEMAP_EXTENT_DATA_TAIL;
+
+    //layout of extents, the same for equal keys
+    struct ExtentRecord
+    {
+        std::uint64_t   logical;
+        std::uint64_t   physical;
+        std::uint64_t   length;
+        std::uint64_t   unwritten;  //preallocated extent is read as zeros whatever is on disk
+    };
+}
+
+Digest SharedExtentsKey(const std::string& file_path) {
+    const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Digest{};
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return Digest{};
+    }
+    //hash of layout is strong enough as the same hash is trusted for content
+    auto hasher = Hasher::Create(HashKind::XXH3);
+    const std::uint64_t head[] = { st.st_dev, static_cast<std::uint64_t>(st.st_size) };
+    hasher->Add(head, sizeof(head));
+
+    alignas(fiemap) char buf[sizeof(fiemap) + EXTENTS_PER_CALL * sizeof(fiemap_extent)];
+    auto* map = static_cast<fiemap*>(static_cast<void*>(buf));
+    std::uint64_t start = 0;
+    bool shared = false;
+    bool last = false;
+    while (!last) {
+        std::memset(buf, 0, sizeof(buf));
+        map->fm_start = start;
+        map->fm_length = FIEMAP_MAX_OFFSET - start;
+        map->fm_extent_count = EXTENTS_PER_CALL;
+        //dirty pages of reflinked file are not in its extents yet (copy on write is delayed),
+        //without flushing the file still maps to extents of its old copies
+        map->fm_flags = FIEMAP_FLAG_SYNC;
+        if (::ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0) {
+            break;
+        }
+
+        for (std::uint32_t i = 0; i < map->fm_mapped_extents; ++i) {
+            const auto& ext = map->fm_extents[i];
+            if ((ext.fe_flags & FIEMAP_EXTENT_SHARED) == 0 || (ext.fe_flags & UNSTABLE_FLAGS) != 0) {
+                ::close(fd);
+                return Digest{};
+            }
+            const ExtentRecord rec{ ext.fe_logical, ext.fe_physical, ext.fe_length,
+                                    (ext.fe_flags & FIEMAP_EXTENT_UNWRITTEN) != 0 ? 1u : 0u };
+            hasher->Add(&rec, sizeof(rec));
+            shared = true;
+            last = (ext.fe_flags & FIEMAP_EXTENT_LAST) != 0;
+            start = ext.fe_logical + ext.fe_length;
+        }
+    }
+    ::close(fd);
+
+    //file without extents (empty or one hole) has nothing to share
+    return shared && last ? hasher->GetHash() : Digest{};
+}
+
+}
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <tuple>
+
+#include "external_searcher.h"
+#include "dir_walker.h"
+#include "spill_file.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    //scanned file, path is kept in file of paths
+    struct Record
+    {
+        std::uint64_t   size;
+        std::uint64_t   dev;
+        std::uint64_t   ino;
+        std::int64_t    mtime_ns;
+        std::int64_t    ctime_ns;
+        std::uint64_t   path_offset;
+        std::uint32_t   path_len;
+        std::uint32_t   input;
+        std::uint32_t   mode;
+        std::uint32_t   reserved;
+    };
+    static_assert(sizeof(Record) == 64, "records are written to disk as is");
+
+    //by size, files of every size are ordered by input and then by order of scanning
+    bool operator<(const Record& a, const Record& b) {
+        return std::tie(a.size, a.input, a.path_offset) < std::tie(b.size, b.input, b.path_offset);
+    }
+
+    //the least read buffer of one run during merge
+    constexpr std::size_t MIN_RUN_BUFFER = 16 * 1024;
+
+    //sequential reading of sorted run
+    class RunReader
+    {
+    public:
+        RunReader(const SpillFile& file, std::size_t buffer_size) :
+            m_file(file), m_buf(std::max<std::size_t>(buffer_size / sizeof(Record), 1)), m_left(file.Size()) {}
+
+        bool Next(Record& rec) {
+            if (m_pos == m_count) {
+                if (m_left == 0) {
+                    return false;
+                }
+                m_count = std::min<std::uint64_t>(m_buf.size(), m_left / sizeof(Record));
+                m_file.ReadAt(m_offset, m_buf.data(), m_count * sizeof(Record));
+                m_offset += m_count * sizeof(Record);
+                m_left -= m_count * sizeof(Record);
+                m_pos = 0;
+            }
+            rec = m_buf[m_pos++];
+            return true;
+        }
+
+    private:
+        const SpillFile&        m_file;
+        std::vector<Record>     m_buf;
+        std::size_t             m_pos{ 0 };
+        std::size_t             m_count{ 0 };
+        std::uint64_t           m_offset{ 0 };
+        std::uint64_t           m_left;
+    };
+
+    //pass records of sorted runs to on_record in sorted order
+    void MergeRuns(const std::vector<std::unique_ptr<SpillFile>>& runs, std::size_t buffer_size,
+                   const std::function<void(const Record&)>& on_record) {
+        std::vector<RunReader> readers;
+        readers.reserve(runs.size());
+        for (const auto& run : runs) {
+            readers.emplace_back(*run, buffer_size / runs.size());
+        }
+
+        using Head = std::pair<Record, std::size_t>;
+        auto greater = [](const Head& a, const Head& b) { return b.first < a.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(greater)> heads(greater);
+        Record rec{};
+        for (std::size_t i = 0; i < readers.size(); ++i) {
+            if (readers[i].Next(rec)) {
+                heads.emplace(rec, i);
+            }
+        }
+        while (!heads.empty()) {
+            const auto head = heads.top();
+            heads.pop();
+            on_record(head.first);
+            if (readers[head.second].Next(rec)) {
+                heads.emplace(rec, head.second);
+            }
+        }
+    }
+}
+
+ExternalSearcher::ExternalSearcher(DupsSearcher& searcher, std::size_t max_memory, std::string spill_dir) :
+    m_searcher(searcher),
+    m_max_memory(std::max(max_memory, MinMemory)),
+    m_spill_dir(spill_dir.empty() ? std::filesystem::temp_directory_path().string() : std::move(spill_dir)) {
+}
+
+void ExternalSearcher::GetDuplicatedClusters(const std::vector<std::string>& dirs, std::size_t min_dirs,
+                                             const DupsSearcher::ClusterCallback& on_cluster) {
+    min_dirs = std::max<std::size_t>(min_dirs, 1);
+    m_runs_num = 0;
+    if (dirs.size() < min_dirs) {
+        return;
+    }
+
+    //half of budget is for records being sorted, a quarter for merging and a quarter for searched files
+    const auto run_records = m_max_memory / 2 / sizeof(Record);
+    const auto merge_buffer = m_max_memory / 4;
+    const auto batch_budget = m_max_memory / 4;
+
+    SpillFile paths(m_spill_dir, std::min<std::size_t>(m_max_memory / 16, 1 << 20));
+    std::vector<std::unique_ptr<SpillFile>> runs;
+    std::vector<Record> records;
+    records.reserve(run_records);
+
+    auto write_run = [&]() {
+        std::sort(records.begin(), records.end());
+        auto run = std::make_unique<SpillFile>(m_spill_dir, 0);
+        run->Append(records.data(), records.size() * sizeof(Record));
+        run->Flush();
+        runs.push_back(std::move(run));
+        records.clear();
+        ++m_runs_num;
+        Stats::Add(Stats::Counter::SpillRuns);
+    };
+
+    //stage 1: scanning into sorted runs
+    {
+        PhaseTimer timer(Stats::Phase::Scan);
+        DirWalker::Options options;
+        options.jobs = m_searcher.GetJobs();
+        options.recursive = m_searcher.IsRecursive();
+
+        std::mutex mutex;
+        for (std::size_t d = 0; d < dirs.size(); ++d) {
+            DirWalker walker(options);
+            walker.Walk(dirs[d], [&](std::vector<fl::File>&& files) {
+                std::lock_guard<std::mutex> lk(mutex);
+                for (const auto& f : files) {
+                    const auto path = f.GetFilePath();
+                    const auto& st = f.GetStamp();
+                    Record rec{};
+                    rec.size = st.size;
+                    rec.dev = st.dev;
+                    rec.ino = st.ino;
+                    rec.mtime_ns = st.mtime_ns;
+                    rec.ctime_ns = st.ctime_ns;
+                    rec.mode = st.mode;
+                    rec.input = static_cast<std::uint32_t>(d);
+                    rec.path_len = static_cast<std::uint32_t>(path.size());
+                    rec.path_offset = paths.Append(path.data(), path.size());
+                    records.push_back(rec);
+                    if (records.size() >= run_records) {
+                        write_run();
+                    }
+                }
+            });
+        }
+        if (!records.empty()) {
+            write_run();
+        }
+        records = std::vector<Record>();
+        paths.Flush();
+    }
+
+    //stage 2: too many runs are merged by passes, every run needs its own read buffer
+    {
+        PhaseTimer timer(Stats::Phase::Group);
+        const auto fan_in = std::max<std::size_t>(merge_buffer / MIN_RUN_BUFFER, 2);
+        while (runs.size() > fan_in) {
+            std::vector<std::unique_ptr<SpillFile>> part;
+            for (std::size_t i = 0; i < fan_in; ++i) {
+                part.push_back(std::move(runs[i]));
+            }
+            runs.erase(runs.begin(), runs.begin() + static_cast<std::ptrdiff_t>(fan_in));
+
+            auto merged = std::make_unique<SpillFile>(m_spill_dir, merge_buffer / 2);
+            MergeRuns(part, merge_buffer / 2, [&merged](const Record& rec) { merged->Append(&rec, sizeof(rec)); });
+            merged->Flush();
+            runs.push_back(std::move(merged));
+            ++m_runs_num;
+            Stats::Add(Stats::Counter::SpillRuns);
+        }
+    }
+
+    //stage 3: final merge gives size buckets one by one, buckets which can give clusters are searched by batches
+    std::vector<Record> batch;
+    std::size_t batch_size = 0;
+    auto search_batch = [&]() {
+        std::vector<std::vector<fl::File>> contents(dirs.size());
+        std::string path;
+        for (const auto& rec : batch) {
+            path.resize(rec.path_len);
+            paths.ReadAt(rec.path_offset, &path[0], path.size());
+            FileStamp stamp;
+            stamp.dev = rec.dev;
+            stamp.ino = rec.ino;
+            stamp.size = rec.size;
+            stamp.mtime_ns = rec.mtime_ns;
+            stamp.ctime_ns = rec.ctime_ns;
+            stamp.mode = rec.mode;
+            contents[rec.input].emplace_back(path, stamp);
+        }
+        batch.clear();
+        batch_size = 0;
+        m_searcher.GetDuplicatedClusters(contents, min_dirs, on_cluster);
+    };
+
+    std::vector<Record> bucket;
+    auto take_bucket = [&]() {
+        std::size_t inputs = 0;
+        for (std::size_t i = 0; i < bucket.size(); ++i) {
+            if (i == 0 || bucket[i].input != bucket[i - 1].input) {
+                ++inputs;
+            }
+        }
+        if (bucket.size() < 2 || inputs < min_dirs) {
+            Stats::Add(Stats::Counter::AvoidedBySize, bucket.size());
+            bucket.clear();
+            return;
+        }
+
+        for (const auto& rec : bucket) {
+            batch_size += sizeof(fl::File) + sizeof(DupsSearcher::TaggedFile) + rec.path_len;
+        }
+        batch.insert(batch.end(), bucket.begin(), bucket.end());
+        bucket.clear();
+        if (batch_size >= batch_budget) {
+            search_batch();
+        }
+    };
+
+    MergeRuns(runs, merge_buffer, [&](const Record& rec) {
+        if (!bucket.empty() && bucket.front().size != rec.size) {
+            take_bucket();
+        }
+        bucket.push_back(rec);
+    });
+    if (!bucket.empty()) {
+        take_bucket();
+    }
+    if (!batch.empty()) {
+        search_batch();
+    }
+}
+
+}
@@ -1,98 +1,253 @@
-#include <fstream>
-#include <array>
-#include <filesystem>
-
 #include "file.h"
-
-//use md5 for hash
-#include "md5.h"
+#include "hasher.h"
+#include "search_budget.h"
+#include "stats.h"
 
 namespace fl {
 
+namespace {
+    //size of head/tail block used for sample hash
+    std::size_t s_sample_size = 4096;
+    //algorithm for all hashes
+    HashKind s_hash_kind = HashKind::XXH3;
+    //settings of reading for hash calculation
+    ReadOptions s_read_options;
+    //storage of hashes between runs
+    HashCache* s_hash_cache = nullptr;
+}
+
+void File::SetSampleSize(std::size_t sample_size) {
+    s_sample_size = sample_size;
+}
+
+std::size_t File::GetSampleSize() {
+    return s_sample_size;
+}
+
+void File::SetHashKind(HashKind kind) {
+    s_hash_kind = kind;
+}
+
+HashKind File::GetHashKind() {
+    return s_hash_kind;
+}
+
+void File::SetReadOptions(const ReadOptions& options) {
+    s_read_options = options;
+}
+
+const ReadOptions& File::GetReadOptions() {
+    return s_read_options;
+}
+
+void File::SetHashCache(HashCache* cache) {
+    s_hash_cache = cache;
+}
+
+HashCache* File::GetHashCache() {
+    return s_hash_cache;
+}
+
 bool File::FileIsOk(const std::string& file_path) {
-    std::error_code ec;
-    auto res = std::filesystem::is_regular_file(file_path, ec);
-    return !ec && res;
-}
-
-File::File(const std::string& str) : m_file_path(str) {
-    m_is_valid = FileIsOk(m_file_path);
-    if (m_is_valid) {
-        //it is ok, get size from file system
-        std::error_code ec;
-        m_file_size = std::filesystem::file_size(m_file_path, ec);
-        if (ec) {
-            //object not valid
-            m_is_valid = false;
-        }
+    FileStamp stamp;
+    return FileStamp::Get(file_path, stamp) && stamp.IsRegular();
+}
+
+File::File(const std::string& str) : m_path(str) {
+    m_is_valid = FileStamp::Get(str, m_stamp) && m_stamp.IsRegular();
+    if (!m_is_valid) {
+        m_stamp = FileStamp{};
+    }
+}
+
+File::File(const std::string& str, const FileStamp& stamp) : File(PathRef(str), stamp) {
+}
+
+File::File(PathRef path, const FileStamp& stamp) : m_path(std::move(path)),
+                                                   m_stamp(stamp),
+                                                   m_is_valid(stamp.IsRegular()) {
+    if (!m_is_valid) {
+        m_stamp = FileStamp{};
     }
 }
 
 //custom move in order to make source object invalid after moving
-File::File(File&& f) : m_file_path(std::move(f.m_file_path)),
-                       m_file_size(f.m_file_size),
+File::File(File&& f) : m_path(std::move(f.m_path)),
+                       m_stamp(f.m_stamp),
                        m_hash_val(std::move(f.m_hash_val)),
+                       m_sample_hash_val(std::move(f.m_sample_hash_val)),
                        m_is_valid(f.m_is_valid) {
 
-    f.m_file_size = 0;
+    f.m_stamp = FileStamp{};
     f.m_is_valid = false;
 }
 
 File& File::operator=(File&& f) {
-    m_file_path = std::move(f.m_file_path);
-    m_file_size = f.m_file_size;
+    m_path = std::move(f.m_path);
+    m_stamp = f.m_stamp;
     m_hash_val = std::move(f.m_hash_val);
+    m_sample_hash_val = std::move(f.m_sample_hash_val);
     m_is_valid = f.m_is_valid;
 
-    f.m_file_size = 0;
-    f.m_is_valid = 0;
+    f.m_stamp = FileStamp{};
+    f.m_is_valid = false;
 
     return *this;
 }
 
 std::size_t File::GetFileSize() const {
-    return m_file_size;
+    return m_stamp.size;
 }
 
-const std::string& File::GetHashSum() const {
+const Digest& File::GetHashSum(const SearchBudget* budget) const {
     if (!m_hash_val.empty() ||
         !m_is_valid) {
         return m_hash_val;
     }
     //here everithing is ok. Hash is not calculate yet.
 
-    std::ifstream ifs(m_file_path, std::ios_base::binary);
-    if (!ifs.is_open()) {
+    //stamp is taken before reading, so changes during reading will be visible next time
+    if (FindCachedHashSum()) {
+        return m_hash_val;
+    }
+
+    FileReader reader(GetFilePath(), GetReadOptions(), budget);
+    if (!reader.IsOpen()) {
         m_hash_val.clear();
         m_is_valid = false;
         return m_hash_val;
     }
 
-    MD5 md5;
-    static constexpr auto CHUNK_SIZE = MD5::BlockSize;
-    std::array<char, CHUNK_SIZE> buffer{ 0 };
-    size_t bytes_red = 0u;  //count total read bytes
-    while (!ifs.eof()) {
-        ifs.read(buffer.data(), CHUNK_SIZE);
-        auto N = static_cast<std::size_t>(ifs.gcount());
-        bytes_red += N;
-
-        md5.add(buffer.data(), N);
-    }
+    auto hasher = Hasher::Create(GetHashKind());
+    auto bytes_red = reader.Read(0, FileReader::ToEnd, [&hasher](const char* data, std::size_t size) {
+        hasher->Add(data, size);
+    });
+    Stats::Add(Stats::Counter::BytesHashed, bytes_red);
 
     //check that size from file system size counted during hash calculation is the same
     if (bytes_red == GetFileSize()) {
         //it is ok
-        m_hash_val = md5.getHash();
-        m_is_valid = true;
+        SetHashSum(hasher->GetHash());
+        Stats::Add(Stats::Counter::FullHashes);
     }
-    else {
+    else if (!budget || !budget->IsStopped()) {
         m_is_valid = false;
     }
 
     return m_hash_val;
 }
 
+const Digest& File::GetSampleHashSum(const SearchBudget* budget) const {
+    if (!m_sample_hash_val.empty() ||
+        !m_is_valid) {
+        return m_sample_hash_val;
+    }
+
+    if (SampleIsWholeFile()) {
+        //sample covers the whole file - no reason to read it twice
+        m_sample_hash_val = GetHashSum(budget);
+        return m_sample_hash_val;
+    }
+
+    if (FindCachedSampleHashSum()) {
+        return m_sample_hash_val;
+    }
+
+    FileReader reader(GetFilePath(), GetReadOptions(), budget);
+    if (!reader.IsOpen()) {
+        m_is_valid = false;
+        return m_sample_hash_val;
+    }
+
+    auto hasher = Hasher::Create(GetHashKind());
+    auto add = [&hasher](const char* data, std::size_t size) {
+        hasher->Add(data, size);
+    };
+    const auto sample_size = GetSampleSize();
+    auto bytes_red = reader.Read(0, sample_size, add);
+    bytes_red += reader.Read(GetFileSize() - sample_size, sample_size, add);
+    Stats::Add(Stats::Counter::BytesHashed, bytes_red);
+
+    if (bytes_red == 2 * sample_size) {
+        SetSampleHashSum(hasher->GetHash());
+        Stats::Add(Stats::Counter::SampleHashes);
+    }
+    else if (!budget || !budget->IsStopped()) {
+        m_is_valid = false;
+    }
+
+    return m_sample_hash_val;
+}
+
+bool File::SampleIsWholeFile() const {
+    const auto sample_size = GetSampleSize();
+    return sample_size == 0 || GetFileSize() <= 2 * sample_size;
+}
+
+bool File::FindCachedHashSum() const {
+    if (!m_hash_val.empty()) {
+        return true;
+    }
+    auto* cache = GetHashCache();
+    if (m_is_valid && cache && cache->FindHash(m_stamp, m_hash_val)) {
+        Stats::Add(Stats::Counter::CacheHits);
+        return true;
+    }
+    return false;
+}
+
+bool File::FindCachedSampleHashSum() const {
+    if (!m_sample_hash_val.empty()) {
+        return true;
+    }
+    if (SampleIsWholeFile()) {
+        return FindCachedHashSum();
+    }
+    auto* cache = GetHashCache();
+    if (m_is_valid && cache && cache->FindSampleHash(m_stamp, m_sample_hash_val)) {
+        Stats::Add(Stats::Counter::CacheHits);
+        return true;
+    }
+    return false;
+}
+
+void File::SetHashSum(const Digest& hash) const {
+    if (!m_is_valid || !m_hash_val.empty()) {
+        return;
+    }
+    m_hash_val = hash;
+    if (auto* cache = GetHashCache()) {
+        cache->PutHash(m_stamp, m_hash_val);
+    }
+}
+
+void File::SetSampleHashSum(const Digest& hash) const {
+    if (!m_is_valid || !m_sample_hash_val.empty()) {
+        return;
+    }
+    m_sample_hash_val = hash;
+    if (auto* cache = GetHashCache()) {
+        cache->PutSampleHash(m_stamp, m_sample_hash_val);
+    }
+}
+
+bool File::TakeHashesFrom(const File& other) const {
+    //stamps differ if one of objects is taken from old snapshot and file is changed since then
+    if (this == &other || !m_is_valid || !m_stamp.SameFile(other.m_stamp) || m_stamp.size != other.m_stamp.size ||
+        m_stamp.mtime_ns != other.m_stamp.mtime_ns || m_stamp.ctime_ns != other.m_stamp.ctime_ns) {
+        return false;
+    }
+    if (m_sample_hash_val.empty()) {
+        m_sample_hash_val = other.m_sample_hash_val;
+    }
+    if (m_hash_val.empty()) {
+        m_hash_val = other.m_hash_val;
+    }
+    //reading of the same file failed
+    m_is_valid = other.m_is_valid;
+    return true;
+}
+
 bool File::IsOk() const {
     return m_is_valid;
 }
@@ -101,9 +256,8 @@ bool File::IsOk() const {
 //check that files, represented by this File objects are the same
 bool operator==(const File& f1, const File& f2) {
 
-    //check equivalence (trust file system module)
-    if (!std::filesystem::equivalent(f1.GetFilePath(),
-                                     f2.GetFilePath())) {
+    //check identity taken during construction: hardlinks and symlinks to the same file
+    if (!(f1.IsOk() && f2.IsOk() && f1.GetStamp().SameFile(f2.GetStamp()))) {
 
         // if not - files are not the same if fs
 
@@ -113,6 +267,11 @@ bool operator==(const File& f1, const File& f2) {
         }
         //else - ok, sizes are the same
 
+        //then check hash of samples, it is cheap for big files
+        if (f1.GetSampleHashSum() != f2.GetSampleHashSum()) {
+            return false;
+        }
+
         //then check hash sum
         if (f1.GetHashSum() != f2.GetHashSum()) {
             return false;
@@ -123,6 +282,7 @@ bool operator==(const File& f1, const File& f2) {
     //in the end we should check the validity of both files.
     //Files are the same if:
     //  - have the same size;
+    //  - have the same samples hash
     //  - have the same hash
     //  - both are valid
     return f1.IsOk() && f2.IsOk();
@@ -0,0 +1,388 @@
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <cerrno>
+#include <csetjmp>
+#include <csignal>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "file_reader.h"
+#include "page_cache.h"
+#include "search_budget.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    constexpr std::size_t BUFFER_ALIGNMENT = 4096;
+
+    //read buffer is reused by all readers of the thread
+    class AlignedBuffer
+    {
+    public:
+        AlignedBuffer() = default;
+        ~AlignedBuffer() {
+            std::free(m_data);
+        }
+
+        AlignedBuffer(const AlignedBuffer&) = delete;
+        AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+        //return buffer not less than size bytes or nullptr
+        char* Get(std::size_t size) {
+            if (size > m_size) {
+                std::free(m_data);
+                m_data = nullptr;
+                m_size = 0;
+
+                void* ptr = nullptr;
+                auto aligned_size = (size + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+                if (posix_memalign(&ptr, BUFFER_ALIGNMENT, aligned_size) != 0) {
+                    return nullptr;
+                }
+                m_data = static_cast<char*>(ptr);
+                m_size = aligned_size;
+            }
+            return m_data;
+        }
+
+    private:
+        char*           m_data{ nullptr };
+        std::size_t     m_size{ 0 };
+    };
+
+    thread_local AlignedBuffer t_buffer;
+
+    //mapped range being consumed by the thread: SIGBUS inside it (file truncated) jumps back to the reader
+    struct MapGuard
+    {
+        sigjmp_buf      env;
+        const char*     begin{ nullptr };
+        const char*     end{ nullptr };
+    };
+
+    thread_local MapGuard* t_map_guard = nullptr;
+    struct sigaction g_old_sigbus {};
+
+    void OnSigbus(int sig, siginfo_t* info, void* context) {
+        auto* guard = t_map_guard;
+        const auto* addr = static_cast<const char*>(info->si_addr);
+        if (guard && addr >= guard->begin && addr < guard->end) {
+            siglongjmp(guard->env, 1);
+        }
+        //not a read of mapped file: previous disposition handles the fault
+        if ((g_old_sigbus.sa_flags & SA_SIGINFO) != 0) {
+            g_old_sigbus.sa_sigaction(sig, info, context);
+            return;
+        }
+        if (g_old_sigbus.sa_handler != SIG_DFL && g_old_sigbus.sa_handler != SIG_IGN) {
+            g_old_sigbus.sa_handler(sig);
+            return;
+        }
+        //faulting instruction is repeated with default action
+        ::sigaction(SIGBUS, &g_old_sigbus, nullptr);
+    }
+
+    void InstallSigbusHandler() {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            struct sigaction sa {};
+            sa.sa_sigaction = OnSigbus;
+            sa.sa_flags = SA_SIGINFO;
+            sigemptyset(&sa.sa_mask);
+            ::sigaction(SIGBUS, &sa, &g_old_sigbus);
+        });
+    }
+}
+
+FileReader::FileReader(const std::string& file_path, const ReadOptions& options, const SearchBudget* budget)
+    : m_options(options), m_budget(budget) {
+    if (m_options.buffer_size == 0) {
+        m_options.buffer_size = ReadOptions{}.buffer_size;
+    }
+    if (m_options.cache == CacheMode::Direct) {
+        m_fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        if (m_fd < 0 && errno == EINVAL) {
+            m_options.cache = CacheMode::Drop;
+        }
+    }
+    if (m_fd < 0) {
+        m_fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (m_fd >= 0) {
+        Stats::Add(Stats::Counter::FilesOpened);
+        m_cache = std::make_unique<PageCache>(m_fd, m_options);
+
+        struct stat st {};
+        if (m_options.extents && ::fstat(m_fd, &st) == 0 &&
+            static_cast<std::uint64_t>(st.st_blocks) * 512 < static_cast<std::uint64_t>(st.st_size)) {
+            m_sparse = true;
+            m_size = static_cast<std::uint64_t>(st.st_size);
+        }
+    }
+}
+
+FileReader::~FileReader() {
+    m_cache.reset();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool FileReader::IsOpen() const {
+    return m_fd >= 0;
+}
+
+std::uint64_t FileReader::Read(std::uint64_t offset, std::uint64_t length, const Consumer& consumer) {
+    if (!IsOpen() || length == 0) {
+        return 0;
+    }
+    return m_sparse ? ReadSparse(offset, length, consumer) : ReadData(offset, length, consumer);
+}
+
+std::uint64_t FileReader::ReadSparse(std::uint64_t offset, std::uint64_t length, const Consumer& consumer) {
+    auto end = offset < m_size ? offset + std::min(length, m_size - offset) : offset;
+    std::uint64_t total = 0;
+    auto pos = offset;
+    while (pos < end) {
+        const auto data = ::lseek(m_fd, static_cast<off_t>(pos), SEEK_DATA);
+        if (data < 0 && errno != ENXIO) {
+            //file system can't tell, the rest is read as is
+            break;
+        }
+        if (data < 0) {
+            //no data till the end of file, but file could be truncated since open
+            struct stat st {};
+            if (::fstat(m_fd, &st) != 0) {
+                break;
+            }
+            end = std::min(end, std::max(pos, static_cast<std::uint64_t>(st.st_size)));
+        }
+        const auto data_pos = data < 0 ? end : std::min(static_cast<std::uint64_t>(data), end);
+        if (data_pos > pos) {
+            const auto passed = PassZeros(data_pos - pos, consumer);
+            total += passed;
+            pos += passed;
+            if (pos != data_pos) {
+                //budget is stopped
+                return total;
+            }
+            continue;
+        }
+
+        const auto hole = ::lseek(m_fd, static_cast<off_t>(pos), SEEK_HOLE);
+        const auto hole_pos = hole < 0 ? end : std::min(static_cast<std::uint64_t>(hole), end);
+        const auto len = hole_pos > pos ? hole_pos - pos : end - pos;
+        const auto got = ReadData(pos, len, consumer);
+        total += got;
+        pos += got;
+        if (got != len) {
+            //error or file is truncated
+            return total;
+        }
+    }
+
+    //file could grow after open
+    if (total < length && pos == offset + total) {
+        total += ReadData(pos, length - total, consumer);
+    }
+    return total;
+}
+
+std::uint64_t FileReader::ReadData(std::uint64_t offset, std::uint64_t length, const Consumer& consumer) {
+    if (m_options.cache == CacheMode::Direct) {
+        return ReadDirect(offset, length, consumer);
+    }
+
+    if (m_options.mmap_threshold != 0) {
+        struct stat st {};
+        if (::fstat(m_fd, &st) == 0) {
+            auto file_size = static_cast<std::uint64_t>(st.st_size);
+            auto available = offset < file_size ? file_size - offset : 0;
+            auto map_len = std::min(length, available);
+            if (map_len >= m_options.mmap_threshold) {
+                auto res = ReadByMap(offset, map_len, consumer);
+                if (res == map_len && length != map_len) {
+                    //file could grow after fstat, read the rest in usual way
+                    res += ReadByBuffer(offset + res, length - res, consumer);
+                }
+                return res;
+            }
+        }
+    }
+
+    return ReadByBuffer(offset, length, consumer);
+}
+
+std::uint64_t FileReader::ReadByBuffer(std::uint64_t offset, std::uint64_t length, const Consumer& consumer) {
+    auto buffer_size = static_cast<std::size_t>(std::min<std::uint64_t>(m_options.buffer_size, length));
+    char* buffer = t_buffer.Get(buffer_size);
+    if (!buffer) {
+        return 0;
+    }
+
+    //kernel reads the next buffer while the current one is consumed
+    auto next_len = [&](std::uint64_t pos) {
+        return pos < length ? std::min<std::uint64_t>(buffer_size, length - pos) : 0;
+    };
+    m_cache->Probe(offset, next_len(0));
+    m_cache->WillNeed(offset, next_len(0));
+
+    std::uint64_t total = 0;
+    while (total < length && !IsStopped()) {
+        auto to_read = static_cast<std::size_t>(std::min<std::uint64_t>(buffer_size, length - total));
+        auto n = ::pread(m_fd, buffer, to_read, static_cast<off_t>(offset + total));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (n == 0) {
+            //end of file
+            break;
+        }
+        const std::uint64_t got = static_cast<std::uint64_t>(n);
+        m_cache->Probe(offset + total + got, next_len(total + got));
+        m_cache->WillNeed(offset + total + got, next_len(total + got));
+        consumer(buffer, static_cast<std::size_t>(n));
+        m_cache->Done(offset + total, got);
+        total += got;
+    }
+    Stats::Add(Stats::Counter::BytesRead, total);
+    return total;
+}
+
+std::uint64_t FileReader::ReadByMap(std::uint64_t offset, std::uint64_t length, const Consumer& consumer) {
+    static const auto page_size = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+
+    //mmap offset must be aligned to page
+    auto map_offset = offset / page_size * page_size;
+    std::size_t shift = offset - map_offset;
+    std::size_t map_len = length + shift;
+
+    void* addr = ::mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, m_fd, static_cast<off_t>(map_offset));
+    if (addr == MAP_FAILED) {
+        return ReadByBuffer(offset, length, consumer);
+    }
+    m_cache->Probe(offset, length);
+    if (m_options.advise) {
+        ::madvise(addr, map_len, MADV_SEQUENTIAL);
+    }
+
+    //pages beyond the end of file truncated since mapping raise SIGBUS. Size is checked before every buffer,
+    //truncation during consumption of the buffer is caught by the guard: both are short reads as for pread
+    InstallSigbusHandler();
+    MapGuard guard;
+    guard.begin = static_cast<const char*>(addr);
+    guard.end = guard.begin + map_len;
+
+    //pass data by buffer_size portions - the same granularity as for usual reading
+    const char* data = static_cast<const char*>(addr) + shift;
+    //kept over siglongjmp
+    volatile std::uint64_t done = 0;
+    if (sigsetjmp(guard.env, 1) == 0) {
+        t_map_guard = &guard;
+        while (done < length && !IsStopped()) {
+            auto n = static_cast<std::size_t>(std::min<std::uint64_t>(m_options.buffer_size, length - done));
+            struct stat st {};
+            if (::fstat(m_fd, &st) != 0) {
+                break;
+            }
+            const auto file_size = static_cast<std::uint64_t>(st.st_size);
+            const auto pos = offset + done;
+            n = static_cast<std::size_t>(std::min<std::uint64_t>(n, pos < file_size ? file_size - pos : 0));
+            if (n == 0) {
+                break;
+            }
+            consumer(data + done, n);
+            done = done + n;
+        }
+    }
+    t_map_guard = nullptr;
+    const std::uint64_t total = done;
+
+    ::munmap(addr, map_len);
+    m_cache->Done(offset, total);
+    Stats::Add(Stats::Counter::BytesRead, total);
+    return total;
+}
+
+std::uint64_t FileReader::ReadDirect(std::uint64_t offset, std::uint64_t length, const Consumer& consumer) {
+    //offset, size and address of O_DIRECT read must be aligned to logical block, page is enough for all devices
+    auto start = offset / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+    std::size_t skip = offset - start;
+    auto buffer_size = static_cast<std::size_t>(std::min<std::uint64_t>(m_options.buffer_size, length + skip));
+    buffer_size = (buffer_size + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+    char* buffer = t_buffer.Get(buffer_size);
+    if (!buffer) {
+        return 0;
+    }
+
+    std::uint64_t total = 0;
+    auto pos = start;
+    while (total < length && !IsStopped()) {
+        //pages are not brought into cache, the probe only tells how much of the file was there
+        m_cache->Probe(pos, buffer_size);
+        auto n = ::pread(m_fd, buffer, buffer_size, static_cast<off_t>(pos));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL && total == 0) {
+                DisableDirect();
+                return Read(offset, length, consumer);
+            }
+            break;
+        }
+        const std::size_t got = static_cast<std::size_t>(n);
+        if (got <= skip) {
+            //end of file
+            break;
+        }
+        const auto useful = static_cast<std::size_t>(std::min<std::uint64_t>(got - skip, length - total));
+        consumer(buffer + skip, useful);
+        m_cache->Done(pos + skip, useful);
+        total += useful;
+        pos += got;
+        skip = 0;
+        if (got < buffer_size) {
+            break;
+        }
+    }
+    Stats::Add(Stats::Counter::BytesRead, total);
+    Stats::Add(Stats::Counter::DirectRead, total);
+    return total;
+}
+
+void FileReader::DisableDirect() {
+    const int flags = ::fcntl(m_fd, F_GETFL);
+    if (flags >= 0) {
+        ::fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+    }
+    m_options.cache = CacheMode::Drop;
+    m_cache = std::make_unique<PageCache>(m_fd, m_options);
+}
+
+bool FileReader::IsStopped() const {
+    return m_budget && m_budget->IsStopped();
+}
+
+std::uint64_t FileReader::PassZeros(std::uint64_t length, const Consumer& consumer) const {
+    //chunks of static buffer
+    static const std::vector<char> zeros(64 * 1024);
+    std::uint64_t total = 0;
+    while (total < length && !IsStopped()) {
+        const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(zeros.size(), length - total));
+        consumer(zeros.data(), n);
+        total += n;
+    }
+    Stats::Add(Stats::Counter::HoleBytes, total);
+    return total;
+}
+
+}
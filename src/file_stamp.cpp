@@ -0,0 +1,60 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "file_stamp.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    std::int64_t ToNs(std::int64_t sec, std::int64_t nsec) {
+        return sec * 1000000000 + nsec;
+    }
+}
+
+bool FileStamp::IsRegular() const {
+    return S_ISREG(mode);
+}
+
+bool FileStamp::IsDir() const {
+    return S_ISDIR(mode);
+}
+
+bool FileStamp::Get(const std::string& file_path, FileStamp& stamp) {
+    return GetAt(AT_FDCWD, file_path.c_str(), true, stamp);
+}
+
+bool FileStamp::GetAt(int dir_fd, const char* name, bool follow_symlinks, FileStamp& stamp) {
+    Stats::Add(Stats::Counter::StatCalls);
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    //ask only for fields we need, file system can skip the rest
+    struct statx stx {};
+    int flags = AT_STATX_SYNC_AS_STAT | (follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW);
+    unsigned mask = STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME | STATX_CTIME;
+    if (::statx(dir_fd, name, flags, mask, &stx) != 0) {
+        return false;
+    }
+    //the same encoding as st_dev of stat
+    stamp.dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    stamp.ino = stx.stx_ino;
+    stamp.size = stx.stx_size;
+    stamp.mtime_ns = ToNs(stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec);
+    stamp.ctime_ns = ToNs(stx.stx_ctime.tv_sec, stx.stx_ctime.tv_nsec);
+    stamp.mode = stx.stx_mode;
+#else
+    struct stat st {};
+    if (::fstatat(dir_fd, name, &st, follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    stamp.dev = static_cast<std::uint64_t>(st.st_dev);
+    stamp.ino = static_cast<std::uint64_t>(st.st_ino);
+    stamp.size = static_cast<std::uint64_t>(st.st_size);
+    stamp.mtime_ns = ToNs(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+    stamp.ctime_ns = ToNs(st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+    stamp.mode = static_cast<std::uint32_t>(st.st_mode);
+#endif
+    return true;
+}
+
+}
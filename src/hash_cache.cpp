@@ -0,0 +1,245 @@
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hash_cache.h"
+
+namespace fl {
+
+namespace {
+    //format of file:
+    //  header: magic, version, hash kind, sample size, generation, number of entries
+    //  entries: dev, ino, size, mtime, ctime, sample hash (len + bytes), hash (len + bytes), generation of last use
+    constexpr char MAGIC[8] = { 'D', 'U', 'P', 'S', 'H', 'C', 'H', 'E' };
+    constexpr std::uint32_t VERSION = 3;
+    //entry with empty hashes: stamp, two digest lengths and generation
+    constexpr std::uint64_t MIN_ENTRY_SIZE = 5 * sizeof(std::uint64_t) + 2 * sizeof(Digest::size) + sizeof(std::uint32_t);
+
+    template<typename T>
+    void WriteValue(std::ostream& os, const T& val) {
+        os.write(reinterpret_cast<const char*>(&val), sizeof(val));
+    }
+
+    template<typename T>
+    bool ReadValue(std::istream& is, T& val) {
+        is.read(reinterpret_cast<char*>(&val), sizeof(val));
+        return is.good();
+    }
+
+    void WriteDigest(std::ostream& os, const Digest& d) {
+        WriteValue(os, d.size);
+        os.write(reinterpret_cast<const char*>(d.bytes.data()), d.size);
+    }
+
+    bool ReadDigest(std::istream& is, Digest& d) {
+        if (!ReadValue(is, d.size) || d.size > Digest::MaxSize) {
+            return false;
+        }
+        is.read(reinterpret_cast<char*>(d.bytes.data()), d.size);
+        return is.good();
+    }
+
+    bool SameStamp(const FileStamp& s1, const FileStamp& s2) {
+        return s1.size == s2.size &&
+               s1.mtime_ns == s2.mtime_ns &&
+               s1.ctime_ns == s2.ctime_ns;
+    }
+}
+
+bool HashCache::Load(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lk(m_mutex);
+    m_entries.clear();
+    m_changed = false;
+    m_generation = 1;
+
+    std::ifstream ifs(path, std::ios_base::binary);
+    if (!ifs.is_open()) {
+        return false;
+    }
+
+    char magic[sizeof(MAGIC)] = {};
+    std::uint32_t version = 0;
+    std::uint32_t kind = 0;
+    std::uint64_t sample_size = 0;
+    std::uint32_t generation = 0;
+    std::uint64_t count = 0;
+    ifs.read(magic, sizeof(magic));
+    if (!ifs.good() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !ReadValue(ifs, version) || version != VERSION ||
+        !ReadValue(ifs, kind) || kind != static_cast<std::uint32_t>(m_kind) ||
+        !ReadValue(ifs, sample_size) || sample_size != m_sample_size ||
+        !ReadValue(ifs, generation) ||
+        !ReadValue(ifs, count)) {
+        return false;
+    }
+
+    //count of damaged file can be anything, the rest of file can't hold more entries than this
+    const auto entries_pos = ifs.tellg();
+    ifs.seekg(0, std::ios_base::end);
+    const auto end_pos = ifs.tellg();
+    ifs.seekg(entries_pos);
+    if (entries_pos < 0 || end_pos < entries_pos ||
+        count > static_cast<std::uint64_t>(end_pos - entries_pos) / MIN_ENTRY_SIZE) {
+        return false;
+    }
+
+    m_entries.reserve(count);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        FileStamp stamp;
+        Digest sample_hash;
+        Digest hash;
+        std::uint32_t used = 0;
+        if (!ReadValue(ifs, stamp.dev) ||
+            !ReadValue(ifs, stamp.ino) ||
+            !ReadValue(ifs, stamp.size) ||
+            !ReadValue(ifs, stamp.mtime_ns) ||
+            !ReadValue(ifs, stamp.ctime_ns) ||
+            !ReadDigest(ifs, sample_hash) ||
+            !ReadDigest(ifs, hash) ||
+            !ReadValue(ifs, used)) {
+            //damaged file, don't trust it at all
+            m_entries.clear();
+            return false;
+        }
+        auto& e = m_entries[stamp.GetId()];
+        e.stamp = stamp;
+        e.sample_hash = sample_hash;
+        e.hash = hash;
+        e.used.store(used, std::memory_order_relaxed);
+    }
+    m_generation = generation + 1;
+    return true;
+}
+
+bool HashCache::Save(const std::string& path) const {
+    std::shared_lock<std::shared_mutex> lk(m_mutex);
+    //unused entries get older only if the file is written
+    std::uint64_t count = 0;
+    bool all_used = true;
+    for (const auto& kv : m_entries) {
+        if (IsAlive(kv.second)) {
+            ++count;
+        }
+        all_used = all_used && kv.second.used.load(std::memory_order_relaxed) == m_generation;
+    }
+    if (!m_changed && all_used) {
+        return true;
+    }
+
+    const auto tmp_path = path + ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream ofs(tmp_path, std::ios_base::binary | std::ios_base::trunc);
+        if (!ofs.is_open()) {
+            return false;
+        }
+
+        ofs.write(MAGIC, sizeof(MAGIC));
+        WriteValue(ofs, VERSION);
+        WriteValue(ofs, static_cast<std::uint32_t>(m_kind));
+        const std::uint64_t sample_size = m_sample_size;
+        WriteValue(ofs, sample_size);
+        WriteValue(ofs, m_generation);
+        WriteValue(ofs, count);
+        for (const auto& kv : m_entries) {
+            const auto& e = kv.second;
+            if (!IsAlive(e)) {
+                continue;
+            }
+            WriteValue(ofs, e.stamp.dev);
+            WriteValue(ofs, e.stamp.ino);
+            WriteValue(ofs, e.stamp.size);
+            WriteValue(ofs, e.stamp.mtime_ns);
+            WriteValue(ofs, e.stamp.ctime_ns);
+            WriteDigest(ofs, e.sample_hash);
+            WriteDigest(ofs, e.hash);
+            WriteValue(ofs, e.used.load(std::memory_order_relaxed));
+        }
+
+        ofs.flush();
+        if (!ofs.good()) {
+            ofs.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    //data must be on disk before rename, otherwise after crash we can get empty cache file
+    int fd = ::open(tmp_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+
+    //readers see either old or new file, never partially written one
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+const HashCache::Entry* HashCache::FindEntry(const FileStamp& stamp) const {
+    auto it = m_entries.find(stamp.GetId());
+    if (it == m_entries.end() || !SameStamp(it->second.stamp, stamp)) {
+        return nullptr;
+    }
+    it->second.used.store(m_generation, std::memory_order_relaxed);
+    return &it->second;
+}
+
+HashCache::Entry& HashCache::GetEntry(const FileStamp& stamp) {
+    auto& e = m_entries[stamp.GetId()];
+    if (!SameStamp(e.stamp, stamp)) {
+        //new file or file has been changed
+        e.stamp = stamp;
+        e.sample_hash = Digest{};
+        e.hash = Digest{};
+    }
+    e.used.store(m_generation, std::memory_order_relaxed);
+    m_changed = true;
+    return e;
+}
+
+bool HashCache::IsAlive(const Entry& e) const {
+    return m_generation - e.used.load(std::memory_order_relaxed) < m_max_age;
+}
+
+bool HashCache::FindHash(const FileStamp& stamp, Digest& hash) const {
+    std::shared_lock<std::shared_mutex> lk(m_mutex);
+    const auto* e = FindEntry(stamp);
+    if (!e || e->hash.empty()) {
+        return false;
+    }
+    hash = e->hash;
+    return true;
+}
+
+bool HashCache::FindSampleHash(const FileStamp& stamp, Digest& hash) const {
+    std::shared_lock<std::shared_mutex> lk(m_mutex);
+    const auto* e = FindEntry(stamp);
+    if (!e || e->sample_hash.empty()) {
+        return false;
+    }
+    hash = e->sample_hash;
+    return true;
+}
+
+void HashCache::PutHash(const FileStamp& stamp, const Digest& hash) {
+    std::unique_lock<std::shared_mutex> lk(m_mutex);
+    GetEntry(stamp).hash = hash;
+}
+
+void HashCache::PutSampleHash(const FileStamp& stamp, const Digest& hash) {
+    std::unique_lock<std::shared_mutex> lk(m_mutex);
+    GetEntry(stamp).sample_hash = hash;
+}
+
+std::size_t HashCache::Size() const {
+    std::shared_lock<std::shared_mutex> lk(m_mutex);
+    return m_entries.size();
+}
+
+}
@@ -0,0 +1,110 @@
+#include "hasher.h"
+
+#include "md5.h"
+#include "sha256.h"
+
+//xxhash is used as header only library. It is C code, so silence our strict warnings
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wcast-align"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace fl {
+
+namespace {
+
+//adapter for classes with md5-like interface
+template<typename T>
+class ClassicHasher : public Hasher
+{
+public:
+    void Add(const void* data, std::size_t size) override {
+        m_impl.add(data, size);
+    }
+
+    Digest GetHash() override {
+        unsigned char raw[T::HashBytes];
+        m_impl.getHash(raw);
+        return Digest(raw, sizeof(raw));
+    }
+
+    void Reset() override {
+        m_impl.reset();
+    }
+
+private:
+    T   m_impl;
+};
+
+class XXH3Hasher : public Hasher
+{
+public:
+    XXH3Hasher() {
+        Reset();
+    }
+
+    void Add(const void* data, std::size_t size) override {
+        XXH3_128bits_update(&m_state, data, size);
+    }
+
+    Digest GetHash() override {
+        XXH128_canonical_t canonical;
+        XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(&m_state));
+        return Digest(canonical.digest, sizeof(canonical.digest));
+    }
+
+    void Reset() override {
+        XXH3_128bits_reset(&m_state);
+    }
+
+private:
+    XXH3_state_t    m_state;
+};
+
+}
+
+std::unique_ptr<Hasher> Hasher::Create(HashKind kind) {
+    switch (kind) {
+    case HashKind::XXH3:
+        return std::make_unique<XXH3Hasher>();
+    case HashKind::MD5:
+        return std::make_unique<ClassicHasher<MD5>>();
+    case HashKind::SHA256:
+        return std::make_unique<ClassicHasher<SHA256>>();
+    }
+    return nullptr;
+}
+
+const char* HashKindName(HashKind kind) {
+    switch (kind) {
+    case HashKind::XXH3:
+        return "xxh3";
+    case HashKind::MD5:
+        return "md5";
+    case HashKind::SHA256:
+        return "sha256";
+    }
+    return "";
+}
+
+bool ParseHashKind(const std::string& name, HashKind& kind) {
+    for (auto k : { HashKind::XXH3, HashKind::MD5, HashKind::SHA256 }) {
+        if (name == HashKindName(k)) {
+            kind = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
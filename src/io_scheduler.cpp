@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "io_scheduler.h"
+#include "thread_pool.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    //files probed by one thread at least
+    constexpr std::size_t MIN_PROBES = 256;
+
+    std::mutex s_devices_mutex;
+    std::unordered_map<std::uint64_t, bool> s_rotational;
+
+    bool DetectRotational(std::uint64_t dev) {
+        //virtual file systems (tmpfs, overlay, btrfs subvolumes, network) have no block device
+        if (major(dev) == 0) {
+            return false;
+        }
+        const auto sys = "/sys/dev/block/" + std::to_string(major(dev)) + ":" + std::to_string(minor(dev));
+        //partition has no queue of its own
+        for (const auto* queue : { "/queue/rotational", "/../queue/rotational" }) {
+            std::ifstream in(sys + queue);
+            int rotational = 0;
+            if (in >> rotational) {
+                return rotational != 0;
+            }
+        }
+        return false;
+    }
+}
+
+bool IoScheduler::IsRotational(std::uint64_t dev) {
+    std::lock_guard<std::mutex> lk(s_devices_mutex);
+    auto it = s_rotational.find(dev);
+    if (it == s_rotational.end()) {
+        it = s_rotational.emplace(dev, DetectRotational(dev)).first;
+    }
+    return it->second;
+}
+
+void IoScheduler::SetRotational(std::uint64_t dev, bool rotational) {
+    std::lock_guard<std::mutex> lk(s_devices_mutex);
+    s_rotational[dev] = rotational;
+}
+
+IoScheduler::Placement IoScheduler::Locate(const fl::File& f) {
+    Placement res;
+    const int fd = ::open(f.GetFilePath().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return res;
+    }
+
+#ifdef RWF_NOWAIT
+    //buffered read with RWF_NOWAIT fails with EAGAIN instead of going to device
+    char byte = 0;
+    iovec iov{ &byte, 1 };
+    res.resident = f.GetFileSize() != 0 && ::preadv2(fd, &iov, 1, 0, RWF_NOWAIT) == 1;
+#endif
+
+    //request for the first extent only
+    alignas(fiemap) char buf[sizeof(fiemap) + sizeof(fiemap_extent)] = {};
+    auto* map = static_cast<fiemap*>(static_cast<void*>(buf));
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    if (::ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents != 0 &&
+        (map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN) == 0) {
+        res.physical = map->fm_extents[0].fe_physical;
+    }
+    ::close(fd);
+    return res;
+}
+
+std::size_t IoScheduler::DeviceLimit(std::uint64_t dev, std::size_t threads) const {
+    if (IsRotational(dev)) {
+        return std::max<std::size_t>(std::min(m_options.rotational_jobs, threads), 1);
+    }
+    return std::max<std::size_t>(threads, 1);
+}
+
+std::vector<const fl::File*> IoScheduler::Order(const std::vector<const fl::File*>& files, std::size_t threads) {
+    //devices in order of the first appearance
+    std::unordered_map<std::uint64_t, std::size_t> dev_idx;
+    std::vector<std::vector<const fl::File*>> devices;
+    for (const auto* f : files) {
+        auto ins = dev_idx.emplace(f->GetStamp().dev, devices.size());
+        if (ins.second) {
+            devices.emplace_back();
+        }
+        devices[ins.first->second].push_back(f);
+    }
+
+    for (const auto& kv : dev_idx) {
+        auto& dev_files = devices[kv.second];
+        if (dev_files.size() < 2 || !IsRotational(kv.first)) {
+            continue;
+        }
+
+        std::vector<std::pair<Placement, const fl::File*>> placed(dev_files.size());
+        auto locate = [this, &placed, &dev_files](std::size_t first, std::size_t last) {
+            for (auto i = first; i < last; ++i) {
+                placed[i] = std::make_pair(m_locator(*dev_files[i]), dev_files[i]);
+            }
+        };
+        const auto probers = std::min(threads, dev_files.size() / MIN_PROBES);
+        if (probers <= 1) {
+            locate(0, dev_files.size());
+        }
+        else {
+            ThreadPool pool(probers);
+            const auto step = (dev_files.size() + probers - 1) / probers;
+            for (std::size_t first = 0; first < dev_files.size(); first += step) {
+                const auto last = std::min(first + step, dev_files.size());
+                pool.Submit([&locate, first, last]() { locate(first, last); });
+            }
+            pool.Wait();
+        }
+
+        std::uint64_t resident = 0;
+        for (const auto& p : placed) {
+            if (p.first.resident) {
+                m_resident.insert(p.second);
+                ++resident;
+            }
+        }
+        //cached files cost no seeks, the rest is read in one sweep of disk head
+        std::stable_sort(placed.begin(), placed.end(), [](const auto& a, const auto& b) {
+            if (a.first.resident != b.first.resident) {
+                return a.first.resident;
+            }
+            return a.first.physical < b.first.physical;
+        });
+        for (std::size_t i = 0; i < placed.size(); ++i) {
+            dev_files[i] = placed[i].second;
+        }
+        Stats::Add(Stats::Counter::SeekOrdered, dev_files.size() - resident);
+        Stats::Add(Stats::Counter::ResidentFirst, resident);
+    }
+
+    if (devices.size() == 1) {
+        return std::move(devices.front());
+    }
+    std::vector<const fl::File*> res;
+    res.reserve(files.size());
+    for (std::size_t i = 0; res.size() < files.size(); ++i) {
+        for (const auto& dev_files : devices) {
+            if (i < dev_files.size()) {
+                res.push_back(dev_files[i]);
+            }
+        }
+    }
+    return res;
+}
+
+void IoScheduler::Run(const std::vector<const fl::File*>& files, std::size_t threads,
+                      const std::function<void(const fl::File*)>& func) const {
+    std::vector<bool> cached(files.size());
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        cached[i] = m_resident.count(files[i]) != 0;
+    }
+    Dispatch(files, cached, threads, [&files, &func](std::size_t, std::size_t i) { func(files[i]); });
+}
+
+std::vector<IoScheduler::Batch> IoScheduler::Batches(const std::vector<const fl::File*>& files,
+                                                     std::size_t size) const {
+    //the batch being filled for device and residency
+    std::map<std::pair<std::uint64_t, bool>, std::size_t> batch_of_key;
+    std::vector<Batch> batches;
+    for (const auto* f : files) {
+        const auto key = std::make_pair(f->GetStamp().dev, m_resident.count(f) != 0);
+        auto it = batch_of_key.find(key);
+        if (it == batch_of_key.end() || batches[it->second].size() >= size) {
+            batch_of_key[key] = batches.size();
+            batches.emplace_back();
+        }
+        batches[batch_of_key[key]].push_back(f);
+    }
+    return batches;
+}
+
+void IoScheduler::RunBatches(const std::vector<Batch>& batches, std::size_t threads,
+                             const std::function<void(std::size_t, const Batch&)>& func) const {
+    std::vector<const fl::File*> heads(batches.size());
+    std::vector<bool> cached(batches.size());
+    for (std::size_t i = 0; i < batches.size(); ++i) {
+        heads[i] = batches[i].front();
+        cached[i] = std::all_of(batches[i].begin(), batches[i].end(),
+                                [this](const fl::File* f) { return m_resident.count(f) != 0; });
+    }
+    Dispatch(heads, cached, threads, [&batches, &func](std::size_t worker, std::size_t i) {
+        func(worker, batches[i]);
+    });
+}
+
+void IoScheduler::Dispatch(const std::vector<const fl::File*>& heads, const std::vector<bool>& cached,
+                           std::size_t threads, const std::function<void(std::size_t, std::size_t)>& func) const {
+    if (threads <= 1 || heads.size() <= 1) {
+        for (std::size_t i = 0; i < heads.size(); ++i) {
+            func(0, i);
+        }
+        return;
+    }
+
+    struct Queue
+    {
+        std::vector<std::size_t>        units;
+        std::size_t                     next{ 0 };
+        std::size_t                     running{ 0 };
+        std::size_t                     limit{ 1 };
+    };
+    //one queue for units in page cache, one per device for the rest
+    std::unordered_map<std::uint64_t, std::size_t> dev_idx;
+    std::vector<Queue> queues(1);
+    queues.front().limit = threads;
+    for (std::size_t i = 0; i < heads.size(); ++i) {
+        if (cached[i]) {
+            queues.front().units.push_back(i);
+            continue;
+        }
+        const auto dev = heads[i]->GetStamp().dev;
+        auto ins = dev_idx.emplace(dev, queues.size());
+        if (ins.second) {
+            queues.emplace_back();
+            queues.back().limit = DeviceLimit(dev, threads);
+        }
+        queues[ins.first->second].units.push_back(i);
+    }
+
+    std::size_t workers = 0;
+    for (const auto& q : queues) {
+        workers += std::min(q.limit, q.units.size());
+    }
+    workers = std::min(workers, threads);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr error;
+    auto work = [&](std::size_t worker) {
+        //workers start from different devices
+        std::size_t start = worker % queues.size();
+        std::unique_lock<std::mutex> lk(mutex);
+        while (!error) {
+            Queue* picked = nullptr;
+            bool pending = false;
+            for (std::size_t k = 0; k < queues.size() && !picked; ++k) {
+                auto& q = queues[(start + k) % queues.size()];
+                if (q.next == q.units.size()) {
+                    continue;
+                }
+                pending = true;
+                if (q.running < q.limit) {
+                    picked = &q;
+                    start = (start + k + 1) % queues.size();
+                }
+            }
+            if (!picked) {
+                if (!pending) {
+                    break;
+                }
+                //all devices with files are busy
+                cv.wait(lk);
+                continue;
+            }
+
+            const auto unit = picked->units[picked->next++];
+            ++picked->running;
+            lk.unlock();
+            try {
+                func(worker, unit);
+            }
+            catch (...) {
+                lk.lock();
+                if (!error) {
+                    error = std::current_exception();
+                }
+                lk.unlock();
+            }
+            lk.lock();
+            --picked->running;
+            cv.notify_all();
+        }
+        cv.notify_all();
+    };
+
+    ThreadPool pool(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        pool.Submit([&work, i]() { work(i); });
+    }
+    pool.Wait();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define DUPS_HAS_IO_URING 1
+#endif
+
+#include "io_uring_ring.h"
+
+namespace fl {
+
+#ifdef DUPS_HAS_IO_URING
+
+namespace {
+    template<typename T>
+    T* At(void* base, unsigned offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    unsigned LoadAcquire(const unsigned* p) {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+
+    void StoreRelease(unsigned* p, unsigned v) {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+}
+
+IoUringRing::IoUringRing(unsigned entries) {
+    io_uring_params params{};
+    m_ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (m_ring_fd < 0) {
+        return;
+    }
+
+    m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+    }
+
+    m_sq_ptr = ::mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED) {
+        m_sq_ptr = nullptr;
+        Release();
+        return;
+    }
+    if (single_mmap) {
+        m_cq_ptr = m_sq_ptr;
+    }
+    else {
+        m_cq_ptr = ::mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ptr == MAP_FAILED) {
+            m_cq_ptr = nullptr;
+            Release();
+            return;
+        }
+    }
+
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes_ptr = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+    if (m_sqes_ptr == MAP_FAILED) {
+        m_sqes_ptr = nullptr;
+        Release();
+        return;
+    }
+
+    m_sq_head = At<unsigned>(m_sq_ptr, params.sq_off.head);
+    m_sq_tail = At<unsigned>(m_sq_ptr, params.sq_off.tail);
+    m_sq_mask = At<unsigned>(m_sq_ptr, params.sq_off.ring_mask);
+    m_sq_array = At<unsigned>(m_sq_ptr, params.sq_off.array);
+    m_cq_head = At<unsigned>(m_cq_ptr, params.cq_off.head);
+    m_cq_tail = At<unsigned>(m_cq_ptr, params.cq_off.tail);
+    m_cq_mask = At<unsigned>(m_cq_ptr, params.cq_off.ring_mask);
+    m_cqes = At<void>(m_cq_ptr, params.cq_off.cqes);
+    m_sqes = m_sqes_ptr;
+    m_sq_entries = params.sq_entries;
+}
+
+IoUringRing::~IoUringRing() {
+    Release();
+}
+
+void IoUringRing::Release() {
+    if (m_sqes_ptr) {
+        ::munmap(m_sqes_ptr, m_sqes_size);
+        m_sqes_ptr = nullptr;
+    }
+    if (m_cq_ptr && m_cq_ptr != m_sq_ptr) {
+        ::munmap(m_cq_ptr, m_cq_size);
+    }
+    m_cq_ptr = nullptr;
+    if (m_sq_ptr) {
+        ::munmap(m_sq_ptr, m_sq_size);
+        m_sq_ptr = nullptr;
+    }
+    if (m_ring_fd >= 0) {
+        //registered buffers are released with ring
+        ::close(m_ring_fd);
+        m_ring_fd = -1;
+    }
+}
+
+bool IoUringRing::RegisterBuffers(const std::vector<iovec>& buffers) {
+    if (!IsOk() || buffers.empty()) {
+        return false;
+    }
+    m_registered = ::syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_BUFFERS,
+                             buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+    return m_registered;
+}
+
+bool IoUringRing::QueueRead(int fd, const iovec* iov, int buf_index, std::uint64_t offset, std::uint64_t user_data) {
+    const auto head = LoadAcquire(m_sq_head);
+    const auto tail = *m_sq_tail;
+    if (tail - head >= m_sq_entries) {
+        return false;
+    }
+
+    const auto idx = tail & *m_sq_mask;
+    auto* sqe = static_cast<io_uring_sqe*>(m_sqes) + idx;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    if (m_registered) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = reinterpret_cast<std::uint64_t>(iov->iov_base);
+        sqe->len = static_cast<std::uint32_t>(iov->iov_len);
+        sqe->buf_index = static_cast<std::uint16_t>(buf_index);
+    }
+    else {
+        //vectored read is available since the first kernels with io_uring
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = reinterpret_cast<std::uint64_t>(iov);
+        sqe->len = 1;
+    }
+
+    m_sq_array[idx] = idx;
+    StoreRelease(m_sq_tail, tail + 1);
+    ++m_to_submit;
+    return true;
+}
+
+bool IoUringRing::SubmitAndWait() {
+    for (;;) {
+        auto n = ::syscall(__NR_io_uring_enter, m_ring_fd, m_to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (n >= 0) {
+            m_to_submit -= static_cast<unsigned>(n);
+            return true;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+bool IoUringRing::PopCompletion(std::uint64_t& user_data, int& res) {
+    const auto head = *m_cq_head;
+    if (head == LoadAcquire(m_cq_tail)) {
+        return false;
+    }
+    const auto* cqe = static_cast<const io_uring_cqe*>(m_cqes) + (head & *m_cq_mask);
+    user_data = cqe->user_data;
+    res = cqe->res;
+    StoreRelease(m_cq_head, head + 1);
+    return true;
+}
+
+#else
+
+IoUringRing::IoUringRing(unsigned) {
+}
+
+IoUringRing::~IoUringRing() {
+}
+
+void IoUringRing::Release() {
+}
+
+bool IoUringRing::RegisterBuffers(const std::vector<iovec>&) {
+    return false;
+}
+
+bool IoUringRing::QueueRead(int, const iovec*, int, std::uint64_t, std::uint64_t) {
+    return false;
+}
+
+bool IoUringRing::SubmitAndWait() {
+    return false;
+}
+
+bool IoUringRing::PopCompletion(std::uint64_t&, int&) {
+    return false;
+}
+
+#endif
+
+}
@@ -0,0 +1,73 @@
+#ifndef __IO_URING_RING_H__
+#define __IO_URING_RING_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace fl {
+
+//Minimal io_uring for reading by raw system calls, no liburing needed.
+//Used by one thread only.
+class IoUringRing
+{
+public:
+    //entries - maximum number of requests in flight
+    explicit IoUringRing(unsigned entries);
+    ~IoUringRing();
+
+    IoUringRing(const IoUringRing&) = delete;
+    IoUringRing& operator=(const IoUringRing&) = delete;
+
+    //false if kernel doesn't support io_uring or it is forbidden
+    bool IsOk() const {
+        return m_ring_fd >= 0;
+    }
+
+    //register buffers once, then reads into them don't map pages on every request.
+    //Return false if kernel refused (e.g. RLIMIT_MEMLOCK), reads work without it
+    bool RegisterBuffers(const std::vector<iovec>& buffers);
+
+    //queue read of len bytes at offset into buffer number buf_index of buffers passed to RegisterBuffers
+    //(or into iov if buffers are not registered). Return false if submission queue is full
+    bool QueueRead(int fd, const iovec* iov, int buf_index, std::uint64_t offset, std::uint64_t user_data);
+
+    //pass queued requests to kernel and wait for at least one completion.
+    //Return false on error of io_uring_enter
+    bool SubmitAndWait();
+
+    //take one completion if there is any
+    bool PopCompletion(std::uint64_t& user_data, int& res);
+
+private:
+    void Release();
+
+    int             m_ring_fd{ -1 };
+    bool            m_registered{ false };
+
+    void*           m_sq_ptr{ nullptr };
+    std::size_t     m_sq_size{ 0 };
+    void*           m_cq_ptr{ nullptr };
+    std::size_t     m_cq_size{ 0 };
+    void*           m_sqes_ptr{ nullptr };
+    std::size_t     m_sqes_size{ 0 };
+
+    unsigned*       m_sq_head{ nullptr };
+    unsigned*       m_sq_tail{ nullptr };
+    unsigned*       m_sq_mask{ nullptr };
+    unsigned*       m_sq_array{ nullptr };
+    unsigned*       m_cq_head{ nullptr };
+    unsigned*       m_cq_tail{ nullptr };
+    unsigned*       m_cq_mask{ nullptr };
+    void*           m_cqes{ nullptr };
+    void*           m_sqes{ nullptr };
+
+    unsigned        m_sq_entries{ 0 };
+    unsigned        m_to_submit{ 0 };
+};
+
+}
+
+#endif // ! __IO_URING_RING_H__
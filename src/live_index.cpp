@@ -0,0 +1,310 @@
+#include <filesystem>
+#include <system_error>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "live_index.h"
+
+namespace fl {
+
+namespace {
+    constexpr std::uint32_t DIR_EVENTS = IN_CREATE | IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_DELETE |
+                                         IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+    std::string JoinPath(const std::string& dir, const std::string& name) {
+        std::string res = dir;
+        if (res.empty() || res.back() != '/') {
+            res += '/';
+        }
+        res += name;
+        return res;
+    }
+
+    bool IsUnder(const std::string& path, const std::string& dir) {
+        if (path.size() <= dir.size() || path.compare(0, dir.size(), dir) != 0) {
+            return false;
+        }
+        return dir.back() == '/' || path[dir.size()] == '/';
+    }
+}
+
+LiveIndex::LiveIndex(DupsSearcher& searcher, std::vector<std::string> dirs) : m_searcher(searcher),
+                                                                              m_dirs(std::move(dirs)),
+                                                                              m_contents(m_dirs.size()),
+                                                                              m_positions(m_dirs.size()) {
+}
+
+LiveIndex::~LiveIndex() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void LiveIndex::Build() {
+    if (m_fd < 0) {
+        m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Cannot init inotify");
+        }
+    }
+
+    //watches are added before scanning, so changes made during scanning are not lost
+    for (std::size_t i = 0; i < m_dirs.size(); ++i) {
+        if (!AddWatches(i, m_dirs[i])) {
+            throw std::filesystem::filesystem_error("cannot watch directory", m_dirs[i],
+                                                    std::error_code(errno, std::generic_category()));
+        }
+        m_contents[i] = m_searcher.GetDirectoryContent(m_dirs[i]);
+        m_positions[i].clear();
+        for (std::size_t pos = 0; pos < m_contents[i].size(); ++pos) {
+            m_positions[i][m_contents[i][pos].GetFilePath()] = pos;
+        }
+    }
+}
+
+bool LiveIndex::AddWatches(std::size_t input, const std::string& dir) {
+    //errors in subdirectories are ignored as by scanning
+    bool res = false;
+    std::vector<std::string> dirs{ dir };
+    while (!dirs.empty()) {
+        auto cur = std::move(dirs.back());
+        dirs.pop_back();
+
+        const auto mask = cur == m_dirs[input] ? DIR_EVENTS : DIR_EVENTS | IN_DONT_FOLLOW;
+        const auto wd = ::inotify_add_watch(m_fd, cur.c_str(), mask);
+        if (wd < 0) {
+            continue;
+        }
+        res = res || cur == dir;
+        auto& watches = m_watches[wd];
+        bool known = false;
+        for (auto& w : watches) {
+            if (w.input == input) {
+                //directory is renamed inside of input, its watch follows it
+                w.dir = cur;
+                known = true;
+            }
+        }
+        if (!known) {
+            watches.push_back({ input, cur });
+        }
+
+        if (!m_searcher.IsRecursive()) {
+            continue;
+        }
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(cur, ec), end; !ec && it != end; it.increment(ec)) {
+            std::error_code type_ec;
+            if (it->is_directory(type_ec) && !it->is_symlink(type_ec)) {
+                dirs.push_back(JoinPath(cur, it->path().filename().string()));
+            }
+        }
+    }
+    return res;
+}
+
+void LiveIndex::RemoveWatches(std::size_t input, const std::string& dir) {
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        auto& watches = it->second;
+        for (auto w = watches.begin(); w != watches.end();) {
+            if (w->input == input && (w->dir == dir || IsUnder(w->dir, dir))) {
+                w = watches.erase(w);
+            }
+            else {
+                ++w;
+            }
+        }
+        if (watches.empty()) {
+            ::inotify_rm_watch(m_fd, it->first);
+            it = m_watches.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+std::size_t LiveIndex::Update(int timeout_ms) {
+    pollfd pfd{ m_fd, POLLIN, 0 };
+    if (m_fd < 0 || ::poll(&pfd, 1, timeout_ms) <= 0) {
+        return 0;
+    }
+
+    //files are restated after all queued events, so a file written many times is restated once
+    Changes changes;
+    std::size_t events = 0;
+    alignas(inotify_event) char buf[64 * 1024];
+    while (true) {
+        const auto len = ::read(m_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+        for (ssize_t pos = 0; pos < len;) {
+            const auto* ev = static_cast<const inotify_event*>(static_cast<const void*>(buf + pos));
+            HandleEvent(ev->wd, ev->mask, ev->len ? ev->name : "", changes);
+            pos += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+            ++events;
+        }
+    }
+
+    for (const auto& ch : changes) {
+        UpdateFile(ch.first, ch.second);
+    }
+    return events;
+}
+
+void LiveIndex::HandleEvent(int wd, std::uint32_t mask, const char* name, Changes& changes) {
+    if (mask & IN_Q_OVERFLOW) {
+        //changes are lost, only rescan gives the actual content
+        for (std::size_t i = 0; i < m_dirs.size(); ++i) {
+            AddWatches(i, m_dirs[i]);
+            Rescan(i, m_dirs[i]);
+        }
+        changes.clear();
+        return;
+    }
+    if (mask & IN_IGNORED) {
+        m_watches.erase(wd);
+        return;
+    }
+
+    auto it = m_watches.find(wd);
+    if (it == m_watches.end()) {
+        return;
+    }
+    //watches may be changed by handling
+    const auto watches = it->second;
+    for (const auto& w : watches) {
+        if (mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+            //subdirectories are handled by events of their parents
+            if (w.dir == m_dirs[w.input]) {
+                RemoveDir(w.input, w.dir);
+            }
+            continue;
+        }
+        if (!*name) {
+            continue;
+        }
+
+        auto path = JoinPath(w.dir, name);
+        if (mask & IN_ISDIR) {
+            if (!m_searcher.IsRecursive()) {
+                continue;
+            }
+            if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+                RemoveWatches(w.input, path);
+                RemoveDir(w.input, path);
+            }
+            else if (mask & (IN_CREATE | IN_MOVED_TO)) {
+                //files could be put into directory before it is watched
+                AddWatches(w.input, path);
+                Rescan(w.input, path);
+            }
+            continue;
+        }
+
+        if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+            changes.erase({ w.input, path });
+            RemoveFile(w.input, path);
+        }
+        else {
+            changes.emplace(w.input, std::move(path));
+        }
+    }
+}
+
+void LiveIndex::Rescan(std::size_t input, const std::string& dir) {
+    ++m_rescans;
+    auto known = RemoveDir(input, dir);
+
+    std::vector<fl::File> content;
+    try {
+        content = m_searcher.GetDirectoryContent(dir);
+    }
+    catch (const std::filesystem::filesystem_error&) {
+        //directory is removed already
+        return;
+    }
+
+    for (auto& f : content) {
+        auto it = known.find(f.GetFilePath());
+        if (it != known.end()) {
+            f.TakeHashesFrom(it->second);
+        }
+        Insert(input, std::move(f));
+    }
+}
+
+void LiveIndex::UpdateFile(std::size_t input, const std::string& path) {
+    //file is changed for sure, its old hashes are not taken even if timestamps are the same
+    fl::File f(path);
+    if (!f.IsOk()) {
+        RemoveFile(input, path);
+        return;
+    }
+    Insert(input, std::move(f));
+}
+
+void LiveIndex::RemoveFile(std::size_t input, const std::string& path) {
+    auto& positions = m_positions[input];
+    auto it = positions.find(path);
+    if (it == positions.end()) {
+        return;
+    }
+
+    auto& content = m_contents[input];
+    const auto pos = it->second;
+    positions.erase(it);
+    if (pos + 1 != content.size()) {
+        content[pos] = std::move(content.back());
+        positions[content[pos].GetFilePath()] = pos;
+    }
+    content.pop_back();
+}
+
+std::unordered_map<std::string, fl::File> LiveIndex::RemoveDir(std::size_t input, const std::string& dir) {
+    std::unordered_map<std::string, fl::File> removed;
+    auto& content = m_contents[input];
+    auto& positions = m_positions[input];
+
+    std::vector<fl::File> kept;
+    kept.reserve(content.size());
+    positions.clear();
+    for (auto& f : content) {
+        auto path = f.GetFilePath();
+        if (IsUnder(path, dir)) {
+            removed.emplace(std::move(path), std::move(f));
+        }
+        else {
+            positions[std::move(path)] = kept.size();
+            kept.push_back(std::move(f));
+        }
+    }
+    content = std::move(kept);
+    return removed;
+}
+
+void LiveIndex::Insert(std::size_t input, fl::File&& file) {
+    auto& content = m_contents[input];
+    auto res = m_positions[input].emplace(file.GetFilePath(), content.size());
+    if (res.second) {
+        content.push_back(std::move(file));
+    }
+    else {
+        content[res.first->second] = std::move(file);
+    }
+}
+
+void LiveIndex::Query(std::size_t min_dirs, const DupsSearcher::ClusterCallback& on_cluster) {
+    Update();
+    m_searcher.GetDuplicatedClusters(m_contents, min_dirs, on_cluster);
+}
+
+std::vector<DupsSearcher::DupsCluster> LiveIndex::Query(std::size_t min_dirs) {
+    Update();
+    return m_searcher.GetDuplicatedClusters(m_contents, min_dirs);
+}
+
+}
@@ -1,11 +1,29 @@
 #include <iostream>
+#include <fstream>
 #include <memory>
-#include <list>
 #include <algorithm>
 #include <cassert>
+#include <vector>
+#include <string>
+#include <system_error>
+#include <cerrno>
+#include <filesystem>
+#include <stdexcept>
+#include <functional>
+#include <chrono>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
 
 #include "version.hpp"
 #include "searcher.h"
+#include "dir_index.h"
+#include "live_index.h"
+#include "external_searcher.h"
+#include "result_writer.h"
+#include "stats.h"
 
 //===========================================================
 //base class for application
@@ -15,6 +33,52 @@ public:
     virtual bool ParseArgs(int argc, const char** argv) noexcept = 0;
     virtual int Work() noexcept = 0;
 };
+
+//parse unsigned decimal number
+static bool ParseNumber(const std::string& str, std::size_t& val) {
+    if (str.empty() || !std::all_of(str.begin(), str.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return false;
+    }
+    try {
+        val = static_cast<std::size_t>(std::stoull(str));
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+//check arg is option with given long/short name and extract its value.
+//Supported forms: "--opt=value", "--opt value", "-o value"
+static bool GetOptionValue(const std::string& arg, const std::string& long_name, const std::string& short_name,
+                           int& i, int argc, const char** argv, std::string& value) {
+    if (arg.size() > long_name.size() &&
+        arg.compare(0, long_name.size(), long_name) == 0 &&
+        arg[long_name.size()] == '=') {
+        value = arg.substr(long_name.size() + 1);
+        return true;
+    }
+
+    if (arg == long_name || (!short_name.empty() && arg == short_name)) {
+        if (i + 1 < argc && argv[i + 1]) {
+            value = argv[++i];
+        }
+        else {
+            value.clear();
+        }
+        return true;
+    }
+    return false;
+}
+
+//budget of running search: SIGINT and SIGTERM stop reading, found clusters are written
+static fl::SearchBudget* s_budget = nullptr;
+
+static void StopSearch(int) {
+    if (s_budget) {
+        s_budget->Cancel();
+    }
+}
 //===========================================================
 
 //===========================================================
@@ -25,17 +89,250 @@ public:
     bool ParseArgs(int argc, const char** argv) noexcept override {
         assert(argv != nullptr);
 
-        if (argc != 3) {
-            std::cerr << "Usage: dups FILE1 FILE2\n";
-            return false;
+        //subcommands: "index" writes snapshot, "watch" keeps index of dirs for repeated queries,
+        //"compare" is the same search as without it
+        auto first = 1;
+        if (argc > 1 && argv[1]) {
+            const std::string cmd{ argv[1] };
+            if (cmd == "index") {
+                m_command = Command::Index;
+                first = 2;
+            }
+            else if (cmd == "watch") {
+                m_command = Command::Watch;
+                first = 2;
+            }
+            else if (cmd == "compare") {
+                first = 2;
+            }
         }
 
-        if (argv[1]) {
-            m_d1_path = argv[1];
+        std::vector<std::string> pos_args;
+        for (auto i = first; i < argc; ++i) {
+            if (!argv[i]) {
+                continue;
+            }
+            const std::string arg{ argv[i] };
+
+            std::string value;
+            if (GetOptionValue(arg, "--jobs", "-j", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_jobs)) {
+                    std::cerr << "Invalid value of --jobs: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--sample-size", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_sample_size)) {
+                    std::cerr << "Invalid value of --sample-size: " << value << "\n";
+                    return false;
+                }
+                m_sample_size_set = true;
+            }
+            else if (GetOptionValue(arg, "--hash", "", i, argc, argv, value)) {
+                if (!fl::ParseHashKind(value, m_hash_kind)) {
+                    std::cerr << "Unknown hash algorithm: " << value << "\n";
+                    return false;
+                }
+                m_hash_kind_set = true;
+            }
+            else if (GetOptionValue(arg, "--buffer-size", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_read_options.buffer_size) || m_read_options.buffer_size == 0) {
+                    std::cerr << "Invalid value of --buffer-size: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--mmap-threshold", "", i, argc, argv, value)) {
+                std::size_t threshold = 0;
+                if (!ParseNumber(value, threshold)) {
+                    std::cerr << "Invalid value of --mmap-threshold: " << value << "\n";
+                    return false;
+                }
+                m_read_options.mmap_threshold = threshold;
+            }
+            else if (GetOptionValue(arg, "--io", "", i, argc, argv, value)) {
+                if (value == "pread") {
+                    m_read_options.engine = fl::IoEngine::Pread;
+                }
+                else if (value == "uring") {
+                    m_read_options.engine = fl::IoEngine::Uring;
+                }
+                else {
+                    std::cerr << "Unknown io engine: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--queue-depth", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_read_options.queue_depth) || m_read_options.queue_depth == 0) {
+                    std::cerr << "Invalid value of --queue-depth: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--page-cache", "", i, argc, argv, value)) {
+                if (value == "keep") {
+                    m_read_options.cache = fl::CacheMode::Keep;
+                }
+                else if (value == "drop") {
+                    m_read_options.cache = fl::CacheMode::Drop;
+                }
+                else if (value == "direct") {
+                    m_read_options.cache = fl::CacheMode::Direct;
+                }
+                else {
+                    std::cerr << "Unknown page cache mode: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--cache", "", i, argc, argv, value)) {
+                if (value.empty()) {
+                    std::cerr << "Path of --cache is not specified\n";
+                    return false;
+                }
+                m_cache_path = value;
+            }
+            else if (GetOptionValue(arg, "--cache-max-age", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_cache_max_age) || m_cache_max_age == 0 || m_cache_max_age > UINT32_MAX) {
+                    std::cerr << "Invalid value of --cache-max-age: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--min-dirs", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_min_dirs) || m_min_dirs == 0) {
+                    std::cerr << "Invalid value of --min-dirs: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--format", "", i, argc, argv, value)) {
+                if (!fl::ParseOutputFormat(value, m_format)) {
+                    std::cerr << "Unknown output format: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--output", "-o", i, argc, argv, value)) {
+                if (value.empty()) {
+                    std::cerr << "Path of --output is not specified\n";
+                    return false;
+                }
+                m_output_path = value;
+            }
+            else if (GetOptionValue(arg, "--compare", "", i, argc, argv, value)) {
+                if (value == "hash") {
+                    m_compare_mode = fl::DupsSearcher::CompareMode::Hash;
+                }
+                else if (value == "bytes") {
+                    m_compare_mode = fl::DupsSearcher::CompareMode::Bytes;
+                }
+                else {
+                    std::cerr << "Unknown compare mode: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--max-open", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_max_open_files) || m_max_open_files < 2) {
+                    std::cerr << "Invalid value of --max-open: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--blocks-min-size", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_blocks_min_size)) {
+                    std::cerr << "Invalid value of --blocks-min-size: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--max-memory", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_max_memory) || m_max_memory == 0) {
+                    std::cerr << "Invalid value of --max-memory: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--spill-dir", "", i, argc, argv, value)) {
+                if (value.empty()) {
+                    std::cerr << "Path of --spill-dir is not specified\n";
+                    return false;
+                }
+                m_spill_dir = value;
+            }
+            else if (GetOptionValue(arg, "--deadline", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_deadline) || m_deadline == 0) {
+                    std::cerr << "Invalid value of --deadline: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--max-read", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_max_read) || m_max_read == 0) {
+                    std::cerr << "Invalid value of --max-read: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (GetOptionValue(arg, "--stats-json", "", i, argc, argv, value)) {
+                if (value.empty()) {
+                    std::cerr << "Path of --stats-json is not specified\n";
+                    return false;
+                }
+                m_stats_json_path = value;
+            }
+            else if (GetOptionValue(arg, "--hdd-jobs", "", i, argc, argv, value)) {
+                if (!ParseNumber(value, m_read_options.rotational_jobs) || m_read_options.rotational_jobs == 0) {
+                    std::cerr << "Invalid value of --hdd-jobs: " << value << "\n";
+                    return false;
+                }
+            }
+            else if (arg == "--no-io-schedule") {
+                m_read_options.schedule = false;
+            }
+            else if (arg == "--no-extents") {
+                m_read_options.extents = false;
+            }
+            else if (arg == "--no-fadvise") {
+                m_read_options.advise = false;
+            }
+            else if (arg == "--stats") {
+                m_stats = true;
+            }
+            else if (arg == "--all") {
+                m_min_dirs = 0;
+                m_clusters = true;
+            }
+            else if (arg == "--recursive" || arg == "-r") {
+                m_recursive = true;
+            }
+            else if (!arg.empty() && arg[0] == '-') {
+                std::cerr << "Unknown option: " << arg << "\n";
+                PrintUsage();
+                return false;
+            }
+            else {
+                pos_args.push_back(arg);
+            }
+        }
+
+        if (m_command == Command::Index) {
+            if (pos_args.size() != 1 || m_output_path.empty()) {
+                PrintUsage();
+                return false;
+            }
+            m_dirs = std::move(pos_args);
+            return true;
         }
 
-        if (argv[2]) {
-            m_d2_path = argv[2];
+        if (pos_args.size() < 2) {
+            PrintUsage();
+            return false;
+        }
+
+        m_dirs = std::move(pos_args);
+        //two dirs are compared pairwise unless cluster options are given
+        if (m_min_dirs != 0) {
+            m_clusters = true;
+        }
+        if (m_dirs.size() > 2) {
+            m_clusters = true;
+        }
+        if (m_clusters && m_min_dirs == 0) {
+            m_min_dirs = m_dirs.size();
+        }
+        if (m_min_dirs > m_dirs.size()) {
+            std::cerr << "Value of --min-dirs is greater than number of dirs\n";
+            return false;
         }
         return true;
     }
@@ -44,23 +341,66 @@ public:
         int rc = 0;
 
         try {
-            std::cout << "Search duplicates in dirs:\n - " << m_d1_path << "\n"
-                                                           << " - " << m_d2_path << "\n";
+            //deadline counts from start, scanning is a part of it
+            if (m_deadline != 0) {
+                m_budget.SetDeadline(fl::SearchBudget::Clock::now() + std::chrono::seconds(m_deadline));
+            }
+            m_budget.SetMaxRead(m_max_read);
 
-            fl::DupsSearcher ds;
+            //machine readable output has no header
+            if (m_command != Command::Index && m_format == fl::OutputFormat::Text && m_output_path.empty()) {
+                std::cout << "Search duplicates in dirs:\n";
+                for (const auto& d : m_dirs) {
+                    std::cout << " - " << d << "\n";
+                }
+                std::cout.flush();
+            }
 
-            auto d1_content = ds.GetDirectoryContent(m_d1_path);
-            auto d2_content = ds.GetDirectoryContent(m_d2_path);
+            //hashes of snapshots are comparable only with hashes of the same algorithm
+            if (m_command == Command::Search) {
+                LoadSnapshots();
+            }
 
-            //here we have content of both dirs
-            //group content of directory by size
-            auto grouped_files = ds.GroupBySize(d1_content);
+            fl::File::SetSampleSize(m_sample_size);
+            fl::File::SetHashKind(m_hash_kind);
+            fl::File::SetReadOptions(m_read_options);
+            fl::DupsSearcher ds(m_jobs);
+            ds.SetRecursive(m_recursive);
+            ds.SetCompareMode(m_compare_mode);
+            ds.SetMaxOpenFiles(m_max_open_files);
+            ds.SetBlocksMinSize(m_blocks_min_size);
+
+            std::unique_ptr<fl::HashCache> cache;
+            if (!m_cache_path.empty()) {
+                cache = std::make_unique<fl::HashCache>(m_hash_kind, m_sample_size);
+                cache->SetMaxAge(static_cast<std::uint32_t>(m_cache_max_age));
+                cache->Load(m_cache_path);
+                fl::File::SetHashCache(cache.get());
+            }
 
-            auto dups = ds.GetDuplicatedPairs(d2_content, grouped_files);
+            if (m_command == Command::Index) {
+                WriteSnapshot(ds);
+            }
+            else if (m_command == Command::Watch) {
+                Watch(ds);
+            }
+            else {
+                Search(ds);
+                if (m_unresolved != 0) {
+                    std::cerr << "Search is " << (m_budget.IsCancelled() ? "cancelled" : "out of budget") << ": "
+                              << m_unresolved << " candidate files are not compared\n";
+                    rc = 2;
+                }
+            }
 
-            for (const auto& p : dups) {
-                std::cout << p.first << " = " << p.second << "\n";
+            if (cache) {
+                fl::File::SetHashCache(nullptr);
+                if (!cache->Save(m_cache_path)) {
+                    std::cerr << "Cannot save hash cache into " << m_cache_path << "\n";
+                }
             }
+
+            PrintStats();
         }
         catch (const std::exception& e) {
             std::cerr << e.what() << '\n';
@@ -71,109 +411,284 @@ public:
     }
 
 private:
-    std::string     m_d1_path{};
-    std::string     m_d2_path{};
-};
-
-//===========================================================
-//This implementation just for test - find duplicates in more than two directories (it works)
-class AppSeveralDirs : public AppBase {
-public:
-    AppSeveralDirs() = default;
-
-    bool ParseArgs(int argc, const char** argv) noexcept override {
-        assert(argv != nullptr);
-
-        if (argc < 3) {
-            std::cerr << "Usage: dups FILE1 FILE2 ...\n";
-            return false;
+    void PrintStats() const {
+        if (m_stats) {
+            fl::Stats::PrintSummary(std::cerr);
         }
+        if (!m_stats_json_path.empty()) {
+            std::ofstream ofs(m_stats_json_path);
+            fl::Stats::PrintJson(ofs);
+            if (!ofs) {
+                std::cerr << "Cannot write statistics into " << m_stats_json_path << "\n";
+            }
+        }
+    }
 
-        m_dirs.reserve(argc - 1);
-        for(auto i = 1; i < argc; ++i ){
-            if (argv[i]) {
-                m_dirs.emplace_back(argv[i]);
+    //map inputs which are snapshots and take hash settings from them
+    void LoadSnapshots() {
+        m_snapshots.clear();
+        m_snapshots.resize(m_dirs.size());
+        const fl::DirIndex* first = nullptr;
+        for (std::size_t i = 0; i < m_dirs.size(); ++i) {
+            if (!fl::DirIndex::IsSnapshot(m_dirs[i])) {
+                continue;
             }
+            auto index = std::make_unique<fl::DirIndex>();
+            if (!index->Load(m_dirs[i])) {
+                throw std::runtime_error("Cannot load snapshot " + m_dirs[i] + ": it is damaged or of other version");
+            }
+            if (!first) {
+                first = index.get();
+                if ((m_hash_kind_set && m_hash_kind != first->GetHashKind()) ||
+                    (m_sample_size_set && m_sample_size != first->GetSampleSize())) {
+                    throw std::runtime_error("Snapshot " + m_dirs[i] + " is made with hash " + fl::HashKindName(first->GetHashKind()) +
+                                             " and sample size " + std::to_string(first->GetSampleSize()));
+                }
+                m_hash_kind = first->GetHashKind();
+                m_sample_size = first->GetSampleSize();
+            }
+            else if (index->GetHashKind() != first->GetHashKind() || index->GetSampleSize() != first->GetSampleSize()) {
+                throw std::runtime_error("Snapshots are made with different hash settings: " + m_dirs[i]);
+            }
+            m_snapshots[i] = std::move(index);
+        }
+        if (first && m_compare_mode == fl::DupsSearcher::CompareMode::Bytes) {
+            throw std::runtime_error("Files of snapshot can't be compared byte by byte");
         }
+    }
 
-        return true;
+    //hash every file of directory and write snapshot of it
+    void WriteSnapshot(fl::DupsSearcher& ds) const {
+        const auto root = std::filesystem::absolute(m_dirs.front()).lexically_normal().string();
+        const auto dir = root.size() > 1 && root.back() == '/' ? root.substr(0, root.size() - 1) : root;
+        auto content = ds.GetDirectoryContent(dir);
+        ds.CalcAllHashSums(content);
+        if (!fl::DirIndex::Write(m_output_path, dir, content)) {
+            throw std::runtime_error("Cannot write snapshot into " + m_output_path);
+        }
     }
 
-    int Work() noexcept override {
-        int rc = 0;
+    //every cluster is written as soon as it is found
+    void Search(fl::DupsSearcher& ds) {
+        const auto min_dirs = m_clusters ? m_min_dirs : 2;
+        if (m_max_memory != 0) {
+            if (std::any_of(m_snapshots.begin(), m_snapshots.end(), [](const auto& s) { return s != nullptr; })) {
+                throw std::runtime_error("Snapshots can't be searched with --max-memory");
+            }
+            if (HasBudget()) {
+                throw std::runtime_error("--deadline and --max-read can't be used with --max-memory");
+            }
+            fl::ExternalSearcher es(ds, m_max_memory, m_spill_dir);
+            WriteClusters([this, &es, min_dirs](const fl::DupsSearcher::ClusterCallback& on_cluster,
+                                                const fl::DupsSearcher::UnresolvedCallback&) {
+                es.GetDuplicatedClusters(m_dirs, min_dirs, on_cluster);
+            });
+            return;
+        }
 
-        try {
+        if (HasBudget()) {
+            //second signal kills as usual
+            s_budget = &m_budget;
+            struct sigaction sa {};
+            sa.sa_handler = StopSearch;
+            sa.sa_flags = static_cast<int>(SA_RESETHAND);
+            ::sigaction(SIGINT, &sa, nullptr);
+            ::sigaction(SIGTERM, &sa, nullptr);
+        }
 
-            //get content of all dirs
-            std::list<std::vector<fl::File>> content;
+        //directories are scanned, only files of snapshots which can have duplicates are taken
+        std::vector<fl::SearchInput> inputs(m_dirs.size());
+        for (std::size_t i = 0; i < m_dirs.size(); ++i) {
+            if (m_snapshots[i]) {
+                inputs[i].index = std::move(m_snapshots[i]);
+            }
+            else {
+                inputs[i].content = ds.GetDirectoryContent(m_dirs[i]);
+            }
+        }
+        fl::JoinSnapshots(inputs, min_dirs);
 
-            auto min_size_dir = std::numeric_limits<std::size_t>::max();
-            for(const auto& dir_path : m_dirs){
-                auto dir_cont = m_dub_searcher.GetDirectoryContent(dir_path);
-                if(dir_cont.size() < min_size_dir){
-                    content.emplace_front(std::move(dir_cont));
-                }
-                else{
-                    content.emplace_back(std::move(dir_cont));
-                }
+        std::vector<std::vector<fl::File>> contents;
+        contents.reserve(inputs.size());
+        for (auto& in : inputs) {
+            contents.emplace_back(std::move(in.content));
+        }
 
-                min_size_dir = content.front().size();
+        WriteClusters([this, &ds, &contents, min_dirs](const fl::DupsSearcher::ClusterCallback& on_cluster,
+                                                       const fl::DupsSearcher::UnresolvedCallback& on_unresolved) {
+            if (!HasBudget()) {
+                ds.GetDuplicatedClusters(contents, min_dirs, on_cluster);
+                return;
             }
+            ds.GetDuplicatedClusters(contents, min_dirs, m_budget, on_cluster,
+                                     [this, &on_unresolved](const std::vector<fl::DupsSearcher::TaggedFile>& files) {
+                                         m_unresolved += files.size();
+                                         on_unresolved(files);
+                                     });
+        });
+    }
 
-            //the first vector in list has the smallest len. Extract it
-            m_min_dir_content = std::move(content.front());
-            content.pop_front();
-            //==================================
-
-            //Create vector of maps grouped by size
-            m_grouped_by_size_content.clear();
-            m_grouped_by_size_content.reserve(content.size());
+    //search is limited by --deadline or --max-read, or can be cancelled by signal
+    bool HasBudget() const {
+        return m_deadline != 0 || m_max_read != 0;
+    }
 
-            for(const auto& dir_content : content){
-                m_grouped_by_size_content.emplace_back(m_dub_searcher.GroupBySize(dir_content));
+    //scan dirs once and keep their content up to date by file system events.
+    //Every line of stdin prints current duplicates (output file is rewritten), end of stdin stops watching
+    void Watch(fl::DupsSearcher& ds) const {
+        fl::LiveIndex index(ds, m_dirs);
+        index.Build();
+
+        const auto min_dirs = m_clusters ? m_min_dirs : 2;
+        auto query = [this, &index, min_dirs]() {
+            WriteClusters([&index, min_dirs](const fl::DupsSearcher::ClusterCallback& on_cluster,
+                                             const fl::DupsSearcher::UnresolvedCallback&) {
+                index.Query(min_dirs, on_cluster);
+            });
+            //answers printed into stdout are separated by empty line
+            if (m_output_path.empty() && (m_format == fl::OutputFormat::Text || m_format == fl::OutputFormat::JSONL)) {
+                std::cout << std::endl;
             }
-            //=================================
-
-            //main processing is here - determine vector of common objects between all dirs
-            for(const auto& group : m_grouped_by_size_content){
-                auto dups = m_dub_searcher.GetDuplicatedFiles(m_min_dir_content, group);
-                m_min_dir_content = std::move(dups);
-                if(m_min_dir_content.empty()){
+        };
+        query();
+
+        pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { index.GetFd(), POLLIN, 0 } };
+        std::vector<char> buf(4096);
+        while (true) {
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "Cannot wait for events");
+            }
+            if (fds[1].revents & POLLIN) {
+                index.Update(0);
+            }
+            if (fds[0].revents & (POLLIN | POLLHUP)) {
+                const auto len = ::read(STDIN_FILENO, buf.data(), buf.size());
+                if (len <= 0) {
                     break;
                 }
+                for (auto n = std::count(buf.begin(), buf.begin() + len, '\n'); n > 0; --n) {
+                    query();
+                }
             }
-            //==========================
-
-            PrintResults();
         }
-        catch (const std::exception& e) {
-            std::cerr << e.what() << '\n';
-            rc = 1;
-        }
-
-        return rc;
     }
 
-    void PrintResults() const{
-        for (const auto& p : m_min_dir_content) {
-            std::cout << p.GetFilePath() << " =\n";
+    //open output, pass writer of clusters to search and close output
+    void WriteClusters(const std::function<void(const fl::DupsSearcher::ClusterCallback&,
+                                                const fl::DupsSearcher::UnresolvedCallback&)>& search) const {
+        int fd = STDOUT_FILENO;
+        if (!m_output_path.empty()) {
+            fd = ::open(m_output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "Cannot open " + m_output_path);
+            }
+        }
 
-            for(const auto& group : m_grouped_by_size_content){
-                const auto & vec = group.at(p.GetFileSize());
-                for(const auto& fi : vec){
-                    if( p == fi){
-                        std::cout << "\t= " << fi.GetFilePath() << "\n";
-                    }
-                }
+        try {
+            //two dirs mode is the same search, text output is printed as pairs
+            auto writer = fl::ResultWriter::Create(m_format, fd, !m_clusters);
+            search([&writer](const fl::DupsSearcher::DupsCluster& cl) { writer->Write(cl); },
+                   [&writer](const std::vector<fl::DupsSearcher::TaggedFile>& files) { writer->WriteUnresolved(files); });
+            writer->Flush();
+        }
+        catch (...) {
+            if (fd != STDOUT_FILENO) {
+                ::close(fd);
             }
+            throw;
+        }
+        if (fd != STDOUT_FILENO) {
+            ::close(fd);
         }
     }
 
-private:
-    std::vector<std::string>                        m_dirs;
-    fl::DupsSearcher                                m_dub_searcher;
-    std::vector<fl::File>                           m_min_dir_content;
-    std::vector<fl::DupsSearcher::GroupedFiles>     m_grouped_by_size_content;
+    static void PrintUsage() {
+        std::cerr << "Usage: dups [compare] [OPTIONS] INPUT1 INPUT2 [INPUT...]\n"
+                  << "       dups index [OPTIONS] -o SNAPSHOT DIR\n"
+                  << "       dups watch [OPTIONS] DIR1 DIR2 [DIR...]\n"
+                  << "Two inputs are compared pairwise, more inputs (or --min-dirs, --all) give clusters of identical files.\n"
+                  << "Input is directory or snapshot written by index command: hashes of all its files, so it is\n"
+                  << "compared without scanning and reading. Hash settings of snapshot are used for the whole search.\n"
+                  << "Watch command scans dirs once and follows their changes, every line of stdin prints\n"
+                  << "current duplicates, only changed files are read again\n"
+                  << "Options:\n"
+                  << "  -r, --recursive         scan subdirectories\n"
+                  << "  -j, --jobs N            number of threads for scanning and hashing (0 - all cores, default 1)\n"
+                  << "  --sample-size BYTES     size of head/tail blocks compared before full hash (0 - off, default 4096)\n"
+                  << "  --hash ALGO             hash algorithm: xxh3 (default), md5, sha256\n"
+                  << "  --buffer-size BYTES     size of read buffer (default 1 MiB)\n"
+                  << "  --mmap-threshold BYTES  map files not smaller than this into memory (0 - off, default)\n"
+                  << "  --io ENGINE             read files for hashing by pread (default) or uring - many reads\n"
+                  << "                          of many files in flight by io_uring\n"
+                  << "  --queue-depth N         reads in flight per thread for uring engine (default 32)\n"
+                  << "  --page-cache MODE       keep (default) - leave read pages in page cache, drop - evict pages\n"
+                  << "                          read into cache by hashing, direct - bypass cache by O_DIRECT\n"
+                  << "  --hdd-jobs N            concurrent readers of one rotational disk (default 1), its files\n"
+                  << "                          are read in order of their place on disk, cached ones first\n"
+                  << "  --no-io-schedule        read files in order of search, all threads on every device\n"
+                  << "  --no-extents            read holes of sparse files and files sharing extents (reflinks)\n"
+                  << "                          instead of asking file system where their data is\n"
+                  << "  --no-fadvise            don't give sequential access and readahead hints to kernel\n"
+                  << "  --cache PATH            keep hashes in file between runs\n"
+                  << "  --cache-max-age RUNS    drop hashes of files not met by this number of runs (default 10)\n"
+                  << "  --format FORMAT         output format: text (default), jsonl, nul, binary\n"
+                  << "  -o, --output PATH       write results into file instead of stdout\n"
+                  << "  --compare MODE          hash (default) or bytes - read files of the same size in lockstep\n"
+                  << "                          and compare them byte by byte without hashing\n"
+                  << "  --max-open N            limit of files opened at once by bytes mode (default 256)\n"
+                  << "  --blocks-min-size BYTES files of this size and bigger are compared by 8 to 64 blocks of 64 KiB\n"
+                  << "                          spread across them before full hash (default 1 GiB, 0 - off)\n"
+                  << "  --max-memory BYTES      keep memory of search flat: scanned files are spilled into sorted runs\n"
+                  << "                          on disk, only files of sizes which can have duplicates are loaded\n"
+                  << "  --spill-dir DIR         directory for temporary files of --max-memory (default $TMPDIR or /tmp)\n"
+                  << "  --deadline SECONDS      stop reading files after this time since start, SIGINT and SIGTERM stop\n"
+                  << "                          it too: clusters found by then are written with candidates which are\n"
+                  << "                          not compared (text and jsonl formats), exit code is 2\n"
+                  << "  --max-read BYTES        read not more than this amount of content, the same way. Size groups\n"
+                  << "                          which don't fit the rest are left not compared, smaller ones are read\n"
+                  << "  --stats                 print time of phases and counters of work into stderr\n"
+                  << "  --stats-json PATH       write the same statistics as JSON into file\n"
+                  << "  --min-dirs K            print clusters present in at least K dirs\n"
+                  << "  --all                   print clusters present in all dirs (default for more than two dirs)\n";
+    }
+
+    enum class Command
+    {
+        Search,
+        Index,
+        Watch
+    };
+
+    Command                         m_command{ Command::Search };
+    std::vector<std::string>        m_dirs{};
+    bool                            m_clusters{ false };
+    std::size_t                     m_min_dirs{ 0 };
+    fl::OutputFormat                m_format{ fl::OutputFormat::Text };
+    std::string                     m_output_path{};
+    std::size_t                     m_jobs{ 1 };
+    bool                            m_recursive{ false };
+    std::size_t                     m_sample_size{ fl::File::GetSampleSize() };
+    bool                            m_sample_size_set{ false };
+    fl::HashKind                    m_hash_kind{ fl::File::GetHashKind() };
+    bool                            m_hash_kind_set{ false };
+    fl::ReadOptions                 m_read_options{ fl::File::GetReadOptions() };
+    std::string                     m_cache_path{};
+    std::size_t                     m_cache_max_age{ fl::HashCache::DefaultMaxAge };
+    fl::DupsSearcher::CompareMode   m_compare_mode{ fl::DupsSearcher::CompareMode::Hash };
+    std::size_t                     m_max_open_files{ fl::DupsSearcher().GetMaxOpenFiles() };
+    std::size_t                     m_blocks_min_size{ fl::DupsSearcher().GetBlocksMinSize() };
+    std::size_t                     m_max_memory{ 0 };
+    std::string                     m_spill_dir{};
+    std::size_t                     m_deadline{ 0 };    //seconds
+    std::size_t                     m_max_read{ 0 };
+    fl::SearchBudget                m_budget{};
+    std::size_t                     m_unresolved{ 0 };  //candidate files not compared by budget
+    std::vector<std::unique_ptr<fl::DirIndex>> m_snapshots{};    //by input, nullptr for directory
+    bool                            m_stats{ false };
+    std::string                     m_stats_json_path{};
 };
 
 //===========================================================
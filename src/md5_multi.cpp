@@ -0,0 +1,347 @@
+#include <cstring>
+
+#include "md5_multi.h"
+
+//vector extensions and target attributes of GCC and Clang give kernels for several instruction sets
+//in one translation unit, the widest supported one is selected at runtime
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define DUPS_MD5_X86 1
+#endif
+
+namespace fl {
+
+namespace {
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DUPS_ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define DUPS_ALWAYS_INLINE
+#endif
+
+//the same expressions as in md5.cpp, V is scalar or vector of lanes
+#define MD5_F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define MD5_F2(b, c, d) ((c) ^ ((d) & ((b) ^ (c))))
+#define MD5_F3(b, c, d) ((b) ^ (c) ^ (d))
+#define MD5_F4(b, c, d) ((c) ^ ((b) | ~(d)))
+#define MD5_STEP(f, a, b, c, d, w, k, s)    \
+    a += f(b, c, d) + (w) + (k);            \
+    a = ((a << s) | (a >> (32 - s))) + b
+
+//process blocks of L streams: data[lane] points to blocks of stream, state is a, b, c, d by lanes
+template<typename V, std::size_t L>
+DUPS_ALWAYS_INLINE inline void Md5Blocks(std::uint32_t* state, const std::uint8_t* const* data, std::size_t blocks) {
+    static_assert(sizeof(V) == L * sizeof(std::uint32_t), "one 32-bit word per lane");
+
+    V a, b, c, d;
+    std::memcpy(&a, state, sizeof(V));
+    std::memcpy(&b, state + L, sizeof(V));
+    std::memcpy(&c, state + 2 * L, sizeof(V));
+    std::memcpy(&d, state + 3 * L, sizeof(V));
+
+    for (std::size_t n = 0; n < blocks; ++n) {
+        //transpose: i-th word of all lanes goes to one vector
+        std::uint32_t words[16][L];
+        for (std::size_t lane = 0; lane < L; ++lane) {
+            std::uint32_t block[16];
+            std::memcpy(block, data[lane] + n * MultiMD5::BlockSize, sizeof(block));
+            for (std::size_t i = 0; i < 16; ++i) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+                words[i][lane] = __builtin_bswap32(block[i]);
+#else
+                words[i][lane] = block[i];
+#endif
+            }
+        }
+        V w[16];
+        for (std::size_t i = 0; i < 16; ++i) {
+            std::memcpy(&w[i], words[i], sizeof(V));
+        }
+
+        const V aa = a;
+        const V bb = b;
+        const V cc = c;
+        const V dd = d;
+
+        MD5_STEP(MD5_F1, a, b, c, d, w[ 0], 0xd76aa478u,  7);
+        MD5_STEP(MD5_F1, d, a, b, c, w[ 1], 0xe8c7b756u, 12);
+        MD5_STEP(MD5_F1, c, d, a, b, w[ 2], 0x242070dbu, 17);
+        MD5_STEP(MD5_F1, b, c, d, a, w[ 3], 0xc1bdceeeu, 22);
+        MD5_STEP(MD5_F1, a, b, c, d, w[ 4], 0xf57c0fafu,  7);
+        MD5_STEP(MD5_F1, d, a, b, c, w[ 5], 0x4787c62au, 12);
+        MD5_STEP(MD5_F1, c, d, a, b, w[ 6], 0xa8304613u, 17);
+        MD5_STEP(MD5_F1, b, c, d, a, w[ 7], 0xfd469501u, 22);
+        MD5_STEP(MD5_F1, a, b, c, d, w[ 8], 0x698098d8u,  7);
+        MD5_STEP(MD5_F1, d, a, b, c, w[ 9], 0x8b44f7afu, 12);
+        MD5_STEP(MD5_F1, c, d, a, b, w[10], 0xffff5bb1u, 17);
+        MD5_STEP(MD5_F1, b, c, d, a, w[11], 0x895cd7beu, 22);
+        MD5_STEP(MD5_F1, a, b, c, d, w[12], 0x6b901122u,  7);
+        MD5_STEP(MD5_F1, d, a, b, c, w[13], 0xfd987193u, 12);
+        MD5_STEP(MD5_F1, c, d, a, b, w[14], 0xa679438eu, 17);
+        MD5_STEP(MD5_F1, b, c, d, a, w[15], 0x49b40821u, 22);
+
+        MD5_STEP(MD5_F2, a, b, c, d, w[ 1], 0xf61e2562u,  5);
+        MD5_STEP(MD5_F2, d, a, b, c, w[ 6], 0xc040b340u,  9);
+        MD5_STEP(MD5_F2, c, d, a, b, w[11], 0x265e5a51u, 14);
+        MD5_STEP(MD5_F2, b, c, d, a, w[ 0], 0xe9b6c7aau, 20);
+        MD5_STEP(MD5_F2, a, b, c, d, w[ 5], 0xd62f105du,  5);
+        MD5_STEP(MD5_F2, d, a, b, c, w[10], 0x02441453u,  9);
+        MD5_STEP(MD5_F2, c, d, a, b, w[15], 0xd8a1e681u, 14);
+        MD5_STEP(MD5_F2, b, c, d, a, w[ 4], 0xe7d3fbc8u, 20);
+        MD5_STEP(MD5_F2, a, b, c, d, w[ 9], 0x21e1cde6u,  5);
+        MD5_STEP(MD5_F2, d, a, b, c, w[14], 0xc33707d6u,  9);
+        MD5_STEP(MD5_F2, c, d, a, b, w[ 3], 0xf4d50d87u, 14);
+        MD5_STEP(MD5_F2, b, c, d, a, w[ 8], 0x455a14edu, 20);
+        MD5_STEP(MD5_F2, a, b, c, d, w[13], 0xa9e3e905u,  5);
+        MD5_STEP(MD5_F2, d, a, b, c, w[ 2], 0xfcefa3f8u,  9);
+        MD5_STEP(MD5_F2, c, d, a, b, w[ 7], 0x676f02d9u, 14);
+        MD5_STEP(MD5_F2, b, c, d, a, w[12], 0x8d2a4c8au, 20);
+
+        MD5_STEP(MD5_F3, a, b, c, d, w[ 5], 0xfffa3942u,  4);
+        MD5_STEP(MD5_F3, d, a, b, c, w[ 8], 0x8771f681u, 11);
+        MD5_STEP(MD5_F3, c, d, a, b, w[11], 0x6d9d6122u, 16);
+        MD5_STEP(MD5_F3, b, c, d, a, w[14], 0xfde5380cu, 23);
+        MD5_STEP(MD5_F3, a, b, c, d, w[ 1], 0xa4beea44u,  4);
+        MD5_STEP(MD5_F3, d, a, b, c, w[ 4], 0x4bdecfa9u, 11);
+        MD5_STEP(MD5_F3, c, d, a, b, w[ 7], 0xf6bb4b60u, 16);
+        MD5_STEP(MD5_F3, b, c, d, a, w[10], 0xbebfbc70u, 23);
+        MD5_STEP(MD5_F3, a, b, c, d, w[13], 0x289b7ec6u,  4);
+        MD5_STEP(MD5_F3, d, a, b, c, w[ 0], 0xeaa127fau, 11);
+        MD5_STEP(MD5_F3, c, d, a, b, w[ 3], 0xd4ef3085u, 16);
+        MD5_STEP(MD5_F3, b, c, d, a, w[ 6], 0x04881d05u, 23);
+        MD5_STEP(MD5_F3, a, b, c, d, w[ 9], 0xd9d4d039u,  4);
+        MD5_STEP(MD5_F3, d, a, b, c, w[12], 0xe6db99e5u, 11);
+        MD5_STEP(MD5_F3, c, d, a, b, w[15], 0x1fa27cf8u, 16);
+        MD5_STEP(MD5_F3, b, c, d, a, w[ 2], 0xc4ac5665u, 23);
+
+        MD5_STEP(MD5_F4, a, b, c, d, w[ 0], 0xf4292244u,  6);
+        MD5_STEP(MD5_F4, d, a, b, c, w[ 7], 0x432aff97u, 10);
+        MD5_STEP(MD5_F4, c, d, a, b, w[14], 0xab9423a7u, 15);
+        MD5_STEP(MD5_F4, b, c, d, a, w[ 5], 0xfc93a039u, 21);
+        MD5_STEP(MD5_F4, a, b, c, d, w[12], 0x655b59c3u,  6);
+        MD5_STEP(MD5_F4, d, a, b, c, w[ 3], 0x8f0ccc92u, 10);
+        MD5_STEP(MD5_F4, c, d, a, b, w[10], 0xffeff47du, 15);
+        MD5_STEP(MD5_F4, b, c, d, a, w[ 1], 0x85845dd1u, 21);
+        MD5_STEP(MD5_F4, a, b, c, d, w[ 8], 0x6fa87e4fu,  6);
+        MD5_STEP(MD5_F4, d, a, b, c, w[15], 0xfe2ce6e0u, 10);
+        MD5_STEP(MD5_F4, c, d, a, b, w[ 6], 0xa3014314u, 15);
+        MD5_STEP(MD5_F4, b, c, d, a, w[13], 0x4e0811a1u, 21);
+        MD5_STEP(MD5_F4, a, b, c, d, w[ 4], 0xf7537e82u,  6);
+        MD5_STEP(MD5_F4, d, a, b, c, w[11], 0xbd3af235u, 10);
+        MD5_STEP(MD5_F4, c, d, a, b, w[ 2], 0x2ad7d2bbu, 15);
+        MD5_STEP(MD5_F4, b, c, d, a, w[ 9], 0xeb86d391u, 21);
+
+        a += aa;
+        b += bb;
+        c += cc;
+        d += dd;
+    }
+
+    std::memcpy(state, &a, sizeof(V));
+    std::memcpy(state + L, &b, sizeof(V));
+    std::memcpy(state + 2 * L, &c, sizeof(V));
+    std::memcpy(state + 3 * L, &d, sizeof(V));
+}
+
+#undef MD5_STEP
+#undef MD5_F4
+#undef MD5_F3
+#undef MD5_F2
+#undef MD5_F1
+
+void BlocksScalar(std::uint32_t* state, const std::uint8_t* const* data, std::size_t blocks) {
+    Md5Blocks<std::uint32_t, 1>(state, data, blocks);
+}
+
+#ifdef DUPS_MD5_X86
+typedef std::uint32_t U32x4 __attribute__((vector_size(16)));
+typedef std::uint32_t U32x8 __attribute__((vector_size(32)));
+typedef std::uint32_t U32x16 __attribute__((vector_size(64)));
+
+//SSE2 is a part of x86-64
+void BlocksSSE2(std::uint32_t* state, const std::uint8_t* const* data, std::size_t blocks) {
+    Md5Blocks<U32x4, 4>(state, data, blocks);
+}
+
+__attribute__((target("avx2")))
+void BlocksAVX2(std::uint32_t* state, const std::uint8_t* const* data, std::size_t blocks) {
+    Md5Blocks<U32x8, 8>(state, data, blocks);
+}
+
+__attribute__((target("avx512f")))
+void BlocksAVX512(std::uint32_t* state, const std::uint8_t* const* data, std::size_t blocks) {
+    Md5Blocks<U32x16, 16>(state, data, blocks);
+}
+#endif
+
+}
+
+MultiMD5::Kernel MultiMD5::Best() {
+    static const Kernel best = [] {
+        for (auto k : { Kernel::AVX512, Kernel::AVX2, Kernel::SSE2 }) {
+            if (IsSupported(k)) {
+                return k;
+            }
+        }
+        return Kernel::Scalar;
+    }();
+    return best;
+}
+
+bool MultiMD5::IsSupported(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar:
+        return true;
+#ifdef DUPS_MD5_X86
+    case Kernel::SSE2:
+        return true;
+    case Kernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case Kernel::AVX512:
+        return __builtin_cpu_supports("avx512f");
+#else
+    case Kernel::SSE2:
+    case Kernel::AVX2:
+    case Kernel::AVX512:
+        break;
+#endif
+    }
+    return false;
+}
+
+std::size_t MultiMD5::LanesOf(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar:
+        return 1;
+    case Kernel::SSE2:
+        return 4;
+    case Kernel::AVX2:
+        return 8;
+    case Kernel::AVX512:
+        return 16;
+    }
+    return 1;
+}
+
+const char* MultiMD5::KernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar:
+        return "scalar";
+    case Kernel::SSE2:
+        return "sse2";
+    case Kernel::AVX2:
+        return "avx2";
+    case Kernel::AVX512:
+        return "avx512";
+    }
+    return "";
+}
+
+MultiMD5::MultiMD5(std::size_t streams, Kernel kernel) : m_blocks(BlocksScalar),
+                                                         m_lanes(LanesOf(kernel)),
+                                                         m_streams(std::min(std::max<std::size_t>(streams, 1), m_lanes)),
+                                                         m_state(4 * m_lanes),
+                                                         m_buffer(m_lanes * BlockSize) {
+#ifdef DUPS_MD5_X86
+    switch (kernel) {
+    case Kernel::Scalar:
+        break;
+    case Kernel::SSE2:
+        m_blocks = BlocksSSE2;
+        break;
+    case Kernel::AVX2:
+        m_blocks = BlocksAVX2;
+        break;
+    case Kernel::AVX512:
+        m_blocks = BlocksAVX512;
+        break;
+    }
+#else
+    m_lanes = 1;
+    m_streams = 1;
+#endif
+    Reset();
+}
+
+void MultiMD5::Reset() {
+    //according to RFC 1321
+    const std::uint32_t init[4] = { 0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u };
+    for (std::size_t r = 0; r < 4; ++r) {
+        for (std::size_t lane = 0; lane < m_lanes; ++lane) {
+            m_state[r * m_lanes + lane] = init[r];
+        }
+    }
+    m_buffer_size = 0;
+    m_num_bytes = 0;
+}
+
+void MultiMD5::ProcessBuffer() {
+    //lanes without stream repeat the first one, their result is dropped
+    const std::uint8_t* ptrs[MaxLanes];
+    for (std::size_t lane = 0; lane < m_lanes; ++lane) {
+        ptrs[lane] = m_buffer.data() + (lane < m_streams ? lane : 0) * BlockSize;
+    }
+    m_blocks(m_state.data(), ptrs, 1);
+    m_buffer_size = 0;
+}
+
+void MultiMD5::Add(const void* const* data, std::size_t size) {
+    m_num_bytes += size;
+
+    std::size_t pos = 0;
+    if (m_buffer_size > 0) {
+        pos = std::min(BlockSize - m_buffer_size, size);
+        for (std::size_t s = 0; s < m_streams; ++s) {
+            std::memcpy(m_buffer.data() + s * BlockSize + m_buffer_size, data[s], pos);
+        }
+        m_buffer_size += pos;
+        if (m_buffer_size < BlockSize) {
+            return;
+        }
+        ProcessBuffer();
+    }
+
+    const auto blocks = (size - pos) / BlockSize;
+    if (blocks != 0) {
+        const std::uint8_t* ptrs[MaxLanes];
+        for (std::size_t lane = 0; lane < m_lanes; ++lane) {
+            ptrs[lane] = static_cast<const std::uint8_t*>(data[lane < m_streams ? lane : 0]) + pos;
+        }
+        m_blocks(m_state.data(), ptrs, blocks);
+        pos += blocks * BlockSize;
+    }
+
+    m_buffer_size = size - pos;
+    for (std::size_t s = 0; s < m_streams && m_buffer_size != 0; ++s) {
+        std::memcpy(m_buffer.data() + s * BlockSize, static_cast<const std::uint8_t*>(data[s]) + pos, m_buffer_size);
+    }
+}
+
+std::vector<Digest> MultiMD5::GetHashes() {
+    //all streams have the same length, so padding is the same: 0x80, zeros, length in bits
+    std::uint8_t padding[2 * BlockSize] = { 0x80 };
+    const auto pad_size = (m_buffer_size < 56 ? 56 : 120) - m_buffer_size;
+    const std::uint64_t bits = m_num_bytes * 8;
+    for (std::size_t i = 0; i < 8; ++i) {
+        padding[pad_size + i] = static_cast<std::uint8_t>(bits >> (8 * i));
+    }
+    const void* ptrs[MaxLanes];
+    for (std::size_t s = 0; s < m_streams; ++s) {
+        ptrs[s] = padding;
+    }
+    Add(ptrs, pad_size + 8);
+
+    std::vector<Digest> res;
+    for (std::size_t s = 0; s < m_streams; ++s) {
+        std::uint8_t raw[16];
+        for (std::size_t r = 0; r < 4; ++r) {
+            const auto v = m_state[r * m_lanes + s];
+            for (std::size_t i = 0; i < 4; ++i) {
+                raw[r * 4 + i] = static_cast<std::uint8_t>(v >> (8 * i));
+            }
+        }
+        res.emplace_back(raw, sizeof(raw));
+    }
+    return res;
+}
+
+}
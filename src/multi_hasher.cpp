@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include "multi_hasher.h"
+#include "md5_multi.h"
+#include "search_budget.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    //lane buffers of all files take Width() * MAX_CHUNK bytes
+    constexpr std::size_t MAX_CHUNK = 256 * 1024;
+}
+
+MultiHasher::MultiHasher(const ReadOptions& options) : m_options(options) {
+    const auto buffer_size = options.buffer_size != 0 ? options.buffer_size : ReadOptions{}.buffer_size;
+    m_chunk = std::max(std::min(buffer_size, MAX_CHUNK) / MultiMD5::BlockSize, std::size_t{ 1 }) * MultiMD5::BlockSize;
+}
+
+std::size_t MultiHasher::Width() {
+    return File::GetHashKind() == HashKind::MD5 ? MultiMD5::LanesOf(MultiMD5::Best()) : 1;
+}
+
+std::vector<std::vector<const fl::File*>> MultiHasher::Batches(const std::vector<const fl::File*>& files) {
+    const auto width = Width();
+    //batch of files of one size on one device
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::size_t> batch_of_key;
+    std::vector<std::vector<const fl::File*>> batches;
+    for (const auto* f : files) {
+        const auto key = std::make_pair(f->GetFileSize(), f->GetStamp().dev);
+        auto it = batch_of_key.find(key);
+        if (it == batch_of_key.end() || batches[it->second].size() == width) {
+            batch_of_key[key] = batches.size();
+            batches.emplace_back();
+        }
+        batches[batch_of_key[key]].push_back(f);
+    }
+    return batches;
+}
+
+void MultiHasher::Run(const std::vector<const fl::File*>& files, const Callback& on_done,
+                      const SearchBudget* budget) {
+    auto done = [&on_done, budget](const fl::File* f) {
+        f->GetHashSum(budget);
+        if (on_done) {
+            on_done(f);
+        }
+    };
+
+    if (Width() == 1) {
+        for (const auto* f : files) {
+            done(f);
+        }
+        return;
+    }
+
+    std::vector<const fl::File*> to_read;
+    for (const auto* f : files) {
+        if (!f->IsOk() || f->GetFileSize() == 0 || f->FindCachedHashSum()) {
+            done(f);
+        }
+        else {
+            to_read.push_back(f);
+        }
+    }
+
+    for (const auto& batch : Batches(to_read)) {
+        if (batch.size() > 1) {
+            RunLanes(batch, budget);
+        }
+        for (const auto* f : batch) {
+            done(f);
+        }
+    }
+}
+
+void MultiHasher::RunLanes(const std::vector<const fl::File*>& files, const SearchBudget* budget) {
+    const std::uint64_t size = files.front()->GetFileSize();
+    m_buffers.resize(files.size() * m_chunk);
+
+    std::vector<std::unique_ptr<FileReader>> readers;
+    std::vector<bool> failed(files.size(), false);
+    std::vector<const void*> ptrs;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        readers.push_back(std::make_unique<FileReader>(files[i]->GetFilePath(), m_options, budget));
+        failed[i] = !readers.back()->IsOpen();
+        ptrs.push_back(m_buffers.data() + i * m_chunk);
+    }
+
+    //failed lane goes on with garbage, its file is checked by usual reading later
+    MultiMD5 md5(files.size());
+    for (std::uint64_t pos = 0; pos < size; pos += m_chunk) {
+        if (budget && budget->IsStopped()) {
+            //files are abandoned: usual reading stops at once and leaves them without hash
+            return;
+        }
+        const auto len = static_cast<std::size_t>(std::min<std::uint64_t>(m_chunk, size - pos));
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            if (failed[i]) {
+                continue;
+            }
+            char* dst = m_buffers.data() + i * m_chunk;
+            std::size_t filled = 0;
+            readers[i]->Read(pos, len, [dst, &filled](const char* data, std::size_t n) {
+                std::copy(data, data + n, dst + filled);
+                filled += n;
+            });
+            failed[i] = filled != len;
+        }
+        md5.Add(ptrs.data(), len);
+    }
+    //file became longer after its size was taken, usual reading marks it not valid
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (!failed[i]) {
+            failed[i] = readers[i]->Read(size, 1, [](const char*, std::size_t) {}) != 0;
+        }
+    }
+    readers.clear();
+
+    const auto hashes = md5.GetHashes();
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        if (!failed[i]) {
+            files[i]->SetHashSum(hashes[i]);
+            Stats::Add(Stats::Counter::FullHashes);
+            Stats::Add(Stats::Counter::BytesHashed, size);
+        }
+    }
+}
+
+}
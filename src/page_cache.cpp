@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "page_cache.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    //the biggest folio of page cache, windows never split folios
+    constexpr std::uint64_t WINDOW_SIZE = 2 * 1024 * 1024;
+    //windows probed beyond range being read, more than kernel readahead
+    constexpr std::uint64_t LOOKAHEAD = 2 * WINDOW_SIZE;
+
+    std::uint64_t PageSize() {
+        static const auto page_size = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+        return page_size;
+    }
+
+}
+
+PageCache::PageCache(int fd, const ReadOptions& options) : m_fd(fd),
+                                                           m_advise(options.advise && options.cache != CacheMode::Direct),
+                                                           m_drop(options.cache == CacheMode::Drop) {
+    if (m_advise) {
+        //doubles readahead window of the file
+        ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+}
+
+PageCache::~PageCache() {
+    if (m_drop) {
+        for (const auto& w : m_windows) {
+            Release(w.first, w.second);
+        }
+    }
+    if (m_map) {
+        ::munmap(m_map, m_map_size);
+    }
+}
+
+bool PageCache::Map() {
+    if (!m_map_tried) {
+        m_map_tried = true;
+        struct stat st {};
+        if (::fstat(m_fd, &st) == 0 && st.st_size > 0) {
+            const auto size = static_cast<std::uint64_t>(st.st_size);
+            void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+            if (addr != MAP_FAILED) {
+                m_map = addr;
+                m_map_size = size;
+            }
+        }
+    }
+    return m_map != nullptr;
+}
+
+void PageCache::Probe(std::uint64_t offset, std::uint64_t length) {
+    if (length == 0 || !Map()) {
+        return;
+    }
+
+    const auto page = PageSize();
+    const auto last = std::min(offset + length + LOOKAHEAD, m_map_size);
+    for (auto w = offset / WINDOW_SIZE; w * WINDOW_SIZE < last; ++w) {
+        if (m_windows.count(w) != 0) {
+            continue;
+        }
+        const auto begin = w * WINDOW_SIZE;
+        const auto end = std::min(begin + WINDOW_SIZE, m_map_size);
+        std::vector<unsigned char> pages((end - begin + page - 1) / page);
+        if (::mincore(static_cast<char*>(m_map) + begin, end - begin, pages.data()) == 0) {
+            m_windows.emplace(w, std::move(pages));
+        }
+    }
+}
+
+void PageCache::WillNeed(std::uint64_t offset, std::uint64_t length) const {
+    if (m_advise && length != 0) {
+        ::posix_fadvise(m_fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+    }
+}
+
+void PageCache::Done(std::uint64_t offset, std::uint64_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    const auto page = PageSize();
+    const auto end = offset + length;
+    std::uint64_t resident = 0;
+    std::uint64_t missed = 0;
+    for (auto w = offset / WINDOW_SIZE; w * WINDOW_SIZE < end; ++w) {
+        const auto base = w * WINDOW_SIZE;
+        const auto begin = std::max(offset, base);
+        const auto win_end = std::min(end, base + WINDOW_SIZE);
+        auto it = m_windows.find(w);
+        if (it == m_windows.end()) {
+            //residency is unknown: pages can be cached by others, they are neither counted nor evicted
+            continue;
+        }
+        //pages are evicted later by whole window, here they are only counted
+        for (auto pos = begin; pos < win_end;) {
+            const auto idx = (pos - base) / page;
+            const auto next = std::min(base + (idx + 1) * page, win_end);
+            if (idx < it->second.size() && (it->second[idx] & 1) != 0) {
+                resident += next - pos;
+            }
+            else {
+                missed += next - pos;
+            }
+            pos = next;
+        }
+    }
+    Stats::Add(Stats::Counter::CacheResident, resident);
+    Stats::Add(Stats::Counter::CacheMissed, missed);
+    if (m_drop) {
+        Stats::Add(Stats::Counter::CacheDropped, missed);
+    }
+
+    //windows passed by reading
+    auto it = m_windows.begin();
+    while (it != m_windows.end() && (it->first + 1) * WINDOW_SIZE <= end) {
+        if (m_drop) {
+            Release(it->first, it->second);
+        }
+        it = m_windows.erase(it);
+    }
+}
+
+void PageCache::Release(std::uint64_t idx, const std::vector<unsigned char>& pages) const {
+    //evict runs of pages which were not in cache, readahead beyond consumed part too
+    const auto page = PageSize();
+    const auto base = idx * WINDOW_SIZE;
+    std::size_t i = 0;
+    while (i < pages.size()) {
+        const bool cached = (pages[i] & 1) != 0;
+        std::size_t j = i;
+        while (j < pages.size() && ((pages[j] & 1) != 0) == cached) {
+            ++j;
+        }
+        if (!cached) {
+            ::posix_fadvise(m_fd, static_cast<off_t>(base + i * page), static_cast<off_t>((j - i) * page), POSIX_FADV_DONTNEED);
+        }
+        i = j;
+    }
+}
+
+}
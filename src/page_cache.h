@@ -0,0 +1,57 @@
+#ifndef __PAGE_CACHE_H__
+#define __PAGE_CACHE_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <map>
+
+#include "file_reader.h"
+
+namespace fl {
+
+//Access hints, page cache accounting and eviction for one opened file.
+//Residency of pages is asked by mincore before they are read, so bytes found in cache and bytes read
+//past it are counted in every mode. In Drop mode pages which were not in cache are evicted by whole aligned
+//windows when reading passes the window or file is closed: kernel keeps large folios of readahead if only
+//a part of them is evicted. Pages cached by other processes (or of unknown residency) stay hot.
+//Used by one thread only.
+class PageCache
+{
+public:
+    //fd must outlive object
+    PageCache(int fd, const ReadOptions& options);
+    ~PageCache();
+
+    PageCache(const PageCache&) = delete;
+    PageCache& operator=(const PageCache&) = delete;
+
+    //range is going to be read: remember which of its pages are in cache (and of the next windows,
+    //as kernel readahead may go further). Must be called before reading or WillNeed of range
+    void Probe(std::uint64_t offset, std::uint64_t length);
+
+    //range will be read soon: start readahead of it
+    void WillNeed(std::uint64_t offset, std::uint64_t length) const;
+
+    //range is consumed: it is counted, windows passed by it are evicted (Drop mode)
+    void Done(std::uint64_t offset, std::uint64_t length);
+
+private:
+    //map file once without touching its pages, only to ask kernel about them
+    bool Map();
+
+    //evict pages of window which were not in cache
+    void Release(std::uint64_t idx, const std::vector<unsigned char>& pages) const;
+
+    int                                                     m_fd;
+    bool                                                    m_advise;
+    bool                                                    m_drop;
+    void*                                                   m_map{ nullptr };
+    std::uint64_t                                           m_map_size{ 0 };
+    bool                                                    m_map_tried{ false };
+    std::map<std::uint64_t, std::vector<unsigned char>>     m_windows;  //window index -> mincore vector
+};
+
+}
+
+#endif // ! __PAGE_CACHE_H__
@@ -0,0 +1,46 @@
+#include <stdexcept>
+
+#include "path_pool.h"
+
+namespace fl {
+
+std::uint32_t PathPool::Add(const char* name, std::size_t len) {
+    if (!CanAdd(len)) {
+        throw std::length_error("names of path pool exceed 4 GiB");
+    }
+    auto offset = static_cast<std::uint32_t>(m_names.size());
+    m_names.append(name, len);
+    return offset;
+}
+
+std::string PathPool::GetPath(std::uint32_t offset, std::uint32_t len) const {
+    std::string res;
+    if (m_dir.empty()) {
+        res.assign(m_names, offset, len);
+        return res;
+    }
+
+    res.reserve(m_dir.size() + 1 + len);
+    res = m_dir;
+    if (res.back() != '/') {
+        res += '/';
+    }
+    res.append(m_names, offset, len);
+    return res;
+}
+
+PathRef::PathRef(const std::string& path) {
+    auto pool = std::make_shared<PathPool>(std::string{});
+    m_len = static_cast<std::uint32_t>(path.size());
+    m_offset = pool->Add(path.data(), path.size());
+    m_pool = std::move(pool);
+}
+
+std::string PathRef::GetPath() const {
+    if (!m_pool) {
+        return std::string{};
+    }
+    return m_pool->GetPath(m_offset, m_len);
+}
+
+}
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <system_error>
+
+#include <unistd.h>
+
+#include "result_writer.h"
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+
+    //files compared byte by byte have no hash, it is not calculated just for output
+    Digest ClusterHash(const DupsSearcher::DupsCluster& cluster) {
+        const auto* first = cluster.files.front().file;
+        return first->HasHashSum() ? first->GetHashSum() : Digest{};
+    }
+
+    //group of not compared files as text cluster with "?" instead of "="
+    void WriteTextUnresolved(OutputBuffer& out, const std::vector<DupsSearcher::TaggedFile>& files) {
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            out.Write(i == 0 ? "[" : "\t? [");
+            out.Write(std::to_string(files[i].dir_idx));
+            out.Write("] ");
+            out.Write(files[i].file->GetFilePath());
+            out.Write(i == 0 ? " ?\n" : "\n");
+        }
+    }
+
+    //"a = b" for every file of the second dir and every file of the first one,
+    //"==" for links to the same file and files sharing extents
+    class TextPairsWriter : public ResultWriter
+    {
+    public:
+        explicit TextPairsWriter(int fd) : ResultWriter(fd) {}
+
+        void Write(const DupsSearcher::DupsCluster& cluster) override {
+            for (const auto& tf : cluster.files) {
+                if (tf.dir_idx != 1) {
+                    continue;
+                }
+                const auto path = tf.file->GetFilePath();
+                for (const auto& other : cluster.files) {
+                    if (other.dir_idx != 0) {
+                        continue;
+                    }
+                    const bool same_file = cluster.shared || tf.file->GetStamp().SameFile(other.file->GetStamp());
+                    m_out.Write(path);
+                    m_out.Write(same_file ? " == " : " = ");
+                    m_out.Write(other.file->GetFilePath());
+                    m_out.Put('\n');
+                }
+            }
+        }
+
+        //pairs of big group are too many, it is written as by clusters writer
+        void WriteUnresolved(const std::vector<DupsSearcher::TaggedFile>& files) override {
+            WriteTextUnresolved(m_out, files);
+        }
+    };
+
+    //the first file of cluster, then its duplicates, tagged by number of dir. "==" for already deduplicated cluster
+    class TextClustersWriter : public ResultWriter
+    {
+    public:
+        explicit TextClustersWriter(int fd) : ResultWriter(fd) {}
+
+        void Write(const DupsSearcher::DupsCluster& cluster) override {
+            for (std::size_t i = 0; i < cluster.files.size(); ++i) {
+                const auto& tf = cluster.files[i];
+                m_out.Write(i == 0 ? "[" : "\t= [");
+                m_out.Write(std::to_string(tf.dir_idx));
+                m_out.Write("] ");
+                m_out.Write(tf.file->GetFilePath());
+                m_out.Write(i != 0 ? "\n" : cluster.shared ? " ==\n" : " =\n");
+            }
+        }
+
+        void WriteUnresolved(const std::vector<DupsSearcher::TaggedFile>& files) override {
+            WriteTextUnresolved(m_out, files);
+        }
+    };
+
+    class JsonlResultWriter : public ResultWriter
+    {
+    public:
+        explicit JsonlResultWriter(int fd) : ResultWriter(fd) {}
+
+        void Write(const DupsSearcher::DupsCluster& cluster) override {
+            const auto* first = cluster.files.front().file;
+            m_out.Write("{\"size\":");
+            m_out.Write(std::to_string(first->GetFileSize()));
+            m_out.Write(",\"hash\":\"");
+            m_out.Write(ClusterHash(cluster).ToHex());
+            m_out.Write("\",\"dirs\":");
+            m_out.Write(std::to_string(cluster.dirs_num));
+            if (cluster.shared) {
+                m_out.Write(",\"shared\":true");
+            }
+            WriteFiles(cluster.files);
+        }
+
+        void WriteUnresolved(const std::vector<DupsSearcher::TaggedFile>& files) override {
+            m_out.Write("{\"size\":");
+            m_out.Write(std::to_string(files.front().file->GetFileSize()));
+            m_out.Write(",\"unresolved\":true,\"dirs\":");
+            std::size_t dirs = 0;
+            for (std::size_t i = 0; i < files.size(); ++i) {
+                if (i == 0 || files[i].dir_idx != files[i - 1].dir_idx) {
+                    ++dirs;
+                }
+            }
+            m_out.Write(std::to_string(dirs));
+            WriteFiles(files);
+        }
+
+    private:
+        //the rest of object: ,"files":[...]}
+        void WriteFiles(const std::vector<DupsSearcher::TaggedFile>& files) {
+            m_out.Write(",\"files\":[");
+            for (std::size_t i = 0; i < files.size(); ++i) {
+                const auto& tf = files[i];
+                m_out.Write(i == 0 ? "{\"dir\":" : ",{\"dir\":");
+                m_out.Write(std::to_string(tf.dir_idx));
+                m_out.Write(",\"path\":\"");
+                WriteEscaped(tf.file->GetFilePath());
+                m_out.Write("\"}");
+            }
+            m_out.Write("]}\n");
+        }
+
+        //bytes of path are written as is except quote, backslash and control characters
+        void WriteEscaped(const std::string& str) {
+            static const char hex[] = "0123456789abcdef";
+            for (char c : str) {
+                const auto u = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\') {
+                    m_out.Put('\\');
+                    m_out.Put(c);
+                }
+                else if (u < 0x20) {
+                    const char esc[] = { '\\', 'u', '0', '0', hex[u >> 4], hex[u & 0xf] };
+                    m_out.Write(esc, sizeof(esc));
+                }
+                else {
+                    m_out.Put(c);
+                }
+            }
+        }
+    };
+
+    class NulResultWriter : public ResultWriter
+    {
+    public:
+        explicit NulResultWriter(int fd) : ResultWriter(fd) {}
+
+        void Write(const DupsSearcher::DupsCluster& cluster) override {
+            for (const auto& tf : cluster.files) {
+                m_out.Write(tf.file->GetFilePath());
+                m_out.Put('\0');
+            }
+            m_out.Put('\0');
+        }
+    };
+
+    class BinaryResultWriter : public ResultWriter
+    {
+    public:
+        explicit BinaryResultWriter(int fd) : ResultWriter(fd) {
+            m_out.Write(MAGIC, sizeof(MAGIC) - 1);
+        }
+
+        void Write(const DupsSearcher::DupsCluster& cluster) override {
+            const auto* first = cluster.files.front().file;
+            const auto hash = ClusterHash(cluster);
+            const std::uint64_t size = first->GetFileSize();
+            WriteValue(size);
+            WriteValue(hash.size);
+            m_out.Write(hash.bytes.data(), hash.size);
+            WriteValue(static_cast<std::uint32_t>(cluster.files.size()));
+            for (const auto& tf : cluster.files) {
+                const auto path = tf.file->GetFilePath();
+                WriteValue(static_cast<std::uint32_t>(tf.dir_idx));
+                WriteValue(static_cast<std::uint32_t>(path.size()));
+                m_out.Write(path);
+            }
+        }
+
+    private:
+        static constexpr char MAGIC[] = "DUPSRES1";
+
+        template<typename T>
+        void WriteValue(const T& val) {
+            m_out.Write(&val, sizeof(val));
+        }
+    };
+
+}
+
+const char* OutputFormatName(OutputFormat format) {
+    switch (format) {
+    case OutputFormat::Text:
+        return "text";
+    case OutputFormat::JSONL:
+        return "jsonl";
+    case OutputFormat::Nul:
+        return "nul";
+    case OutputFormat::Binary:
+        return "binary";
+    }
+    return "";
+}
+
+bool ParseOutputFormat(const std::string& name, OutputFormat& format) {
+    for (auto f : { OutputFormat::Text, OutputFormat::JSONL, OutputFormat::Nul, OutputFormat::Binary }) {
+        if (name == OutputFormatName(f)) {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+OutputBuffer::OutputBuffer(int fd, std::size_t size) : m_fd(fd), m_buf(size != 0 ? size : 1) {
+}
+
+OutputBuffer::~OutputBuffer() {
+    try {
+        Flush();
+    }
+    catch (const std::exception&) {
+    }
+}
+
+void OutputBuffer::Write(const void* data, std::size_t len) {
+    const auto* p = static_cast<const char*>(data);
+    while (len != 0) {
+        if (m_used == m_buf.size()) {
+            Flush();
+        }
+        const auto n = std::min(len, m_buf.size() - m_used);
+        std::memcpy(m_buf.data() + m_used, p, n);
+        m_used += n;
+        p += n;
+        len -= n;
+    }
+}
+
+void OutputBuffer::Flush() {
+    if (m_used == 0) {
+        return;
+    }
+
+    PhaseTimer timer(Stats::Phase::Output);
+    std::size_t done = 0;
+    while (done < m_used) {
+        const auto n = ::write(m_fd, m_buf.data() + done, m_used - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_used = 0;
+            throw std::system_error(errno, std::generic_category(), "Cannot write results");
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    m_used = 0;
+}
+
+std::unique_ptr<ResultWriter> ResultWriter::Create(OutputFormat format, int fd, bool pairs) {
+    switch (format) {
+    case OutputFormat::Text:
+        if (pairs) {
+            return std::make_unique<TextPairsWriter>(fd);
+        }
+        return std::make_unique<TextClustersWriter>(fd);
+    case OutputFormat::JSONL:
+        return std::make_unique<JsonlResultWriter>(fd);
+    case OutputFormat::Nul:
+        return std::make_unique<NulResultWriter>(fd);
+    case OutputFormat::Binary:
+        return std::make_unique<BinaryResultWriter>(fd);
+    }
+    return nullptr;
+}
+
+}
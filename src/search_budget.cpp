@@ -0,0 +1,36 @@
+#include "search_budget.h"
+
+namespace fl {
+
+bool SearchBudget::Take(std::uint64_t bytes) {
+    if (IsExhausted()) {
+        return false;
+    }
+    if (m_deadline != Clock::time_point::max() && Clock::now() >= m_deadline) {
+        m_exhausted.store(true, std::memory_order_relaxed);
+        return false;
+    }
+    if (m_max_read == 0) {
+        m_taken.fetch_add(bytes, std::memory_order_relaxed);
+        return true;
+    }
+
+    //concurrent readers reserve their bytes one by one
+    auto taken = m_taken.load(std::memory_order_relaxed);
+    do {
+        if (bytes > m_max_read - taken) {
+            //only this file is refused while smaller ones can fit
+            if (taken == m_max_read) {
+                m_exhausted.store(true, std::memory_order_relaxed);
+            }
+            return false;
+        }
+    } while (!m_taken.compare_exchange_weak(taken, taken + bytes, std::memory_order_relaxed));
+    return true;
+}
+
+bool SearchBudget::IsStopped() const {
+    return IsCancelled() || (m_deadline != Clock::time_point::max() && Clock::now() >= m_deadline);
+}
+
+}
@@ -1,59 +1,134 @@
-#include <filesystem>
+#include <algorithm>
+#include <unordered_set>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
 
 #include "searcher.h"
+#include "thread_pool.h"
+#include "dir_walker.h"
+#include "stats.h"
+#include "byte_comparer.h"
+#include "batch_hasher.h"
+#include "multi_hasher.h"
+#include "io_scheduler.h"
+#include "extent_map.h"
+#include "block_sampler.h"
 
 
 namespace fl {
 
 std::vector<fl::File> DupsSearcher::GetDirectoryContent(const std::string& dir_path) {
+    PhaseTimer timer(Stats::Phase::Scan);
+    DirWalker::Options options;
+    options.jobs = m_jobs;
+    options.recursive = m_recursive;
 
-    std::filesystem::directory_iterator dir_iter{ dir_path };
-    std::vector<File> regular_files;    //hope on rvo
-
-    //it is better to make reserve of vector before filling it
-    //count:
-    auto valid_file_num = std::count_if(std::filesystem::begin(dir_iter),
-                                        std::filesystem::end(dir_iter),
-                                        [](const std::filesystem::directory_entry& de) {
-                                            return fl::File::FileIsOk(de.path().string());
-                                        });
-
-    regular_files.reserve(valid_file_num);
-
-    dir_iter = std::filesystem::directory_iterator{ dir_path };
-    for (const auto& de : dir_iter) {
-        fl::File fi(de.path().string());
-        if (fi.IsOk()) {
-            regular_files.emplace_back(std::move(fi));
-        }
-    }
-
-    return regular_files;
+    DirWalker walker(options);
+    return walker.Walk(dir_path);
 }
 
 DupsSearcher::GroupedFiles DupsSearcher::GroupBySize(const std::vector<fl::File>& content) {
+    PhaseTimer timer(Stats::Phase::Group);
     GroupedFiles mp;
     for (const auto& f : content) {
-        mp[f.GetFileSize()].push_back(f);
+        mp[f.GetFileSize()].push_back(&f);
     }
     return mp;
 }
 
-std::vector<DupsSearcher::TheSameFailsName> DupsSearcher::GetDuplicatedPairs(const std::vector<fl::File>& content, const DupsSearcher::GroupedFiles& grouped) {
+std::vector<DupsSearcher::DupsClass> DupsSearcher::GetDuplicatedClasses(const std::vector<fl::File>& content, const DupsSearcher::GroupedFiles& grouped) {
+
+    CalcHashSums(content, grouped);
+
+    PhaseTimer timer(Stats::Phase::Compare);
+    //after CalcHashSums every file which can have a duplicate has full hash.
+    //Files of grouped side indexed by hash, separately for every size
+    struct IndexEntry
+    {
+        std::vector<const fl::File*>    files;
+        std::size_t                     class_idx{ SIZE_MAX };  //class is created on the first match
+    };
+    using HashIndex = std::unordered_map<Digest, IndexEntry, DigestHash>;
+    std::unordered_map<std::size_t, HashIndex> indexes;
+    std::vector<DupsClass> classes;
+    //classes of size groups of links to one inode which are not hashed, by size
+    std::unordered_map<std::size_t, std::size_t> inode_classes;
+
+    auto get_index = [&indexes](std::size_t size, const std::vector<const fl::File*>& bucket) -> HashIndex& {
+        auto it = indexes.find(size);
+        if (it != indexes.end()) {
+            return it->second;
+        }
+        //build index of the bucket once
+        auto& index = indexes[size];
+        for (const auto* p : bucket) {
+            if (p->IsOk() && p->HasHashSum()) {
+                index[p->GetHashSum()].files.push_back(p);
+            }
+        }
+        return index;
+    };
 
-    std::vector<TheSameFailsName> res_pairs;
     //===========================================================================
     for (const auto& fi : content) {
-        //check hash table has such size
+        if (!fi.IsOk()) {
+            continue;
+        }
         auto fit = grouped.find(fi.GetFileSize());
         if (fit == grouped.end()) {
             continue;
         }
+        if (!fi.HasHashSum()) {
+            const auto& bucket = fit->second;
+            if (std::all_of(bucket.begin(), bucket.end(), [&fi](const fl::File* p) {
+                    return p->GetStamp().GetId() == fi.GetStamp().GetId();
+                })) {
+                auto ins = inode_classes.emplace(fit->first, classes.size());
+                if (ins.second) {
+                    classes.emplace_back();
+                    classes.back().grouped_files = bucket;
+                }
+                classes[ins.first->second].content_files.push_back(&fi);
+            }
+            continue;
+        }
 
-        //it has, fill pair
-        for (const auto& p : fit->second) {
-            if (fi == p) {
-                res_pairs.emplace_back(std::make_pair(fi.GetFilePath(), p.GetFilePath()));
+        auto& index = get_index(fit->first, fit->second);
+        auto iit = index.find(fi.GetHashSum());
+        if (iit == index.end()) {
+            continue;
+        }
+
+        auto& entry = iit->second;
+        if (entry.class_idx == SIZE_MAX) {
+            entry.class_idx = classes.size();
+            classes.emplace_back();
+            classes.back().grouped_files = entry.files;
+        }
+        classes[entry.class_idx].content_files.push_back(&fi);
+    }
+
+    return classes;
+}
+
+std::vector<DupsSearcher::TheSameFailsName> DupsSearcher::GetDuplicatedPairs(const std::vector<fl::File>& content, const DupsSearcher::GroupedFiles& grouped,
+                                                                             std::vector<TheSameFailsName>* same_inode_pairs) {
+
+    std::vector<TheSameFailsName> res_pairs;
+    //===========================================================================
+    for (const auto& cl : GetDuplicatedClasses(content, grouped)) {
+        for (const auto* fi : cl.content_files) {
+            for (const auto* p : cl.grouped_files) {
+                if (same_inode_pairs && fi->GetStamp().SameFile(p->GetStamp())) {
+                    //links to the same file
+                    same_inode_pairs->emplace_back(std::make_pair(fi->GetFilePath(), p->GetFilePath()));
+                }
+                else {
+                    res_pairs.emplace_back(std::make_pair(fi->GetFilePath(), p->GetFilePath()));
+                }
             }
         }
     }
@@ -63,25 +138,900 @@ std::vector<DupsSearcher::TheSameFailsName> DupsSearcher::GetDuplicatedPairs(con
 
 std::vector<fl::File> DupsSearcher::GetDuplicatedFiles(const std::vector<fl::File>& content, const DupsSearcher::GroupedFiles& grouped) {
 
+    auto classes = GetDuplicatedClasses(content, grouped);
+
+    //keep order of content
+    std::unordered_set<const fl::File*> has_dups;
+    for (const auto& cl : classes) {
+        has_dups.insert(cl.content_files.begin(), cl.content_files.end());
+    }
+
     std::vector<fl::File> res;
-    res.reserve(content.size());
-    //===========================================================================
+    res.reserve(has_dups.size());
+    for (const auto& fi : content) {
+        if (has_dups.count(&fi) != 0) {
+            res.push_back(fi);
+        }
+    }
+
+    return res;
+}
+
+namespace {
+
+//extents of smaller files are not asked: one read of them is as cheap as FIEMAP
+constexpr std::uint64_t MIN_SHARED_SIZE = 64 * 1024;
+
+//files admitted by budget at once for engines reading many files together
+constexpr std::size_t BUDGET_SLICE = 256;
+
+//files of one device given to a ring at once, in its queue depths
+constexpr std::size_t RING_BATCH = 4;
+
+//all files are links to one inode
+bool SameInode(const std::vector<DupsSearcher::TaggedFile>& group) {
+    const auto id = group.front().file->GetStamp().GetId();
+    return std::all_of(group.begin(), group.end(), [&id](const DupsSearcher::TaggedFile& tf) {
+        return tf.file->GetStamp().GetId() == id;
+    });
+}
+
+//files of group are ordered by input, so inputs are counted by transitions
+std::size_t DirsNum(const std::vector<DupsSearcher::TaggedFile>& group) {
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < group.size(); ++i) {
+        if (i == 0 || group[i].dir_idx != group[i - 1].dir_idx) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+}
+
+std::vector<DupsSearcher::DupsCluster> DupsSearcher::GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs) {
+
+    std::vector<DupsCluster> res;
+    GetDuplicatedClusters(contents, min_dirs, [&res](const DupsCluster& cl) { res.push_back(cl); });
+
+    //order by the first file: number of input, then position in its content
+    auto key = [&contents](const DupsCluster& cl) {
+        const auto& tf = cl.files.front();
+        return std::make_pair(tf.dir_idx, tf.file - contents[tf.dir_idx].data());
+    };
+    std::sort(res.begin(), res.end(), [&key](const DupsCluster& a, const DupsCluster& b) { return key(a) < key(b); });
+    return res;
+}
+
+void DupsSearcher::GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs,
+                                         const ClusterCallback& on_cluster) {
+    SearchClusters(contents, min_dirs, on_cluster, nullptr, nullptr);
+}
+
+void DupsSearcher::GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs,
+                                         SearchBudget& budget, const ClusterCallback& on_cluster,
+                                         const UnresolvedCallback& on_unresolved) {
+    SearchClusters(contents, min_dirs, on_cluster, &budget, on_unresolved);
+}
+
+DupsSearcher::PartialClusters DupsSearcher::GetDuplicatedClusters(const std::vector<std::vector<fl::File>>& contents,
+                                                                  std::size_t min_dirs, SearchBudget& budget) {
+    PartialClusters res;
+    GetDuplicatedClusters(contents, min_dirs, budget, [&res](const DupsCluster& cl) { res.clusters.push_back(cl); },
+                          [&res](const std::vector<TaggedFile>& files) { res.unresolved.push_back(files); });
+
+    auto key = [&contents](const DupsCluster& cl) {
+        const auto& tf = cl.files.front();
+        return std::make_pair(tf.dir_idx, tf.file - contents[tf.dir_idx].data());
+    };
+    std::sort(res.clusters.begin(), res.clusters.end(),
+              [&key](const DupsCluster& a, const DupsCluster& b) { return key(a) < key(b); });
+    return res;
+}
+
+void DupsSearcher::SearchClusters(const std::vector<std::vector<fl::File>>& contents, std::size_t min_dirs,
+                                  const ClusterCallback& on_cluster, SearchBudget* budget,
+                                  const UnresolvedCallback& on_unresolved) {
+
+    min_dirs = std::max<std::size_t>(min_dirs, 1);
+    if (contents.size() < min_dirs) {
+        return;
+    }
+
+    auto can_be_cluster = [min_dirs](const std::vector<TaggedFile>& group) {
+        return group.size() > 1 && DirsNum(group) >= min_dirs;
+    };
+
+    //one index for all inputs
+    std::vector<std::vector<TaggedFile>> buckets;
+    std::vector<std::vector<TaggedFile>> links;
+    std::vector<const fl::File*> cands;
+    {
+        PhaseTimer timer(Stats::Phase::Group);
+        std::unordered_map<std::size_t, std::vector<TaggedFile>> by_size;
+        std::size_t total = 0;
+        for (std::size_t d = 0; d < contents.size(); ++d) {
+            for (const auto& f : contents[d]) {
+                if (f.IsOk()) {
+                    by_size[f.GetFileSize()].push_back(TaggedFile{ &f, d });
+                    ++total;
+                }
+            }
+        }
+
+        //only size groups spanning enough inputs go further
+        std::size_t considered = 0;
+        for (auto& kv : by_size) {
+            if (!can_be_cluster(kv.second)) {
+                continue;
+            }
+            considered += kv.second.size();
+            if (SameInode(kv.second)) {
+                links.push_back(std::move(kv.second));
+                continue;
+            }
+            for (const auto& tf : kv.second) {
+                cands.push_back(tf.file);
+            }
+            buckets.push_back(std::move(kv.second));
+        }
+        Stats::Add(Stats::Counter::AvoidedBySize, total - considered);
+    }
+
+    //links to one inode are the same file, they are reported without reading in every compare mode
+    for (auto& files : links) {
+        Stats::Add(Stats::Counter::AvoidedByInode, files.size());
+        DupsCluster cl;
+        cl.files = std::move(files);
+        cl.dirs_num = DirsNum(cl.files);
+        cl.shared = true;
+        on_cluster(cl);
+    }
+
+    if (m_compare_mode == CompareMode::Bytes) {
+        CompareBuckets(buckets, min_dirs, on_cluster, budget, on_unresolved);
+        return;
+    }
+
+    //files sharing extents with the first file of their set are not read, they take its hashes
+    std::unordered_map<const fl::File*, const fl::File*> shared_with;
+    if (File::GetReadOptions().extents) {
+        FindSharedExtents(buckets, min_dirs, on_cluster, shared_with);
+    }
+    auto shared_copy = [&shared_with](const fl::File* f) -> const fl::File* {
+        auto it = shared_with.find(f);
+        return it != shared_with.end() && it->second != f ? it->second : nullptr;
+    };
+    if (!shared_with.empty()) {
+        cands.clear();
+        for (const auto& bucket : buckets) {
+            for (const auto& tf : bucket) {
+                if (!shared_copy(tf.file)) {
+                    cands.push_back(tf.file);
+                }
+            }
+        }
+    }
+    //cluster is already deduplicated if all its files are of one set
+    auto all_shared = [&shared_with](const std::vector<TaggedFile>& files) {
+        auto first = shared_with.find(files.front().file);
+        return first != shared_with.end() && std::all_of(files.begin(), files.end(), [&](const TaggedFile& tf) {
+            auto it = shared_with.find(tf.file);
+            return it != shared_with.end() && it->second == first->second;
+        });
+    };
+
+    //stage 1: sample hashes
+    CalcHashes(cands, false, budget);
+    //copies of failed file are read by themselves
+    for (const auto& kv : shared_with) {
+        if (kv.first != kv.second && kv.second->IsOk() && kv.second->HasSampleHashSum()) {
+            kv.first->SetSampleHashSum(kv.second->GetSampleHashSum());
+        }
+    }
+
+    //stage 2: only files of sample groups spanning enough inputs go further, order of files is kept
+    {
+        PhaseTimer timer(Stats::Phase::Compare);
+        std::size_t kept = 0;
+        std::size_t considered = 0;
+        std::size_t matched_num = 0;
+        for (auto& bucket : buckets) {
+            //bucket with files left without sample by budget is not compared at all
+            if (budget && std::any_of(bucket.begin(), bucket.end(), [](const TaggedFile& tf) {
+                    return tf.file->IsOk() && !tf.file->HasSampleHashSum();
+                })) {
+                std::vector<TaggedFile> unresolved;
+                std::copy_if(bucket.begin(), bucket.end(), std::back_inserter(unresolved),
+                             [](const TaggedFile& tf) { return tf.file->IsOk(); });
+                if (on_unresolved) {
+                    on_unresolved(unresolved);
+                }
+                continue;
+            }
+            considered += bucket.size();
+
+            std::unordered_map<Digest, std::vector<TaggedFile>, DigestHash> by_sample;
+            for (const auto& tf : bucket) {
+                if (tf.file->IsOk()) {
+                    by_sample[tf.file->GetSampleHashSum()].push_back(tf);
+                }
+            }
+
+            std::vector<TaggedFile> matched;
+            for (const auto& tf : bucket) {
+                if (!tf.file->IsOk()) {
+                    continue;
+                }
+                auto sit = by_sample.find(tf.file->GetSampleHashSum());
+                if (sit != by_sample.end() && can_be_cluster(sit->second)) {
+                    matched.push_back(tf);
+                }
+            }
+            if (matched.empty()) {
+                continue;
+            }
+            matched_num += matched.size();
+            buckets[kept++] = std::move(matched);
+        }
+        buckets.resize(kept);
+        Stats::Add(Stats::Counter::AvoidedBySample, considered - matched_num);
+    }
+
+    //stage 3: big files are compared by blocks spread across them before they are read entirely
+    FilterByBlocks(buckets, min_dirs, shared_with, budget);
+
+    //stage 4: full hashes, copies of shared extents are not read
+    std::vector<std::vector<const fl::File*>> groups;
+    for (const auto& bucket : buckets) {
+        groups.emplace_back();
+        for (const auto& tf : bucket) {
+            const auto* rep = shared_copy(tf.file);
+            if (!rep || !rep->IsOk()) {
+                groups.back().push_back(tf.file);
+            }
+        }
+    }
+
+    //join every size bucket by full hash as soon as it is hashed
+    CalcGroupHashes(groups, [&](std::size_t g) {
+        std::unordered_map<Digest, std::size_t, DigestHash> index;
+        std::vector<DupsCluster> clusters;
+        for (const auto& tf : buckets[g]) {
+            const auto* rep = shared_copy(tf.file);
+            if (rep && rep->IsOk() && rep->HasHashSum()) {
+                tf.file->SetHashSum(rep->GetHashSum());
+            }
+            if (!tf.file->IsOk() || !tf.file->HasHashSum()) {
+                continue;
+            }
+            auto ins = index.emplace(tf.file->GetHashSum(), clusters.size());
+            if (ins.second) {
+                clusters.emplace_back();
+            }
+            clusters[ins.first->second].files.push_back(tf);
+        }
+
+        std::unordered_set<const fl::File*> confirmed;
+        for (auto& cl : clusters) {
+            if (can_be_cluster(cl.files)) {
+                cl.dirs_num = DirsNum(cl.files);
+                cl.shared = all_shared(cl.files);
+                on_cluster(cl);
+                for (const auto& tf : cl.files) {
+                    confirmed.insert(tf.file);
+                }
+            }
+        }
+
+        //files left without hash by budget, and files which can be their copies
+        if (!budget || !on_unresolved || std::none_of(buckets[g].begin(), buckets[g].end(), [](const TaggedFile& tf) {
+                return tf.file->IsOk() && !tf.file->HasHashSum();
+            })) {
+            return;
+        }
+        std::vector<TaggedFile> unresolved;
+        for (const auto& tf : buckets[g]) {
+            if (tf.file->IsOk() && confirmed.count(tf.file) == 0) {
+                unresolved.push_back(tf);
+            }
+        }
+        on_unresolved(unresolved);
+    }, budget);
+}
+
+void DupsSearcher::CalcHashSums(const std::vector<fl::File>& content, const DupsSearcher::GroupedFiles& grouped) const {
+    //collect files which hashes are really needed
+    std::vector<const fl::File*> content_cands;
+    std::vector<const fl::File*> grouped_cands;
+    std::unordered_set<std::size_t> used_sizes;
     for (const auto& fi : content) {
         auto fit = grouped.find(fi.GetFileSize());
         if (fit == grouped.end()) {
             continue;
         }
 
-        for (const auto& p : fit->second) {
-            if (fi == p) {
-                res.push_back(fi);
-                break;
+        content_cands.push_back(&fi);
+        if (used_sizes.insert(fit->first).second) {
+            grouped_cands.insert(grouped_cands.end(), fit->second.begin(), fit->second.end());
+        }
+    }
+
+    std::size_t grouped_total = 0;
+    for (const auto& kv : grouped) {
+        grouped_total += kv.second.size();
+    }
+    Stats::Add(Stats::Counter::AvoidedBySize,
+               content.size() - content_cands.size() + grouped_total - grouped_cands.size());
+
+    //size groups of links to one inode are not read, GetDuplicatedClasses joins them by inode
+    std::unordered_map<std::size_t, std::pair<FileId, bool>> inode_of_size;    //the first inode, the only one
+    for (const auto* cands : { &content_cands, &grouped_cands }) {
+        for (const auto* f : *cands) {
+            auto ins = inode_of_size.emplace(f->GetFileSize(), std::make_pair(f->GetStamp().GetId(), true));
+            if (!ins.second && ins.first->second.first != f->GetStamp().GetId()) {
+                ins.first->second.second = false;
             }
         }
     }
+    auto drop_links = [&inode_of_size](std::vector<const fl::File*>& cands) {
+        const auto n = cands.size();
+        cands.erase(std::remove_if(cands.begin(), cands.end(), [&inode_of_size](const fl::File* f) {
+            return inode_of_size.at(f->GetFileSize()).second;
+        }), cands.end());
+        Stats::Add(Stats::Counter::AvoidedByInode, n - cands.size());
+    };
+    drop_links(content_cands);
+    drop_links(grouped_cands);
 
-    return res;
+    if (content_cands.empty()) {
+        return;
+    }
+
+    //stage 1: cheap hash of head and tail of every candidate
+    std::vector<const fl::File*> all_cands(content_cands);
+    all_cands.insert(all_cands.end(), grouped_cands.begin(), grouped_cands.end());
+    CalcHashes(all_cands, false);
+
+    //stage 2: full hash only for files which sample matches sample of some file from the other side
+    using SamplesBySize = std::unordered_map<std::size_t, std::unordered_set<Digest, DigestHash>>;
+    auto collect_samples = [](const std::vector<const fl::File*>& cands) {
+        SamplesBySize samples;
+        for (const auto* f : cands) {
+            if (f->IsOk()) {
+                samples[f->GetFileSize()].insert(f->GetSampleHashSum());
+            }
+        }
+        return samples;
+    };
+
+    std::vector<const fl::File*> matched;
+    auto collect_matched = [&matched](const std::vector<const fl::File*>& cands, const SamplesBySize& other) {
+        for (const auto* f : cands) {
+            if (!f->IsOk()) {
+                continue;
+            }
+            auto oit = other.find(f->GetFileSize());
+            if (oit != other.end() && oit->second.count(f->GetSampleHashSum()) != 0) {
+                matched.push_back(f);
+            }
+        }
+    };
+
+    collect_matched(content_cands, collect_samples(grouped_cands));
+    collect_matched(grouped_cands, collect_samples(content_cands));
+    Stats::Add(Stats::Counter::AvoidedBySample, all_cands.size() - matched.size());
+    CalcHashes(matched, true);
+}
+
+void DupsSearcher::CalcAllHashSums(const std::vector<fl::File>& content) const {
+    std::vector<const fl::File*> files;
+    files.reserve(content.size());
+    for (const auto& f : content) {
+        files.push_back(&f);
+    }
+    //sample of small file is taken from its full hash, so full hashes go first
+    CalcHashes(files, true);
+    CalcHashes(files, false);
 }
 
+void DupsSearcher::CalcHashes(const std::vector<const fl::File*>& files, bool full, SearchBudget* budget) const {
+    PhaseTimer timer(full ? Stats::Phase::FullHash : Stats::Phase::SampleHash);
+
+    //only one file of each inode is read, other links take its hashes
+    std::unordered_map<FileId, const fl::File*, FileIdHash> inodes;
+    std::vector<const fl::File*> reps;
+    std::vector<const fl::File*> links;
+    for (const auto* f : files) {
+        if (!f->IsOk()) {
+            continue;
+        }
+        if (inodes.emplace(f->GetStamp().GetId(), f).second) {
+            reps.push_back(f);
+        }
+        else {
+            links.push_back(f);
+        }
+    }
+
+    HashFiles(reps, full, nullptr, budget);
+
+    for (const auto* f : links) {
+        const auto* r = inodes.at(f->GetStamp().GetId());
+        if (r != f && f->TakeHashesFrom(*r)) {
+            Stats::Add(Stats::Counter::LinksShared);
+        }
+    }
+}
+
+void DupsSearcher::CalcGroupHashes(const std::vector<std::vector<const fl::File*>>& groups,
+                                   const std::function<void(std::size_t)>& on_group, SearchBudget* budget) const {
+    PhaseTimer timer(Stats::Phase::FullHash);
+
+    struct GroupState
+    {
+        std::vector<std::pair<const fl::File*, const fl::File*>>    links;  //other link, its representative
+        std::atomic<std::size_t>                                    remaining{ 0 };
+    };
+
+    std::vector<GroupState> states(groups.size());
+    std::vector<const fl::File*> reps;      //one file of each inode
+    std::vector<const fl::File*> refused;   //files of groups not admitted by budget
+    std::unordered_map<const fl::File*, std::size_t> group_of;
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        auto& st = states[g];
+        std::unordered_map<FileId, const fl::File*, FileIdHash> inodes;
+        std::vector<const fl::File*> group_reps;
+        std::uint64_t to_read = 0;
+        for (const auto* f : groups[g]) {
+            if (!f->IsOk()) {
+                continue;
+            }
+            auto ins = inodes.emplace(f->GetStamp().GetId(), f);
+            if (ins.second) {
+                group_reps.push_back(f);
+                group_of.emplace(f, g);
+                ++st.remaining;
+                if (!f->FindCachedHashSum()) {
+                    to_read += f->GetFileSize();
+                }
+            }
+            else {
+                st.links.emplace_back(f, ins.first->second);
+            }
+        }
+        //part of group can't confirm a cluster, so group is admitted at once or refused alone
+        auto& to = !budget || to_read == 0 || budget->Take(to_read) ? reps : refused;
+        to.insert(to.end(), group_reps.begin(), group_reps.end());
+    }
+
+    std::mutex done_mutex;
+    auto finish = [&](std::size_t g) {
+        for (const auto& l : states[g].links) {
+            if (l.first->TakeHashesFrom(*l.second)) {
+                Stats::Add(Stats::Counter::LinksShared);
+            }
+        }
+        std::lock_guard<std::mutex> lk(done_mutex);
+        on_group(g);
+    };
+
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        if (states[g].remaining == 0) {
+            finish(g);
+        }
+    }
+
+    //the last hashed file of group finishes it
+    auto on_done = [&](const fl::File* f) {
+        const auto g = group_of.at(f);
+        if (--states[g].remaining == 0) {
+            finish(g);
+        }
+    };
+    for (const auto* f : refused) {
+        on_done(f);
+    }
+    HashFiles(reps, true, on_done, budget, true);
+}
+
+void DupsSearcher::HashFiles(const std::vector<const fl::File*>& files, bool full,
+                             const std::function<void(const fl::File*)>& on_done, SearchBudget* budget,
+                             bool admitted) const {
+    if (files.empty()) {
+        return;
+    }
+
+    //file is read only if its bytes are taken from budget, hashes from cache cost nothing
+    auto admit = [budget, admitted, full](const fl::File* f) {
+        if (!budget || admitted || (full ? f->FindCachedHashSum() : f->FindCachedSampleHashSum())) {
+            return true;
+        }
+        const std::uint64_t size = f->GetFileSize();
+        return budget->Take(full || f->SampleIsWholeFile() ? size : 2 * std::uint64_t{ File::GetSampleSize() });
+    };
+
+    const auto threads = m_jobs == 1 ? 1 : std::min(ThreadPool::ThreadsNum(m_jobs), files.size());
+    const auto& options = File::GetReadOptions();
+
+    //engines reading many files at once get them by slices of admitted files
+    if (budget && !admitted && (options.engine == IoEngine::Uring || (full && MultiHasher::Width() > 1))) {
+        for (std::size_t first = 0; first < files.size(); first += BUDGET_SLICE) {
+            std::vector<const fl::File*> slice;
+            for (auto i = first; i < std::min(first + BUDGET_SLICE, files.size()); ++i) {
+                if (admit(files[i])) {
+                    slice.push_back(files[i]);
+                }
+                else if (on_done) {
+                    on_done(files[i]);
+                }
+            }
+            HashFiles(slice, full, on_done, budget, true);
+        }
+        return;
+    }
+
+    //files of rotational devices are read in order of their place on disk
+    IoScheduler scheduler(options);
+    const auto ordered = options.schedule ? scheduler.Order(files, threads) : files;
+
+    //each file is hashed by exactly one thread, so lazy hash cache of File is not shared between threads
+    if (options.engine == IoEngine::Uring) {
+        //rotational devices get a few rings, each of them reads batches of one device file by file
+        if (options.schedule) {
+            std::vector<std::unique_ptr<BatchHasher>> rings(threads);
+            const auto batches = scheduler.Batches(ordered, RING_BATCH * std::max<std::size_t>(options.queue_depth, 1));
+            scheduler.RunBatches(batches, threads, [&](std::size_t worker, const IoScheduler::Batch& batch) {
+                if (!rings[worker]) {
+                    rings[worker] = std::make_unique<BatchHasher>(options);
+                }
+                rings[worker]->SetMaxFiles(IoScheduler::IsRotational(batch.front()->GetStamp().dev) ? 1 : 0);
+                rings[worker]->Run(batch, full, on_done, budget);
+            });
+            return;
+        }
+
+        if (threads == 1) {
+            BatchHasher(options).Run(ordered, full, on_done, budget);
+            return;
+        }
+
+        //every thread drives its own ring over its share of files
+        std::vector<std::vector<const fl::File*>> parts(threads);
+        for (std::size_t i = 0; i < ordered.size(); ++i) {
+            parts[i % threads].push_back(ordered[i]);
+        }
+        ThreadPool pool(threads);
+        for (const auto& part : parts) {
+            pool.Submit([&options, &part, &on_done, budget, full]() {
+                BatchHasher(options).Run(part, full, on_done, budget);
+            });
+        }
+        pool.Wait();
+        return;
+    }
+
+    //MD5 of files of the same size is calculated in SIMD lanes, a task gets files of one size
+    if (full && MultiHasher::Width() > 1) {
+        const auto parts = MultiHasher::Batches(ordered);
+
+        if (threads == 1) {
+            MultiHasher hasher(options);
+            for (const auto& part : parts) {
+                hasher.Run(part, on_done, budget);
+            }
+            return;
+        }
+
+        //batches of rotational devices go in order of their first files with a few at once
+        if (options.schedule) {
+            std::vector<std::unique_ptr<MultiHasher>> hashers(threads);
+            scheduler.RunBatches(parts, threads, [&](std::size_t worker, const IoScheduler::Batch& part) {
+                if (!hashers[worker]) {
+                    hashers[worker] = std::make_unique<MultiHasher>(options);
+                }
+                hashers[worker]->Run(part, on_done, budget);
+            });
+            return;
+        }
+
+        ThreadPool pool(threads);
+        for (const auto& part : parts) {
+            pool.Submit([&options, &part, &on_done, budget]() { MultiHasher(options).Run(part, on_done, budget); });
+        }
+        pool.Wait();
+        return;
+    }
+
+    auto calc = [&on_done, &admit, budget, full](const fl::File* f) {
+        if (admit(f)) {
+            if (full) {
+                f->GetHashSum(budget);
+            }
+            else {
+                f->GetSampleHashSum(budget);
+            }
+        }
+        if (on_done) {
+            on_done(f);
+        }
+    };
+
+    if (threads == 1) {
+        for (const auto* f : ordered) {
+            calc(f);
+        }
+        return;
+    }
+
+    //rotational devices get only a few concurrent readers
+    if (options.schedule) {
+        scheduler.Run(ordered, threads, calc);
+        return;
+    }
+
+    ThreadPool pool(threads);
+    for (const auto* f : ordered) {
+        pool.Submit([f, &calc]() { calc(f); });
+    }
+    pool.Wait();
+}
+
+void DupsSearcher::FindSharedExtents(std::vector<std::vector<TaggedFile>>& buckets, std::size_t min_dirs,
+                                     const ClusterCallback& on_cluster,
+                                     std::unordered_map<const fl::File*, const fl::File*>& shared_with) const {
+    PhaseTimer timer(Stats::Phase::Group);
+
+    std::vector<const fl::File*> probed;
+    for (const auto& bucket : buckets) {
+        if (bucket.front().file->GetFileSize() >= MIN_SHARED_SIZE) {
+            for (const auto& tf : bucket) {
+                probed.push_back(tf.file);
+            }
+        }
+    }
+    if (probed.empty()) {
+        return;
+    }
+
+    //extent maps are asked in parallel by parts of files
+    std::vector<Digest> keys(probed.size());
+    auto probe = [&keys, &probed](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i) {
+            keys[i] = SharedExtentsKey(probed[i]->GetFilePath());
+        }
+    };
+    const auto threads = m_jobs == 1 ? 1 : std::min(ThreadPool::ThreadsNum(m_jobs), probed.size());
+    if (threads == 1) {
+        probe(0, probed.size());
+    }
+    else {
+        ThreadPool pool(threads);
+        const auto step = (probed.size() + threads - 1) / threads;
+        for (std::size_t first = 0; first < probed.size(); first += step) {
+            const auto last = std::min(first + step, probed.size());
+            pool.Submit([&probe, first, last]() { probe(first, last); });
+        }
+        pool.Wait();
+    }
+
+    //keys go in order of buckets and their files
+    std::size_t next = 0;
+    std::size_t kept = 0;
+    auto keep = [&buckets, &kept](std::size_t b) {
+        if (b != kept) {
+            buckets[kept] = std::move(buckets[b]);
+        }
+        ++kept;
+    };
+    for (std::size_t b = 0; b < buckets.size(); ++b) {
+        auto& bucket = buckets[b];
+        if (bucket.front().file->GetFileSize() < MIN_SHARED_SIZE) {
+            keep(b);
+            continue;
+        }
+
+        std::unordered_map<Digest, const fl::File*, DigestHash> sets;
+        std::vector<std::pair<const fl::File*, const fl::File*>> in_sets;
+        for (const auto& tf : bucket) {
+            const auto& key = keys[next++];
+            if (!key.empty()) {
+                auto ins = sets.emplace(key, tf.file);
+                in_sets.emplace_back(tf.file, ins.first->second);
+            }
+        }
+
+        //bucket is one set: cluster is known without reading
+        if (sets.size() == 1 && in_sets.size() == bucket.size()) {
+            DupsCluster cl;
+            cl.files = std::move(bucket);
+            cl.dirs_num = DirsNum(cl.files);
+            cl.shared = true;
+            Stats::Add(Stats::Counter::SharedExtents, cl.files.size());
+            if (cl.dirs_num >= min_dirs) {
+                on_cluster(cl);
+            }
+            continue;
+        }
+
+        for (const auto& p : in_sets) {
+            shared_with.insert(p);
+            if (p.first != p.second) {
+                Stats::Add(Stats::Counter::SharedExtents);
+            }
+        }
+        keep(b);
+    }
+    buckets.resize(kept);
+}
+
+void DupsSearcher::FilterByBlocks(std::vector<std::vector<TaggedFile>>& buckets, std::size_t min_dirs,
+                                  const std::unordered_map<const fl::File*, const fl::File*>& shared_with,
+                                  SearchBudget* budget) const {
+    const BlockSampler sampler(m_blocks_min_size);
+
+    //one file of each inode and of each set of shared extents is read
+    auto id_of = [&shared_with](const fl::File* f) {
+        auto it = shared_with.find(f);
+        return (it != shared_with.end() ? it->second : f)->GetStamp().GetId();
+    };
+    std::vector<const fl::File*> reps;
+    std::unordered_map<FileId, std::size_t, FileIdHash> rep_of;
+    for (const auto& bucket : buckets) {
+        if (!sampler.IsSampled(bucket.front().file->GetFileSize())) {
+            continue;
+        }
+        for (const auto& tf : bucket) {
+            if (rep_of.emplace(id_of(tf.file), reps.size()).second) {
+                reps.push_back(tf.file);
+            }
+        }
+    }
+    if (reps.empty()) {
+        return;
+    }
+
+    PhaseTimer timer(Stats::Phase::SampleHash);
+    std::vector<Digest> prints(reps.size());
+    auto calc = [&](std::size_t i) {
+        const auto size = reps[i]->GetFileSize();
+        if (!budget || budget->Take(std::uint64_t{ sampler.BlocksNum(size) } * BlockSampler::BlockSize)) {
+            prints[i] = sampler.Hash(*reps[i]);
+        }
+    };
+    const auto threads = m_jobs == 1 ? 1 : std::min(ThreadPool::ThreadsNum(m_jobs), reps.size());
+    if (threads == 1) {
+        for (std::size_t i = 0; i < reps.size(); ++i) {
+            calc(i);
+        }
+    }
+    else {
+        ThreadPool pool(threads);
+        for (std::size_t i = 0; i < reps.size(); ++i) {
+            pool.Submit([&calc, i]() { calc(i); });
+        }
+        pool.Wait();
+    }
+
+    //files are split by sample and fingerprint together, bucket with unknown fingerprint is kept as is
+    std::size_t kept = 0;
+    for (std::size_t b = 0; b < buckets.size(); ++b) {
+        auto& bucket = buckets[b];
+        if (!sampler.IsSampled(bucket.front().file->GetFileSize()) ||
+            std::any_of(bucket.begin(), bucket.end(), [&](const TaggedFile& tf) {
+                return prints[rep_of.at(id_of(tf.file))].empty();
+            })) {
+            if (b != kept) {
+                buckets[kept] = std::move(bucket);
+            }
+            ++kept;
+            continue;
+        }
+
+        std::map<std::pair<Digest, Digest>, std::vector<TaggedFile>> by_print;
+        auto key = [&](const TaggedFile& tf) {
+            return std::make_pair(tf.file->GetSampleHashSum(), prints[rep_of.at(id_of(tf.file))]);
+        };
+        for (const auto& tf : bucket) {
+            by_print[key(tf)].push_back(tf);
+        }
+        std::vector<TaggedFile> matched;
+        for (const auto& tf : bucket) {
+            const auto& group = by_print[key(tf)];
+            if (group.size() > 1 && DirsNum(group) >= min_dirs) {
+                matched.push_back(tf);
+            }
+        }
+        Stats::Add(Stats::Counter::AvoidedByBlocks, bucket.size() - matched.size());
+        if (!matched.empty()) {
+            buckets[kept++] = std::move(matched);
+        }
+    }
+    buckets.resize(kept);
+}
+
+void DupsSearcher::CompareBuckets(const std::vector<std::vector<TaggedFile>>& buckets, std::size_t min_dirs,
+                                  const ClusterCallback& on_cluster, SearchBudget* budget,
+                                  const UnresolvedCallback& on_unresolved) const {
+    PhaseTimer timer(Stats::Phase::Compare);
+
+    const auto threads = m_jobs == 1 ? 1 : std::min(ThreadPool::ThreadsNum(m_jobs), buckets.size());
+    ByteComparer::Options options;
+    options.budget = budget;
+    options.max_open_files = std::max<std::size_t>(m_max_open_files / std::max<std::size_t>(threads, 1), 2);
+
+    std::mutex done_mutex;
+    auto process = [&](const std::vector<TaggedFile>& bucket) {
+        //the whole bucket is read in lockstep, so it is admitted at once
+        if (budget && !budget->Take(std::uint64_t{ bucket.front().file->GetFileSize() } * bucket.size())) {
+            if (on_unresolved) {
+                std::lock_guard<std::mutex> lk(done_mutex);
+                on_unresolved(bucket);
+            }
+            return;
+        }
+        //only one file of each inode is read, its links join its cluster
+        std::vector<const fl::File*> reps;
+        std::vector<std::vector<TaggedFile>> links;
+        std::unordered_map<FileId, std::size_t, FileIdHash> inodes;
+        for (const auto& tf : bucket) {
+            auto ins = inodes.emplace(tf.file->GetStamp().GetId(), reps.size());
+            if (ins.second) {
+                reps.push_back(tf.file);
+                links.emplace_back();
+            }
+            links[ins.first->second].push_back(tf);
+        }
+
+        //files of cluster in order of inputs and their content
+        auto expand = [&links](const ByteComparer::Group& g) {
+            std::vector<TaggedFile> files;
+            for (auto r : g) {
+                files.insert(files.end(), links[r].begin(), links[r].end());
+            }
+            std::sort(files.begin(), files.end(), [](const TaggedFile& a, const TaggedFile& b) {
+                return a.dir_idx != b.dir_idx ? a.dir_idx < b.dir_idx : std::less<const fl::File*>()(a.file, b.file);
+            });
+            return files;
+        };
+        auto can_be_cluster = [&expand, min_dirs](const ByteComparer::Group& g) {
+            auto files = expand(g);
+            return files.size() > 1 && DirsNum(files) >= min_dirs;
+        };
+
+        //filter accepts single file if its links make a cluster
+        ByteComparer comparer(options, can_be_cluster);
+        bool stopped = false;
+        const auto groups = comparer.Split(reps, &stopped);
+        if (stopped) {
+            //deadline is passed or search is cancelled in the middle of bucket
+            if (on_unresolved) {
+                std::lock_guard<std::mutex> lk(done_mutex);
+                on_unresolved(bucket);
+            }
+            return;
+        }
+        for (const auto& g : groups) {
+            DupsCluster cl;
+            cl.files = expand(g);
+            cl.dirs_num = DirsNum(cl.files);
+            std::lock_guard<std::mutex> lk(done_mutex);
+            on_cluster(cl);
+        }
+    };
+
+    if (threads <= 1) {
+        for (const auto& bucket : buckets) {
+            process(bucket);
+        }
+        return;
+    }
+
+    ThreadPool pool(threads);
+    for (const auto& bucket : buckets) {
+        pool.Submit([&process, &bucket]() { process(bucket); });
+    }
+    pool.Wait();
+}
 
 }
@@ -0,0 +1,89 @@
+#include <system_error>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "spill_file.h"
+#include "stats.h"
+
+namespace fl {
+
+SpillFile::SpillFile(const std::string& dir, std::size_t buffer_size) : m_buffer_size(buffer_size) {
+#ifdef O_TMPFILE
+    m_fd = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+    if (m_fd < 0) {
+        //file system doesn't support O_TMPFILE
+        std::string path = dir + "/dups_spill_XXXXXX";
+        m_fd = ::mkostemp(&path[0], O_CLOEXEC);
+        if (m_fd >= 0) {
+            ::unlink(path.c_str());
+        }
+    }
+    if (m_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot create temporary file in " + dir);
+    }
+}
+
+SpillFile::~SpillFile() {
+    ::close(m_fd);
+}
+
+std::uint64_t SpillFile::Append(const void* data, std::size_t len) {
+    const auto offset = Size();
+    if (m_buf.size() + len > m_buffer_size) {
+        Flush();
+    }
+    //big portions go to file directly
+    if (len >= m_buffer_size) {
+        Write(data, len);
+        return offset;
+    }
+    if (m_buf.capacity() < m_buffer_size) {
+        m_buf.reserve(m_buffer_size);
+    }
+    const auto* p = static_cast<const char*>(data);
+    m_buf.insert(m_buf.end(), p, p + len);
+    return offset;
+}
+
+void SpillFile::Flush() {
+    Write(m_buf.data(), m_buf.size());
+    m_buf.clear();
+}
+
+void SpillFile::Write(const void* data, std::size_t len) {
+    const auto* p = static_cast<const char*>(data);
+    std::size_t done = 0;
+    while (done < len) {
+        const auto res = ::pwrite(m_fd, p + done, len - done, static_cast<off_t>(m_written + done));
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "Cannot write temporary file");
+        }
+        done += static_cast<std::size_t>(res);
+    }
+    Stats::Add(Stats::Counter::SpilledBytes, done);
+    m_written += done;
+}
+
+void SpillFile::ReadAt(std::uint64_t offset, void* dst, std::size_t len) const {
+    auto* p = static_cast<char*>(dst);
+    std::size_t done = 0;
+    while (done < len) {
+        const auto res = ::pread(m_fd, p + done, len - done, static_cast<off_t>(offset + done));
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            throw std::system_error(res < 0 ? errno : EIO, std::generic_category(), "Cannot read temporary file");
+        }
+        done += static_cast<std::size_t>(res);
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#ifndef __SPILL_FILE_H__
+#define __SPILL_FILE_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace fl {
+
+//Anonymous temporary file for data which doesn't fit into memory.
+//File has no name (O_TMPFILE or unlinked right after creation), so it is removed by closing even on crash.
+//Appends go through userspace buffer, reads are positional. Errors are thrown as std::system_error.
+class SpillFile
+{
+public:
+    //buffer_size 0 - every append is written at once
+    SpillFile(const std::string& dir, std::size_t buffer_size);
+    ~SpillFile();
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    //append data, return its offset in file
+    std::uint64_t Append(const void* data, std::size_t len);
+    //write buffered data, must be called before reading of it
+    void Flush();
+
+    //read len bytes from offset
+    void ReadAt(std::uint64_t offset, void* dst, std::size_t len) const;
+
+    //size of file with buffered data
+    std::uint64_t Size() const {
+        return m_written + m_buf.size();
+    }
+
+private:
+    void Write(const void* data, std::size_t len);
+
+    int                 m_fd{ -1 };
+    std::vector<char>   m_buf;
+    std::size_t         m_buffer_size;
+    std::uint64_t       m_written{ 0 };
+};
+
+}
+
+#endif // ! __SPILL_FILE_H__
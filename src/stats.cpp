@@ -0,0 +1,184 @@
+#include <iomanip>
+#include <ctime>
+
+#include <sys/resource.h>
+
+#include "stats.h"
+
+namespace fl {
+
+namespace {
+    std::uint64_t ClockNs(clockid_t clock) {
+        timespec ts{};
+        ::clock_gettime(clock, &ts);
+        return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<std::uint64_t>(ts.tv_nsec);
+    }
+
+    double Millis(std::uint64_t ns) {
+        return static_cast<double>(ns) / 1e6;
+    }
+}
+
+Stats::PaddedCounter Stats::s_counters[static_cast<std::size_t>(Counter::Count_)];
+std::atomic<std::uint64_t> Stats::s_wall_ns[static_cast<std::size_t>(Phase::Count_)];
+std::atomic<std::uint64_t> Stats::s_cpu_ns[static_cast<std::size_t>(Phase::Count_)];
+
+void Stats::AddTime(Phase phase, std::uint64_t wall_ns, std::uint64_t cpu_ns) {
+    s_wall_ns[static_cast<std::size_t>(phase)].fetch_add(wall_ns, std::memory_order_relaxed);
+    s_cpu_ns[static_cast<std::size_t>(phase)].fetch_add(cpu_ns, std::memory_order_relaxed);
+}
+
+std::uint64_t Stats::GetWallTime(Phase phase) {
+    return s_wall_ns[static_cast<std::size_t>(phase)].load(std::memory_order_relaxed);
+}
+
+std::uint64_t Stats::GetCpuTime(Phase phase) {
+    return s_cpu_ns[static_cast<std::size_t>(phase)].load(std::memory_order_relaxed);
+}
+
+std::uint64_t Stats::GetPeakRss() {
+    rusage ru{};
+    if (::getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0;
+    }
+    //kilobytes on Linux
+    return static_cast<std::uint64_t>(ru.ru_maxrss) * 1024;
+}
+
+void Stats::Reset() {
+    for (auto& c : s_counters) {
+        c.value.store(0, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < static_cast<std::size_t>(Phase::Count_); ++i) {
+        s_wall_ns[i].store(0, std::memory_order_relaxed);
+        s_cpu_ns[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* Stats::CounterName(Counter counter) {
+    switch (counter) {
+    case Counter::StatCalls:
+        return "stat_calls";
+    case Counter::DirsRead:
+        return "dirs_read";
+    case Counter::FilesOpened:
+        return "files_opened";
+    case Counter::BytesRead:
+        return "bytes_read";
+    case Counter::BytesHashed:
+        return "bytes_hashed";
+    case Counter::SampleHashes:
+        return "sample_hashes";
+    case Counter::FullHashes:
+        return "full_hashes";
+    case Counter::CacheHits:
+        return "cache_hits";
+    case Counter::LinksShared:
+        return "links_shared";
+    case Counter::AvoidedBySize:
+        return "avoided_by_size";
+    case Counter::AvoidedBySample:
+        return "avoided_by_sample";
+    case Counter::AvoidedByInode:
+        return "avoided_by_inode";
+    case Counter::CacheResident:
+        return "cache_resident_bytes";
+    case Counter::CacheMissed:
+        return "cache_missed_bytes";
+    case Counter::CacheDropped:
+        return "cache_dropped_bytes";
+    case Counter::DirectRead:
+        return "direct_read_bytes";
+    case Counter::SpilledBytes:
+        return "spilled_bytes";
+    case Counter::SpillRuns:
+        return "spill_runs";
+    case Counter::SeekOrdered:
+        return "seek_ordered";
+    case Counter::ResidentFirst:
+        return "resident_first";
+    case Counter::HoleBytes:
+        return "hole_bytes";
+    case Counter::SharedExtents:
+        return "shared_extents";
+    case Counter::BlockSamples:
+        return "block_samples";
+    case Counter::AvoidedByBlocks:
+        return "avoided_by_blocks";
+    case Counter::Count_:
+        break;
+    }
+    return "";
+}
+
+const char* Stats::PhaseName(Phase phase) {
+    switch (phase) {
+    case Phase::Scan:
+        return "scan";
+    case Phase::Group:
+        return "group";
+    case Phase::SampleHash:
+        return "sample_hash";
+    case Phase::FullHash:
+        return "full_hash";
+    case Phase::Compare:
+        return "compare";
+    case Phase::Output:
+        return "output";
+    case Phase::Count_:
+        break;
+    }
+    return "";
+}
+
+void Stats::PrintSummary(std::ostream& os) {
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+
+    os << "Phases (wall ms / cpu ms):\n";
+    for (std::size_t i = 0; i < static_cast<std::size_t>(Phase::Count_); ++i) {
+        const auto phase = static_cast<Phase>(i);
+        os << "  " << std::left << std::setw(20) << PhaseName(phase) << std::right
+           << std::setw(12) << Millis(GetWallTime(phase)) << " / " << Millis(GetCpuTime(phase)) << "\n";
+    }
+
+    os << "Counters:\n";
+    for (std::size_t i = 0; i < static_cast<std::size_t>(Counter::Count_); ++i) {
+        const auto counter = static_cast<Counter>(i);
+        os << "  " << std::left << std::setw(20) << CounterName(counter) << std::right
+           << std::setw(12) << Get(counter) << "\n";
+    }
+
+    os << "  " << std::left << std::setw(20) << "peak_rss_bytes" << std::right
+       << std::setw(12) << GetPeakRss() << "\n";
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void Stats::PrintJson(std::ostream& os) {
+    os << "{\"phases\":{";
+    for (std::size_t i = 0; i < static_cast<std::size_t>(Phase::Count_); ++i) {
+        const auto phase = static_cast<Phase>(i);
+        os << (i == 0 ? "" : ",") << "\"" << PhaseName(phase) << "\":{\"wall_ns\":" << GetWallTime(phase)
+           << ",\"cpu_ns\":" << GetCpuTime(phase) << "}";
+    }
+    os << "},\"counters\":{";
+    for (std::size_t i = 0; i < static_cast<std::size_t>(Counter::Count_); ++i) {
+        const auto counter = static_cast<Counter>(i);
+        os << (i == 0 ? "" : ",") << "\"" << CounterName(counter) << "\":" << Get(counter);
+    }
+    os << "},\"peak_rss_bytes\":" << GetPeakRss() << "}\n";
+}
+
+PhaseTimer::PhaseTimer(Stats::Phase phase) : m_phase(phase),
+                                             m_wall_start(ClockNs(CLOCK_MONOTONIC)),
+                                             m_cpu_start(ClockNs(CLOCK_PROCESS_CPUTIME_ID)) {
+}
+
+PhaseTimer::~PhaseTimer() {
+    Stats::AddTime(m_phase, ClockNs(CLOCK_MONOTONIC) - m_wall_start, ClockNs(CLOCK_PROCESS_CPUTIME_ID) - m_cpu_start);
+}
+
+}
@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+namespace fl {
+
+std::size_t ThreadPool::ThreadsNum(std::size_t jobs) {
+    if (jobs != 0) {
+        return jobs;
+    }
+    auto hw = static_cast<std::size_t>(std::thread::hardware_concurrency());
+    return hw != 0 ? hw : 1;
+}
+
+ThreadPool::ThreadPool(std::size_t threads_num) {
+    const auto n = ThreadsNum(threads_num);
+    m_workers.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        m_workers.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_stop = true;
+    }
+    m_task_cv.notify_all();
+    for (auto& w : m_workers) {
+        w.join();
+    }
+}
+
+void ThreadPool::Submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_tasks.push(std::move(task));
+    }
+    m_task_cv.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_done_cv.wait(lk, [this]() { return m_tasks.empty() && m_active == 0; });
+
+    if (m_error) {
+        auto err = m_error;
+        m_error = nullptr;
+        std::rethrow_exception(err);
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_task_cv.wait(lk, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                //stop requested and nothing left
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+            ++m_active;
+        }
+
+        std::exception_ptr err;
+        try {
+            task();
+        }
+        catch (...) {
+            err = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            --m_active;
+            if (err && !m_error) {
+                m_error = err;
+            }
+            if (m_tasks.empty() && m_active == 0) {
+                m_done_cv.notify_all();
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,151 @@
+#include <atomic>
+
+#include "gtest/gtest.h"
+#include "batch_hasher.h"
+#include "io_scheduler.h"
+#include "searcher.h"
+#include "temp_tree.h"
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+//files of different sizes around read block size and sample size, empty and one byte ones too
+class BatchHasherTest : public testing::Test
+{
+protected:
+    void SetUp() override {
+        std::size_t n = 0;
+        for (std::size_t size : { 0, 1, 4095, 4096, 4097, 10000, 65536, 100 * 1000, 300 * 1000 }) {
+            std::string content(size, '\0');
+            for (std::size_t i = 0; i < size; ++i) {
+                content[i] = static_cast<char>((i * 7 + size) % 251);
+            }
+            const auto name = "f" + std::to_string(n++);
+            m_tree.Put(name, content);
+            m_paths.push_back(m_tree.Path(name));
+        }
+        for (const auto* name : { "f1", "f2", "another_f", "empty_f", "samples/mid_a", "samples/mid_b" }) {
+            m_paths.push_back(TEST_DIR_PATH + "/" + name);
+        }
+
+        m_options.buffer_size = 4096;
+        m_options.queue_depth = 4;
+    }
+
+    void TearDown() override {
+        fl::File::SetReadOptions(fl::ReadOptions{});
+    }
+
+    //hash files by BatchHasher and compare with hashes of File
+    void Check(bool full, std::size_t max_files = 0) {
+        std::vector<fl::File> expected;
+        std::vector<fl::File> files;
+        for (const auto& p : m_paths) {
+            expected.emplace_back(p);
+            files.emplace_back(p);
+        }
+        std::vector<const fl::File*> ptrs;
+        for (const auto& f : files) {
+            ptrs.push_back(&f);
+        }
+
+        std::atomic<std::size_t> done{ 0 };
+        fl::BatchHasher hasher(m_options);
+        hasher.SetMaxFiles(max_files);
+        hasher.Run(ptrs, full, [&done](const fl::File*) { ++done; });
+        EXPECT_EQ(done, files.size());
+
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            if (full) {
+                ASSERT_TRUE(files[i].HasHashSum()) << m_paths[i];
+                EXPECT_EQ(files[i].GetHashSum(), expected[i].GetHashSum()) << m_paths[i];
+            }
+            else {
+                EXPECT_EQ(files[i].GetSampleHashSum(), expected[i].GetSampleHashSum()) << m_paths[i];
+            }
+        }
+    }
+
+    TempTree                    m_tree{ "dups_batch_hasher_test" };
+    std::vector<std::string>    m_paths;
+    fl::ReadOptions             m_options;
+};
+
+TEST_F(BatchHasherTest, FullHashes)
+{
+    Check(true);
+}
+
+TEST_F(BatchHasherTest, SampleHashes)
+{
+    Check(false);
+}
+
+TEST_F(BatchHasherTest, DeepQueue)
+{
+    m_options.queue_depth = 64;
+    Check(true);
+}
+
+//reads of rotational device go file by file
+TEST_F(BatchHasherTest, OneFileAtOnce)
+{
+    Check(true, 1);
+    Check(false, 1);
+}
+
+TEST_F(BatchHasherTest, PageCacheModes)
+{
+    for (auto mode : { fl::CacheMode::Drop, fl::CacheMode::Direct }) {
+        m_options.cache = mode;
+        Check(true);
+        Check(false);
+    }
+}
+
+//searcher with uring engine finds the same clusters as with pread
+TEST_F(BatchHasherTest, Searcher)
+{
+    auto search = [this](std::size_t jobs) {
+        fl::DupsSearcher ds(jobs);
+        ds.SetRecursive(true);
+        std::vector<std::vector<fl::File>> contents;
+        contents.push_back(ds.GetDirectoryContent(TEST_DIR_PATH));
+        contents.push_back(ds.GetDirectoryContent(m_tree.Root().string()));
+        contents.push_back(ds.GetDirectoryContent(TEST_DIR_PATH));
+        std::vector<std::vector<std::string>> res;
+        for (const auto& cl : ds.GetDuplicatedClusters(contents, 1)) {
+            res.emplace_back();
+            for (const auto& tf : cl.files) {
+                res.back().push_back(tf.file->GetFilePath());
+            }
+        }
+        return res;
+    };
+
+    //rotational devices get rings by IoScheduler
+    const auto tree_dev = fl::File(m_paths.front()).GetStamp().dev;
+    const auto test_dev = fl::File(m_paths.back()).GetStamp().dev;
+    for (bool rotational : { false, true }) {
+        for (auto dev : { tree_dev, test_dev }) {
+            fl::IoScheduler::SetRotational(dev, rotational);
+        }
+        for (std::size_t jobs : { 1, 3 }) {
+            const auto expected = search(jobs);
+            ASSERT_FALSE(expected.empty());
+
+            auto options = m_options;
+            options.engine = fl::IoEngine::Uring;
+            fl::File::SetReadOptions(options);
+            const auto res = search(jobs);
+            fl::File::SetReadOptions(fl::ReadOptions{});
+
+            EXPECT_EQ(res, expected);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
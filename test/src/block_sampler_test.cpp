@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <filesystem>
+
+#include "gtest/gtest.h"
+#include "block_sampler.h"
+#include "searcher.h"
+#include "stats.h"
+#include "temp_tree.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr std::uint64_t MIN_SIZE = 256 * 1024;
+}
+
+TEST(BlockSampler, BlocksNum)
+{
+    const fl::BlockSampler sampler(MIN_SIZE);
+    EXPECT_EQ(sampler.BlocksNum(MIN_SIZE - 1), 0);
+    EXPECT_EQ(sampler.BlocksNum(MIN_SIZE), 4);              //only 4 blocks fit
+    EXPECT_EQ(sampler.BlocksNum(4 * MIN_SIZE), 16);
+    EXPECT_EQ(sampler.BlocksNum(4 * MIN_SIZE - 1), 15);     //one doubling, 15 blocks fit
+    EXPECT_EQ(sampler.BlocksNum(MIN_SIZE << 6), 56);
+    EXPECT_EQ(sampler.BlocksNum(MIN_SIZE << 7), 64);
+    EXPECT_EQ(sampler.BlocksNum(1ULL << 40), fl::BlockSampler::MaxBlocks);
+
+    EXPECT_FALSE(fl::BlockSampler(0).IsSampled(1ULL << 40));
+    EXPECT_EQ(fl::BlockSampler(0).BlocksNum(1ULL << 40), 0);
+    EXPECT_TRUE(fl::BlockSampler(1ULL << 30).IsSampled(1ULL << 30));
+    EXPECT_EQ(fl::BlockSampler(1ULL << 30).BlocksNum(1ULL << 30), 8);
+}
+
+//offsets depend only on size, every block is inside its own stratum
+TEST(BlockSampler, Offsets)
+{
+    const fl::BlockSampler sampler(MIN_SIZE);
+    const std::vector<std::uint64_t> sizes{ MIN_SIZE, MIN_SIZE * 3 + 12345, 1ULL << 30, (1ULL << 40) + 1 };
+    for (auto size : sizes) {
+        const auto offsets = sampler.Offsets(size);
+        ASSERT_EQ(offsets.size(), sampler.BlocksNum(size));
+        EXPECT_EQ(offsets, fl::BlockSampler(MIN_SIZE).Offsets(size));
+
+        const auto stratum = size / offsets.size() / 4096 * 4096;
+        for (std::size_t i = 0; i < offsets.size(); ++i) {
+            EXPECT_EQ(offsets[i] % 4096, 0) << size;
+            EXPECT_GE(offsets[i], i * stratum) << size;
+            EXPECT_LE(offsets[i] + fl::BlockSampler::BlockSize, (i + 1) * stratum) << size;
+        }
+    }
+    //other size, other places
+    EXPECT_NE(sampler.Offsets(1ULL << 30), sampler.Offsets((1ULL << 30) + 4096));
+}
+
+//"a" and "b" have copies of big file, "b" has also the same file changed in one byte inside of block
+//and the same file changed in one byte between blocks
+class BlockSamplerTest : public testing::Test
+{
+protected:
+    static constexpr std::size_t SIZE = 1 << 20;
+
+    void SetUp() override {
+        std::string content(SIZE, 'x');
+        for (std::size_t i = 0; i < SIZE; i += 97) {
+            content[i] = static_cast<char>('a' + i % 26);
+        }
+        //changes are far from samples of file beginning and end
+        const auto offsets = fl::BlockSampler(SIZE).Offsets(SIZE);
+        ASSERT_EQ(offsets.size(), 8);
+        const auto in_block = offsets[4] + fl::BlockSampler::BlockSize / 2;
+        std::uint64_t between = 0;
+        for (std::size_t i = 1; i + 2 < offsets.size() && between == 0; ++i) {
+            if (offsets[i] + fl::BlockSampler::BlockSize < offsets[i + 1]) {
+                between = offsets[i] + fl::BlockSampler::BlockSize;
+            }
+        }
+        ASSERT_NE(between, 0);
+
+        m_tree.Put("a/big", content);
+        m_tree.Put("b/copy", content);
+        auto changed = content;
+        changed[in_block] = '!';
+        m_tree.Put("b/changed", changed);
+        changed = content;
+        changed[between] = '!';
+        m_tree.Put("b/between", changed);
+
+        m_kind = fl::File::GetHashKind();
+    }
+
+    void TearDown() override {
+        fl::File::SetHashKind(m_kind);
+    }
+
+    TempTree        m_tree{ "dups_block_sampler_test" };
+    fl::HashKind    m_kind{ fl::HashKind::XXH3 };
+};
+
+TEST_F(BlockSamplerTest, Hash)
+{
+    for (auto kind : { fl::HashKind::XXH3, fl::HashKind::MD5 }) {
+        fl::File::SetHashKind(kind);
+        const fl::BlockSampler sampler(SIZE);
+        const auto print = sampler.Hash(fl::File(m_tree.Path("a/big")));
+        EXPECT_NE(print, fl::Digest{});
+        EXPECT_EQ(sampler.Hash(fl::File(m_tree.Path("b/copy"))), print);
+        EXPECT_NE(sampler.Hash(fl::File(m_tree.Path("b/changed"))), print);
+        //fingerprint doesn't prove equality
+        EXPECT_EQ(sampler.Hash(fl::File(m_tree.Path("b/between"))), print);
+
+        //not sampled
+        EXPECT_EQ(fl::BlockSampler(0).Hash(fl::File(m_tree.Path("a/big"))), fl::Digest{});
+        EXPECT_EQ(fl::BlockSampler(2 * SIZE).Hash(fl::File(m_tree.Path("a/big"))), fl::Digest{});
+    }
+}
+
+//file different in block is dropped before full hash, file different between blocks is dropped by it
+TEST_F(BlockSamplerTest, Search)
+{
+    for (std::size_t jobs : { 1, 4 }) {
+        for (std::uint64_t min_size : { std::uint64_t{ 0 }, std::uint64_t{ SIZE } }) {
+            fl::DupsSearcher ds(jobs);
+            ds.SetBlocksMinSize(min_size);
+            std::vector<std::vector<fl::File>> contents;
+            contents.push_back(ds.GetDirectoryContent(m_tree.Path("a")));
+            contents.push_back(ds.GetDirectoryContent(m_tree.Path("b")));
+
+            const auto avoided = fl::Stats::Get(fl::Stats::Counter::AvoidedByBlocks);
+            const auto samples = fl::Stats::Get(fl::Stats::Counter::BlockSamples);
+            const auto clusters = ds.GetDuplicatedClusters(contents, 2);
+            ASSERT_EQ(clusters.size(), 1);
+            std::vector<std::string> names;
+            for (const auto& tf : clusters.front().files) {
+                names.push_back(fs::path(tf.file->GetFilePath()).filename().string());
+            }
+            std::sort(names.begin(), names.end());
+            EXPECT_EQ(names, (std::vector<std::string>{ "big", "copy" }));
+
+            EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::AvoidedByBlocks) - avoided, min_size != 0 ? 1 : 0);
+            EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::BlockSamples) - samples, min_size != 0 ? 4 : 0);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
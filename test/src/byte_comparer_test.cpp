@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+#include "byte_comparer.h"
+#include "searcher.h"
+#include "stats.h"
+#include "temp_tree.h"
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+//directory with files of the same size: 0, 1, 4 are identical, 2 differs from them in the last byte, 3 in the first one
+class ByteComparerTest : public testing::Test
+{
+protected:
+    static constexpr std::size_t FILE_SIZE = 100 * 1000;
+
+    void SetUp() override {
+        std::string content(FILE_SIZE, 'a');
+        for (std::size_t i = 0; i < content.size(); ++i) {
+            content[i] = static_cast<char>('a' + i % 26);
+        }
+        auto last = content;
+        last.back() = '!';
+        auto first = content;
+        first.front() = '!';
+
+        for (const auto* data : { &content, &content, &last, &first, &content }) {
+            const auto name = "f" + std::to_string(m_files.size());
+            m_tree.Put(name, *data);
+            m_files.emplace_back(m_tree.Path(name));
+        }
+        for (const auto& f : m_files) {
+            m_ptrs.push_back(&f);
+        }
+    }
+
+    TempTree                        m_tree{ "dups_byte_comparer_test" };
+    std::vector<fl::File>           m_files;
+    std::vector<const fl::File*>    m_ptrs;
+};
+
+TEST_F(ByteComparerTest, Lockstep)
+{
+    fl::ByteComparer::Options options;
+    options.block_size = 4096;
+    fl::ByteComparer comparer(options);
+
+    auto groups = comparer.Split(m_ptrs);
+    ASSERT_EQ(groups.size(), 1);
+    EXPECT_EQ(groups[0], (fl::ByteComparer::Group{ 0, 1, 4 }));
+}
+
+TEST_F(ByteComparerTest, MoreFilesThanLimit)
+{
+    //pre-split by block hashes, then comparison with the first file by batches
+    for (std::size_t max_open : { 2, 3 }) {
+        fl::ByteComparer::Options options;
+        options.block_size = 4096;
+        options.max_open_files = max_open;
+        fl::ByteComparer comparer(options);
+
+        auto groups = comparer.Split(m_ptrs);
+        ASSERT_EQ(groups.size(), 1);
+        EXPECT_EQ(groups[0], (fl::ByteComparer::Group{ 0, 1, 4 }));
+    }
+}
+
+TEST_F(ByteComparerTest, StopsAtFirstDifference)
+{
+    fl::ByteComparer::Options options;
+    options.block_size = 4096;
+    fl::ByteComparer comparer(options);
+
+    fl::Stats::Reset();
+    EXPECT_TRUE(comparer.Split({ m_ptrs[0], m_ptrs[3] }).empty());
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::BytesRead), 2 * options.block_size);
+}
+
+TEST_F(ByteComparerTest, Filter)
+{
+    fl::ByteComparer::Options options;
+    fl::ByteComparer comparer(options, [](const fl::ByteComparer::Group& g) { return g.size() > 2; });
+    EXPECT_EQ(comparer.Split(m_ptrs).size(), 1);
+    EXPECT_TRUE(comparer.Split({ m_ptrs[0], m_ptrs[1], m_ptrs[2] }).empty());
+}
+
+TEST(DupsSearcher, BytesTheSameAsHash)
+{
+    fl::DupsSearcher hash_ds;
+    fl::DupsSearcher bytes_ds;
+    bytes_ds.SetCompareMode(fl::DupsSearcher::CompareMode::Bytes);
+
+    std::vector<std::vector<fl::File>> contents;
+    contents.push_back(hash_ds.GetDirectoryContent(TEST_DIR_PATH));
+    contents.push_back(hash_ds.GetDirectoryContent(TEST_DIR_PATH + "/d1"));
+    contents.push_back(hash_ds.GetDirectoryContent(TEST_DIR_PATH));
+    //fresh copies without hashes
+    auto bytes_contents = contents;
+    for (auto& c : bytes_contents) {
+        for (auto& f : c) {
+            f = fl::File(f.GetFilePath());
+        }
+    }
+
+    for (std::size_t min_dirs : { 1, 2, 3 }) {
+        auto by_hash = hash_ds.GetDuplicatedClusters(contents, min_dirs);
+        auto by_bytes = bytes_ds.GetDuplicatedClusters(bytes_contents, min_dirs);
+        ASSERT_EQ(by_hash.size(), by_bytes.size());
+        for (std::size_t i = 0; i < by_hash.size(); ++i) {
+            EXPECT_EQ(by_hash[i].dirs_num, by_bytes[i].dirs_num);
+            ASSERT_EQ(by_hash[i].files.size(), by_bytes[i].files.size());
+            for (std::size_t k = 0; k < by_hash[i].files.size(); ++k) {
+                EXPECT_EQ(by_hash[i].files[k].file->GetFilePath(), by_bytes[i].files[k].file->GetFilePath());
+            }
+        }
+        for (const auto& cl : by_bytes) {
+            EXPECT_FALSE(cl.files.front().file->HasHashSum());
+        }
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "dir_index.h"
+#include "searcher.h"
+
+namespace fs = std::filesystem;
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+namespace {
+    std::string Root() {
+        auto root = fs::absolute(TEST_DIR_PATH).lexically_normal().string();
+        if (root.size() > 1 && root.back() == '/') {
+            root.pop_back();
+        }
+        return root;
+    }
+
+    std::string WriteSnapshot(fl::DupsSearcher& ds, const std::string& name) {
+        const auto path = (fs::temp_directory_path() / name).string();
+        auto content = ds.GetDirectoryContent(Root());
+        ds.CalcAllHashSums(content);
+        EXPECT_TRUE(fl::DirIndex::Write(path, Root(), content));
+        return path;
+    }
+
+    //clusters as sorted lists of "input:path"
+    std::vector<std::vector<std::string>> Normalize(const std::vector<fl::DupsSearcher::DupsCluster>& clusters) {
+        std::vector<std::vector<std::string>> res;
+        for (const auto& c : clusters) {
+            std::vector<std::string> files;
+            for (const auto& f : c.files) {
+                files.push_back(std::to_string(f.dir_idx) + ":" + f.file->GetFilePath());
+            }
+            std::sort(files.begin(), files.end());
+            res.push_back(std::move(files));
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+}
+
+//snapshot keeps every file of directory sorted by size with the same hashes
+TEST(DirIndex, WriteAndLoad)
+{
+    fl::DupsSearcher ds;
+    ds.SetRecursive(true);
+    const auto path = WriteSnapshot(ds, "dups_dir_index_test.idx");
+
+    EXPECT_TRUE(fl::DirIndex::IsSnapshot(path));
+    EXPECT_FALSE(fl::DirIndex::IsSnapshot(TEST_DIR_PATH + "/f1"));
+
+    fl::DirIndex index;
+    ASSERT_TRUE(index.Load(path));
+    EXPECT_EQ(index.GetRoot(), Root());
+    EXPECT_EQ(index.GetHashKind(), fl::File::GetHashKind());
+    EXPECT_EQ(index.GetSampleSize(), fl::File::GetSampleSize());
+    EXPECT_EQ(index.Size(), 8);
+
+    const std::vector<std::uint64_t> sizes{ 0, 24, 39, 60 };
+    EXPECT_EQ(index.Sizes(), sizes);
+    const auto range = index.EqualRange(39);
+    EXPECT_EQ(range.second - range.first, 4);
+    EXPECT_EQ(index.EqualRange(40).first, index.EqualRange(40).second);
+
+    //files of snapshot have hashes of live files without reading
+    auto live = ds.GetDirectoryContent(Root());
+    const auto files = index.GetFiles({ { 0, index.Size() } });
+    ASSERT_EQ(files.size(), live.size());
+    for (const auto& f : files) {
+        auto it = std::find_if(live.begin(), live.end(), [&f](const fl::File& l) {
+            return l.GetFilePath() == f.GetFilePath();
+        });
+        ASSERT_NE(it, live.end()) << f.GetFilePath();
+        EXPECT_TRUE(f.HasHashSum());
+        EXPECT_EQ(f.GetHashSum(), it->GetHashSum());
+        EXPECT_EQ(f.GetSampleHashSum(), it->GetSampleHashSum());
+    }
+
+    fs::remove(path);
+}
+
+//snapshot joined with live directory gives the same clusters as two live directories
+TEST(DirIndex, JoinSnapshots)
+{
+    fl::DupsSearcher ds;
+    ds.SetRecursive(true);
+    const auto path = WriteSnapshot(ds, "dups_dir_index_join.idx");
+
+    std::vector<std::vector<fl::File>> live{ ds.GetDirectoryContent(Root()), ds.GetDirectoryContent(Root()) };
+    const auto expected = Normalize(ds.GetDuplicatedClusters(live, 2));
+    ASSERT_FALSE(expected.empty());
+
+    std::vector<fl::SearchInput> inputs(2);
+    inputs[0].index = std::make_unique<fl::DirIndex>();
+    ASSERT_TRUE(inputs[0].index->Load(path));
+    inputs[1].content = ds.GetDirectoryContent(Root());
+    fl::JoinSnapshots(inputs, 2);
+    //empty files have no pair of size in other input only when both are empty
+    EXPECT_LE(inputs[0].content.size(), 8);
+
+    std::vector<std::vector<fl::File>> joined{ std::move(inputs[0].content), std::move(inputs[1].content) };
+    EXPECT_EQ(Normalize(ds.GetDuplicatedClusters(joined, 2)), expected);
+
+    fs::remove(path);
+}
+
+//damaged or truncated snapshot is not loaded
+TEST(DirIndex, Damaged)
+{
+    fl::DupsSearcher ds;
+    const auto path = WriteSnapshot(ds, "dups_dir_index_damaged.idx");
+    const auto size = fs::file_size(path);
+
+    fs::resize_file(path, size - 1);
+    fl::DirIndex index;
+    EXPECT_FALSE(index.Load(path));
+    EXPECT_FALSE(index.IsLoaded());
+    EXPECT_EQ(index.Size(), 0);
+    EXPECT_EQ(index.EqualRange(39).first, index.EqualRange(39).second);
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "DUPSIDX1 but not really";
+    }
+    EXPECT_TRUE(fl::DirIndex::IsSnapshot(path));
+    EXPECT_FALSE(index.Load(path));
+
+    EXPECT_FALSE(index.Load(TEST_DIR_PATH + "/no_such_file"));
+    fs::remove(path);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,159 @@
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#include "gtest/gtest.h"
+#include "extent_map.h"
+#include "searcher.h"
+#include "stats.h"
+
+namespace fs = std::filesystem;
+
+//reflink test needs temporary directory on file system which has them (btrfs, xfs), it is skipped on others
+class ExtentMapTest : public testing::Test
+{
+protected:
+    static constexpr std::size_t FILE_SIZE = 4 * 1024 * 1024;
+
+    void SetUp() override {
+        m_root = fs::temp_directory_path() / "dups_extent_map_test";
+        fs::remove_all(m_root);
+        fs::create_directories(m_root / "a");
+        fs::create_directories(m_root / "b");
+        m_options = fl::File::GetReadOptions();
+    }
+
+    void TearDown() override {
+        fl::File::SetReadOptions(m_options);
+        fs::remove_all(m_root);
+    }
+
+    //file of FILE_SIZE bytes with data at offset 1 MiB and at the end, holes around it if sparse
+    std::string Put(const std::string& name, bool sparse) {
+        const auto path = (m_root / name).string();
+        const std::string data(64 * 1024, 'x');
+        std::fstream out(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!sparse) {
+            out << std::string(FILE_SIZE, '\0');
+        }
+        out.seekp(1024 * 1024);
+        out << data;
+        out.seekp(FILE_SIZE - data.size());
+        out << data;
+        return path;
+    }
+
+    //reflink copy, false if file system can't do it
+    static bool Clone(const std::string& from, const std::string& to) {
+        const int src = ::open(from.c_str(), O_RDONLY);
+        const int dst = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        const bool ok = src >= 0 && dst >= 0 && ::ioctl(dst, FICLONE, src) == 0;
+        ::close(src);
+        ::close(dst);
+        return ok;
+    }
+
+    fs::path            m_root;
+    fl::ReadOptions     m_options;
+};
+
+//holes are hashed as zeros: the same hash as of dense file with the same content, by all ways of reading
+TEST_F(ExtentMapTest, SparseHash)
+{
+    const auto dense = Put("a/dense", false);
+    const auto sparse = Put("a/sparse", true);
+    ASSERT_LT(fs::file_size(sparse), FILE_SIZE + 1);
+
+    for (auto cache : { fl::CacheMode::Keep, fl::CacheMode::Direct }) {
+        for (std::uint64_t mmap_threshold : { 0, 1 }) {
+            fl::ReadOptions options;
+            options.cache = cache;
+            options.mmap_threshold = mmap_threshold;
+            options.buffer_size = 256 * 1024;
+            fl::File::SetReadOptions(options);
+
+            const fl::File d(dense);
+            const fl::File s(sparse);
+            const auto holes = fl::Stats::Get(fl::Stats::Counter::HoleBytes);
+            EXPECT_EQ(s.GetHashSum(), d.GetHashSum());
+            EXPECT_EQ(s.GetSampleHashSum(), d.GetSampleHashSum());
+            EXPECT_TRUE(s.IsOk());
+            //ext4 and tmpfs report holes, other file systems may read them
+            EXPECT_GT(fl::Stats::Get(fl::Stats::Counter::HoleBytes) - holes, FILE_SIZE / 2);
+        }
+    }
+
+    //holes are read when extents are not asked
+    fl::ReadOptions options;
+    options.extents = false;
+    fl::File::SetReadOptions(options);
+    const auto holes = fl::Stats::Get(fl::Stats::Counter::HoleBytes);
+    EXPECT_EQ(fl::File(sparse).GetHashSum(), fl::File(dense).GetHashSum());
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::HoleBytes), holes);
+}
+
+//plain copies have own extents, so they are hashed as usual
+TEST_F(ExtentMapTest, NotShared)
+{
+    const auto a = Put("a/f", false);
+    const auto b = Put("b/f", false);
+    EXPECT_TRUE(fl::SharedExtentsKey(a).empty());
+    EXPECT_TRUE(fl::SharedExtentsKey((m_root / "no_such_file").string()).empty());
+
+    fl::DupsSearcher ds;
+    const auto clusters = ds.GetDuplicatedClusters({ ds.GetDirectoryContent((m_root / "a").string()),
+                                                     ds.GetDirectoryContent((m_root / "b").string()) }, 2);
+    ASSERT_EQ(clusters.size(), 1);
+    EXPECT_FALSE(clusters.front().shared);
+    EXPECT_TRUE(clusters.front().files.front().file->HasHashSum());
+}
+
+//reflinks are reported as already deduplicated without reading, a plain copy joins them by hash of one of them
+TEST_F(ExtentMapTest, Shared)
+{
+    const auto a = Put("a/f", false);
+    const auto b = (m_root / "b/f").string();
+    if (!Clone(a, b)) {
+        GTEST_SKIP() << "file system has no reflinks";
+    }
+    EXPECT_FALSE(fl::SharedExtentsKey(a).empty());
+    EXPECT_EQ(fl::SharedExtentsKey(a), fl::SharedExtentsKey(b));
+
+    fl::DupsSearcher ds;
+    auto search = [&]() {
+        return ds.GetDuplicatedClusters({ ds.GetDirectoryContent((m_root / "a").string()),
+                                          ds.GetDirectoryContent((m_root / "b").string()) }, 2);
+    };
+    auto read = fl::Stats::Get(fl::Stats::Counter::BytesRead);
+    auto clusters = search();
+    ASSERT_EQ(clusters.size(), 1);
+    EXPECT_TRUE(clusters.front().shared);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::BytesRead), read);
+
+    //changed clone is not shared even before its dirty pages are written back
+    const auto c = (m_root / "c").string();
+    ASSERT_TRUE(Clone(a, c));
+    {
+        std::fstream out(c, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(1024 * 1024);
+        out << 'y';
+    }
+    EXPECT_NE(fl::SharedExtentsKey(c), fl::SharedExtentsKey(a));
+    fs::remove(c);
+
+    Put("b/g", false);
+    read = fl::Stats::Get(fl::Stats::Counter::BytesRead);
+    clusters = search();
+    ASSERT_EQ(clusters.size(), 1);
+    EXPECT_EQ(clusters.front().files.size(), 3);
+    EXPECT_FALSE(clusters.front().shared);
+    EXPECT_LT(fl::Stats::Get(fl::Stats::Counter::BytesRead) - read, 3 * FILE_SIZE);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <filesystem>
+
+#include "gtest/gtest.h"
+#include "external_searcher.h"
+#include "stats.h"
+#include "temp_tree.h"
+
+namespace fs = std::filesystem;
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+//three trees with many files of few sizes: every file of "a" has copies in "b", every third one in "c" too,
+//files of the same size differ in the first or the last byte
+class ExternalSearcherTest : public testing::Test
+{
+protected:
+    static constexpr std::size_t FILES_NUM = 1500;
+
+    void SetUp() override {
+        for (std::size_t i = 0; i < FILES_NUM; ++i) {
+            std::string content(100 + i % 37 * 50, 'x');
+            content.front() = static_cast<char>('a' + i % 26);
+            content.back() = static_cast<char>('a' + i / 26 % 26);
+            m_tree.Put("a/" + std::to_string(i % 10) + "/f" + std::to_string(i), content);
+            m_tree.Put("b/" + std::to_string(i % 7) + "/g" + std::to_string(i), content);
+            if (i % 3 == 0) {
+                m_tree.Put("c/h" + std::to_string(i), content);
+            }
+        }
+    }
+
+    std::vector<std::string> Dirs() const {
+        return { m_tree.Path("a"), m_tree.Path("b"), m_tree.Path("c") };
+    }
+
+    using Result = std::vector<std::vector<std::string>>;
+
+    //clusters as sorted lists of "input:path"
+    static void Add(Result& res, const fl::DupsSearcher::DupsCluster& cl) {
+        std::vector<std::string> files;
+        for (const auto& f : cl.files) {
+            files.push_back(std::to_string(f.dir_idx) + ":" + f.file->GetFilePath());
+        }
+        std::sort(files.begin(), files.end());
+        res.push_back(std::move(files));
+    }
+
+    Result InMemory(fl::DupsSearcher& ds, std::size_t min_dirs) const {
+        std::vector<std::vector<fl::File>> contents;
+        for (const auto& d : Dirs()) {
+            contents.push_back(ds.GetDirectoryContent(d));
+        }
+        Result res;
+        ds.GetDuplicatedClusters(contents, min_dirs, [&res](const fl::DupsSearcher::DupsCluster& cl) { Add(res, cl); });
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    Result External(fl::ExternalSearcher& es, std::size_t min_dirs) const {
+        Result res;
+        es.GetDuplicatedClusters(Dirs(), min_dirs, [&res](const fl::DupsSearcher::DupsCluster& cl) { Add(res, cl); });
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    TempTree    m_tree{ "dups_external_searcher_test" };
+};
+
+//tiny budget gives many runs merged by several passes, result is the same as of search in memory
+TEST_F(ExternalSearcherTest, SameAsInMemory)
+{
+    for (std::size_t jobs : { 1, 4 }) {
+        fl::DupsSearcher ds(jobs);
+        ds.SetRecursive(true);
+        fl::ExternalSearcher es(ds, 0, m_tree.Root().string());
+
+        for (std::size_t min_dirs : { 1, 2, 3 }) {
+            const auto expected = InMemory(ds, min_dirs);
+            ASSERT_FALSE(expected.empty());
+            const auto spilled = fl::Stats::Get(fl::Stats::Counter::SpilledBytes);
+            EXPECT_EQ(External(es, min_dirs), expected) << "jobs " << jobs << ", min dirs " << min_dirs;
+
+            //one record per file, runs of 512 records are merged by pairs until two of them are left
+            const auto scan_runs = (FILES_NUM * 2 + FILES_NUM / 3 + 511) / 512;
+            EXPECT_EQ(es.GetRunsNum(), scan_runs * 2 - 2);
+            EXPECT_GT(fl::Stats::Get(fl::Stats::Counter::SpilledBytes) - spilled, 64 * FILES_NUM * 2);
+        }
+    }
+
+    //temporary files have no names
+    std::size_t entries = 0;
+    for (const auto& e : fs::directory_iterator(m_tree.Root())) {
+        EXPECT_TRUE(e.is_directory()) << e.path();
+        ++entries;
+    }
+    EXPECT_EQ(entries, 3);
+}
+
+//big budget: one run, one batch
+TEST_F(ExternalSearcherTest, OneRun)
+{
+    fl::DupsSearcher ds;
+    ds.SetRecursive(true);
+    fl::ExternalSearcher es(ds, 64 << 20, "");
+    EXPECT_EQ(External(es, 2), InMemory(ds, 2));
+    EXPECT_EQ(es.GetRunsNum(), 1);
+}
+
+TEST_F(ExternalSearcherTest, Errors)
+{
+    fl::DupsSearcher ds;
+    auto ignore = [](const fl::DupsSearcher::DupsCluster&) {};
+    fl::ExternalSearcher es(ds, 1 << 20, "");
+    EXPECT_THROW(es.GetDuplicatedClusters({ TEST_DIR_PATH, TEST_DIR_PATH + "/no_such_dir" }, 2, ignore),
+                 fs::filesystem_error);
+
+    fl::ExternalSearcher wrong_spill(ds, 1 << 20, m_tree.Path("no_such_dir"));
+    EXPECT_THROW(wrong_spill.GetDuplicatedClusters({ TEST_DIR_PATH, TEST_DIR_PATH }, 2, ignore), std::system_error);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
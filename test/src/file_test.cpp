@@ -1,5 +1,12 @@
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
 #include "gtest/gtest.h"
 #include "file.h"
+#include "stats.h"
 
 const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
 
@@ -57,6 +64,80 @@ TEST(File, LinkConstructor)
     EXPECT_FALSE(f.GetHashSum().empty());
 }
 
+TEST(File, StampConstructor)
+{
+    fl::FileStamp stamp;
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/f1", stamp));
+
+    //attributes are taken from stamp, file system is not touched
+    fl::File f("no_such_file", stamp);
+    EXPECT_TRUE(f.IsOk());
+    EXPECT_EQ(f.GetFileSize(), stamp.size);
+    EXPECT_EQ(f.GetStamp().ino, stamp.ino);
+
+    fl::FileStamp dir_stamp;
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/d1", dir_stamp));
+    fl::File d(TEST_DIR_PATH + "/d1", dir_stamp);
+    EXPECT_FALSE(d.IsOk());
+    EXPECT_EQ(d.GetFileSize(), 0);
+}
+
+TEST(File, ComparisonSameInode)
+{
+    fl::FileStamp stamp;
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/f1", stamp));
+
+    //the same inode is the same file, content is not read
+    fl::File f("no_such_file", stamp);
+    fl::File f2("no_such_file_2", stamp);
+    EXPECT_TRUE(f == f2);
+    EXPECT_TRUE(f.GetStamp().SameFile(fl::File(TEST_DIR_PATH + "/f1").GetStamp()));
+}
+
+TEST(File, TakeHashesFrom)
+{
+    const auto file = (std::filesystem::temp_directory_path() / "dups_take_hashes_test").string();
+    const auto link_path = file + "_link";
+    std::filesystem::remove(link_path);
+    std::filesystem::remove(file);
+    std::filesystem::copy_file(TEST_DIR_PATH + "/f1", file);
+    std::filesystem::create_hard_link(file, link_path);
+    fl::File src(file);
+    ASSERT_FALSE(src.GetHashSum().empty());
+
+    fl::File link(link_path);
+    EXPECT_TRUE(link.TakeHashesFrom(src));
+    EXPECT_EQ(link.GetHashSum(), src.GetHashSum());
+    //not the same file
+    EXPECT_FALSE(fl::File(TEST_DIR_PATH + "/f1").TakeHashesFrom(src));
+
+    //old snapshot entry of changed file
+    auto stamp = src.GetStamp();
+    stamp.mtime_ns -= 1;
+    fl::File stale(file, stamp);
+    EXPECT_FALSE(stale.TakeHashesFrom(src));
+    EXPECT_FALSE(src.TakeHashesFrom(src));
+
+    std::filesystem::remove(link_path);
+    std::filesystem::remove(file);
+}
+
+TEST(File, PathPool)
+{
+    auto pool = std::make_shared<fl::PathPool>(TEST_DIR_PATH + "/");
+    auto off = pool->Add("f1", 2);
+    std::shared_ptr<const fl::PathPool> names = pool;
+
+    fl::File f(fl::PathRef(names, off, 2), fl::FileStamp{});
+    EXPECT_EQ(f.GetFilePath(), TEST_DIR_PATH + "/f1");
+    EXPECT_EQ(fl::PathRef().GetPath(), "");
+
+    //offsets are 32 bit: name beyond 4 GiB is refused instead of wrapping
+    EXPECT_TRUE(pool->CanAdd(fl::PathPool::MaxSize - 2));
+    EXPECT_FALSE(pool->CanAdd(fl::PathPool::MaxSize - 1));
+    EXPECT_THROW(pool->Add("f1", fl::PathPool::MaxSize), std::length_error);
+}
+
 TEST(File, CopyConstructor)
 {
     const auto file = TEST_DIR_PATH + "/f1";
@@ -167,6 +248,183 @@ TEST(File, ComparisonDirAndFileInDir)
     EXPECT_TRUE(f == f2);
 }
 
+TEST(File, SampleHashSmallFile)
+{
+    fl::File f(TEST_DIR_PATH + "/f1");
+
+    //small file is covered by sample entirely
+    EXPECT_FALSE(f.GetSampleHashSum().empty());
+    EXPECT_EQ(f.GetSampleHashSum(), f.GetHashSum());
+}
+
+TEST(File, SampleHashHeadAndTail)
+{
+    const auto old_size = fl::File::GetSampleSize();
+    fl::File::SetSampleSize(16);
+
+    fl::File f1(TEST_DIR_PATH + "/samples/mid_a");
+    fl::File f2(TEST_DIR_PATH + "/samples/mid_b");
+
+    //head and tail are the same, middle is different
+    EXPECT_EQ(f1.GetSampleHashSum(), f2.GetSampleHashSum());
+    EXPECT_NE(f1.GetSampleHashSum(), f1.GetHashSum());
+    EXPECT_FALSE(f1 == f2);
+
+    fl::File::SetSampleSize(old_size);
+}
+
+TEST(File, ReadOptions)
+{
+    const auto file = TEST_DIR_PATH + "/samples/mid_a";
+    const auto old_options = fl::File::GetReadOptions();
+    const auto hash = fl::File(file).GetHashSum();
+
+    //tiny buffer
+    fl::ReadOptions options;
+    options.buffer_size = 7;
+    fl::File::SetReadOptions(options);
+    EXPECT_EQ(fl::File(file).GetHashSum(), hash);
+
+    //mapped into memory
+    options.mmap_threshold = 1;
+    fl::File::SetReadOptions(options);
+    EXPECT_EQ(fl::File(file).GetHashSum(), hash);
+
+    fl::File::SetReadOptions(old_options);
+}
+
+namespace {
+    //number of pages of file which are in page cache
+    std::size_t ResidentPages(const std::string& path, std::size_t size) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::vector<unsigned char> pages((size + page - 1) / page);
+        ::mincore(addr, size, pages.data());
+        ::munmap(addr, size);
+        ::close(fd);
+        std::size_t n = 0;
+        for (auto p : pages) {
+            n += p & 1;
+        }
+        return n;
+    }
+}
+
+TEST(File, PageCacheModes)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "dups_page_cache_test").string();
+    constexpr std::size_t SIZE = 300 * 1000 + 123;
+    std::string content(SIZE, '\0');
+    for (std::size_t i = 0; i < SIZE; ++i) {
+        content[i] = static_cast<char>(i * 13 % 253);
+    }
+    std::ofstream(path, std::ios::binary) << content;
+
+    const auto old_options = fl::File::GetReadOptions();
+    const auto hash = fl::File(path).GetHashSum();
+    const auto sample = fl::File(path).GetSampleHashSum();
+
+    fl::ReadOptions options;
+    options.buffer_size = 8192;
+    for (auto mode : { fl::CacheMode::Keep, fl::CacheMode::Drop, fl::CacheMode::Direct }) {
+        for (bool advise : { true, false }) {
+            options.cache = mode;
+            options.advise = advise;
+            fl::File::SetReadOptions(options);
+            EXPECT_EQ(fl::File(path).GetHashSum(), hash);
+            EXPECT_EQ(fl::File(path).GetSampleHashSum(), sample);
+        }
+    }
+
+    //cache touched by reading is counted in every mode, only Drop evicts
+    for (auto mode : { fl::CacheMode::Keep, fl::CacheMode::Direct }) {
+        options.cache = mode;
+        fl::File::SetReadOptions(options);
+        fl::Stats::Reset();
+        EXPECT_EQ(fl::File(path).GetHashSum(), hash);
+        EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::CacheResident) + fl::Stats::Get(fl::Stats::Counter::CacheMissed), SIZE);
+        EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::CacheDropped), 0);
+    }
+
+    //pages cached before reading stay in cache
+    options.cache = fl::CacheMode::Drop;
+    options.advise = true;
+    fl::File::SetReadOptions(options);
+    const auto resident = ResidentPages(path, SIZE);
+    fl::Stats::Reset();
+    EXPECT_EQ(fl::File(path).GetHashSum(), hash);
+    EXPECT_EQ(ResidentPages(path, SIZE), resident);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::CacheResident) + fl::Stats::Get(fl::Stats::Counter::CacheMissed), SIZE);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::CacheDropped), fl::Stats::Get(fl::Stats::Counter::CacheMissed));
+
+    //pages read into cache are evicted after hashing
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+    if (ResidentPages(path, SIZE) == 0) {
+        fl::Stats::Reset();
+        EXPECT_EQ(fl::File(path).GetHashSum(), hash);
+        EXPECT_EQ(ResidentPages(path, SIZE), 0);
+        EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::CacheDropped), SIZE);
+        EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::CacheResident), 0);
+    }
+
+    fl::File::SetReadOptions(old_options);
+    std::filesystem::remove(path);
+}
+
+//file truncated while it is mapped gives short read instead of SIGBUS
+TEST(File, TruncatedWhileMapped)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "dups_truncated_map_test").string();
+    std::ofstream(path, std::ios::binary) << std::string(64 * 1024, 'x');
+
+    fl::ReadOptions options;
+    options.buffer_size = 4096;
+    options.mmap_threshold = 1;
+    fl::FileReader reader(path, options);
+    ASSERT_TRUE(reader.IsOpen());
+    std::uint64_t consumed = 0;
+    const auto got = reader.Read(0, fl::FileReader::ToEnd, [&](const char*, std::size_t size) {
+        if (consumed == 0) {
+            ASSERT_EQ(::truncate(path.c_str(), 10000), 0);
+        }
+        consumed += size;
+    });
+    EXPECT_EQ(got, 10000);
+    EXPECT_EQ(consumed, 10000);
+    std::filesystem::remove(path);
+}
+
+//file truncated while mapped buffer is consumed: SIGBUS is caught and gives short read
+TEST(File, TruncatedWhileConsumed)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "dups_truncated_consumed_test").string();
+    std::ofstream(path, std::ios::binary) << std::string(64 * 1024, 'x');
+
+    fl::ReadOptions options;
+    options.buffer_size = 16 * 1024;
+    options.mmap_threshold = 1;
+    for (int i = 0; i < 2; ++i) {
+        std::ofstream(path, std::ios::binary) << std::string(64 * 1024, 'x');
+        fl::FileReader reader(path, options);
+        ASSERT_TRUE(reader.IsOpen());
+        std::uint64_t consumed = 0;
+        bool truncated = false;
+        const auto got = reader.Read(0, fl::FileReader::ToEnd, [&](const char* data, std::size_t size) {
+            truncated = ::truncate(path.c_str(), 0) == 0;
+            volatile char last = data[size - 1];
+            (void)last;
+            consumed += size;
+        });
+        EXPECT_TRUE(truncated);
+        EXPECT_EQ(got, 0);
+        EXPECT_EQ(consumed, 0);
+    }
+    std::filesystem::remove(path);
+}
 
 int main(int argc, char **argv)
 {
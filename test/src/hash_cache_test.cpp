@@ -0,0 +1,172 @@
+#include <filesystem>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "hash_cache.h"
+#include "file.h"
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+static fl::Digest MakeDigest(const std::string& str)
+{
+    return fl::Digest(str.data(), str.size());
+}
+
+static std::string TempPath(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TEST(HashCache, FindAndPut)
+{
+    fl::HashCache cache(fl::HashKind::XXH3, 4096);
+    fl::FileStamp stamp;
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/f1", stamp));
+
+    fl::Digest hash;
+    EXPECT_FALSE(cache.FindHash(stamp, hash));
+
+    cache.PutHash(stamp, MakeDigest("abc"));
+    EXPECT_TRUE(cache.FindHash(stamp, hash));
+    EXPECT_EQ(hash, MakeDigest("abc"));
+    EXPECT_FALSE(cache.FindSampleHash(stamp, hash));
+
+    //changed file
+    auto changed = stamp;
+    changed.mtime_ns += 1;
+    EXPECT_FALSE(cache.FindHash(changed, hash));
+}
+
+TEST(HashCache, SaveAndLoad)
+{
+    const auto path = TempPath("dups_hash_cache_test");
+    std::filesystem::remove(path);
+
+    fl::FileStamp stamp;
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/f1", stamp));
+    {
+        fl::HashCache cache(fl::HashKind::XXH3, 4096);
+        EXPECT_FALSE(cache.Load(path));
+        cache.PutHash(stamp, MakeDigest("0123"));
+        cache.PutSampleHash(stamp, MakeDigest("4567"));
+        EXPECT_TRUE(cache.Save(path));
+    }
+
+    fl::HashCache cache(fl::HashKind::XXH3, 4096);
+    EXPECT_TRUE(cache.Load(path));
+    EXPECT_EQ(cache.Size(), 1);
+    fl::Digest hash;
+    EXPECT_TRUE(cache.FindHash(stamp, hash));
+    EXPECT_EQ(hash, MakeDigest("0123"));
+    EXPECT_TRUE(cache.FindSampleHash(stamp, hash));
+    EXPECT_EQ(hash, MakeDigest("4567"));
+
+    //other settings - cache is not applicable
+    fl::HashCache other(fl::HashKind::MD5, 4096);
+    EXPECT_FALSE(other.Load(path));
+    EXPECT_EQ(other.Size(), 0);
+
+    std::filesystem::remove(path);
+}
+
+TEST(HashCache, DamagedFile)
+{
+    const auto path = TempPath("dups_hash_cache_damaged");
+    {
+        std::ofstream ofs(path, std::ios_base::binary);
+        ofs << "DUPSHCHE garbage";
+    }
+
+    fl::HashCache cache(fl::HashKind::XXH3, 4096);
+    EXPECT_FALSE(cache.Load(path));
+    EXPECT_EQ(cache.Size(), 0);
+
+    std::filesystem::remove(path);
+}
+
+//valid header with huge number of entries is not allocated for
+TEST(HashCache, DamagedCount)
+{
+    const auto path = TempPath("dups_hash_cache_damaged_count");
+    fl::FileStamp stamp;
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/f1", stamp));
+    {
+        fl::HashCache cache(fl::HashKind::XXH3, 4096);
+        cache.PutHash(stamp, MakeDigest("0123"));
+        ASSERT_TRUE(cache.Save(path));
+    }
+    {
+        //count follows magic, version, kind, sample size and generation
+        std::fstream fs(path, std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+        const std::uint64_t count = 0x0fffffffffffffffULL;
+        fs.seekp(8 + 4 + 4 + 8 + 4);
+        fs.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+
+    fl::HashCache cache(fl::HashKind::XXH3, 4096);
+    EXPECT_FALSE(cache.Load(path));
+    EXPECT_EQ(cache.Size(), 0);
+
+    std::filesystem::remove(path);
+}
+
+//entries not used by the last runs are not saved
+TEST(HashCache, Aging)
+{
+    const auto path = TempPath("dups_hash_cache_aging");
+    std::filesystem::remove(path);
+    fl::FileStamp used;
+    fl::FileStamp unused;
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/f1", used));
+    ASSERT_TRUE(fl::FileStamp::Get(TEST_DIR_PATH + "/f2", unused));
+    ASSERT_NE(used.GetId(), unused.GetId());
+    {
+        fl::HashCache cache(fl::HashKind::XXH3, 4096);
+        cache.PutHash(used, MakeDigest("used"));
+        cache.PutHash(unused, MakeDigest("unused"));
+        ASSERT_TRUE(cache.Save(path));
+    }
+
+    //the first run without use keeps entry, the second one drops it
+    fl::Digest hash;
+    for (std::size_t expected : { 2, 2, 1 }) {
+        fl::HashCache cache(fl::HashKind::XXH3, 4096);
+        cache.SetMaxAge(2);
+        ASSERT_TRUE(cache.Load(path));
+        EXPECT_EQ(cache.Size(), expected);
+        EXPECT_TRUE(cache.FindHash(used, hash));
+        ASSERT_TRUE(cache.Save(path));
+    }
+    fl::HashCache cache(fl::HashKind::XXH3, 4096);
+    ASSERT_TRUE(cache.Load(path));
+    EXPECT_TRUE(cache.FindHash(used, hash));
+    EXPECT_FALSE(cache.FindHash(unused, hash));
+
+    std::filesystem::remove(path);
+}
+
+TEST(HashCache, UsedByFile)
+{
+    fl::HashCache cache(fl::File::GetHashKind(), fl::File::GetSampleSize());
+    fl::File::SetHashCache(&cache);
+
+    const auto file = TEST_DIR_PATH + "/f1";
+    const auto hash = fl::File(file).GetHashSum();
+    EXPECT_EQ(cache.Size(), 1);
+
+    //the next object takes fake value from cache without reading
+    fl::FileStamp stamp;
+    ASSERT_TRUE(fl::FileStamp::Get(file, stamp));
+    cache.PutHash(stamp, MakeDigest("cached"));
+    EXPECT_EQ(fl::File(file).GetHashSum(), MakeDigest("cached"));
+
+    fl::File::SetHashCache(nullptr);
+    EXPECT_EQ(fl::File(file).GetHashSum(), hash);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
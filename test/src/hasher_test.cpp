@@ -0,0 +1,100 @@
+#include <algorithm>
+
+#include "gtest/gtest.h"
+#include "hasher.h"
+
+static std::string Hash(fl::HashKind kind, const std::string& data)
+{
+    auto hasher = fl::Hasher::Create(kind);
+    hasher->Add(data.data(), data.size());
+    return hasher->GetHash().ToHex();
+}
+
+//feed data by small uneven portions
+static std::string HashByParts(fl::HashKind kind, const std::string& data)
+{
+    auto hasher = fl::Hasher::Create(kind);
+    std::size_t pos = 0;
+    for (std::size_t part = 1; pos < data.size(); part = part * 3 + 1) {
+        auto n = std::min(part, data.size() - pos);
+        hasher->Add(data.data() + pos, n);
+        pos += n;
+    }
+    return hasher->GetHash().ToHex();
+}
+
+static std::string Alphabet(std::size_t size)
+{
+    std::string data(size, 'a');
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    return data;
+}
+
+TEST(Hasher, KnownValues)
+{
+    EXPECT_EQ(Hash(fl::HashKind::MD5, "abc"), "900150983cd24fb0d6963f7d28e17f72");
+    EXPECT_EQ(Hash(fl::HashKind::SHA256, "abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_EQ(Hash(fl::HashKind::XXH3, "abc"), "06b05ab6733a618578af5f94892f3950");
+
+    EXPECT_EQ(Hash(fl::HashKind::MD5, ""), "d41d8cd98f00b204e9800998ecf8427e");
+    EXPECT_EQ(Hash(fl::HashKind::SHA256, ""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    EXPECT_EQ(Hash(fl::HashKind::XXH3, ""), "99aa06d3014798d86001c324468d497f");
+}
+
+TEST(Hasher, LongData)
+{
+    EXPECT_EQ(Hash(fl::HashKind::SHA256, std::string(1000000, 'a')),
+              "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    EXPECT_EQ(Hash(fl::HashKind::XXH3, Alphabet(1000000)), "76238a5511d6dbb5c117d8051e77a70d");
+}
+
+TEST(Hasher, Streaming)
+{
+    const auto data = Alphabet(100000);
+    for (auto kind : { fl::HashKind::XXH3, fl::HashKind::MD5, fl::HashKind::SHA256 }) {
+        EXPECT_EQ(Hash(kind, data), HashByParts(kind, data)) << fl::HashKindName(kind);
+    }
+}
+
+TEST(Hasher, Reset)
+{
+    auto hasher = fl::Hasher::Create(fl::HashKind::XXH3);
+    hasher->Add("garbage", 7);
+    hasher->Reset();
+    hasher->Add("abc", 3);
+    EXPECT_EQ(hasher->GetHash().ToHex(), Hash(fl::HashKind::XXH3, "abc"));
+}
+
+TEST(Hasher, Digest)
+{
+    auto hasher = fl::Hasher::Create(fl::HashKind::SHA256);
+    auto d = hasher->GetHash();
+    EXPECT_EQ(d.size, 32);
+    EXPECT_FALSE(d.empty());
+    EXPECT_TRUE(fl::Digest().empty());
+
+    auto md5 = fl::Hasher::Create(fl::HashKind::MD5)->GetHash();
+    EXPECT_EQ(md5.size, 16);
+    EXPECT_NE(md5, d);
+    EXPECT_EQ(md5, fl::Digest(md5.bytes.data(), md5.size));
+}
+
+TEST(Hasher, Names)
+{
+    fl::HashKind kind = fl::HashKind::XXH3;
+    EXPECT_TRUE(fl::ParseHashKind("sha256", kind));
+    EXPECT_EQ(kind, fl::HashKind::SHA256);
+    EXPECT_TRUE(fl::ParseHashKind("md5", kind));
+    EXPECT_EQ(kind, fl::HashKind::MD5);
+    EXPECT_FALSE(fl::ParseHashKind("crc32", kind));
+    EXPECT_EQ(kind, fl::HashKind::MD5);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
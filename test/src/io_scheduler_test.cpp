@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <sys/mman.h>
+#include <linux/fiemap.h>
+
+#include "gtest/gtest.h"
+#include "io_scheduler.h"
+#include "stats.h"
+#include "temp_tree.h"
+
+namespace {
+    std::uint64_t PhysicalOffset(const std::string& path) {
+        alignas(fiemap) char buf[sizeof(fiemap) + sizeof(fiemap_extent)] = {};
+        auto* map = static_cast<fiemap*>(static_cast<void*>(buf));
+        map->fm_length = FIEMAP_MAX_OFFSET;
+        map->fm_extent_count = 1;
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        const bool ok = fd >= 0 && ::ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents != 0;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return ok ? map->fm_extents[0].fe_physical : UINT64_MAX;
+    }
+
+    //write file to disk and evict it from page cache, true if none of its pages is left there (mincore)
+    bool Evict(const std::string& path, std::size_t size) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::vector<unsigned char> pages((size + page - 1) / page);
+        const bool evicted = ::mincore(addr, size, pages.data()) == 0 &&
+            std::none_of(pages.begin(), pages.end(), [](unsigned char p) { return (p & 1) != 0; });
+        ::munmap(addr, size);
+        return evicted;
+    }
+}
+
+//files written in reverse order of names, so their names don't give order on disk
+class IoSchedulerTest : public testing::Test
+{
+protected:
+    static constexpr std::size_t FILES_NUM = 24;
+
+    void SetUp() override {
+        for (std::size_t i = FILES_NUM; i-- > 0;) {
+            m_tree.Put("f" + std::to_string(i), std::string(FILE_SIZE, static_cast<char>('a' + i)));
+        }
+        for (std::size_t i = 0; i < FILES_NUM; ++i) {
+            m_files.emplace_back(m_tree.Path("f" + std::to_string(i)));
+        }
+        for (const auto& f : m_files) {
+            m_ptrs.push_back(&f);
+        }
+        m_dev = m_files.front().GetStamp().dev;
+    }
+
+    std::size_t Index(const fl::File* f) const {
+        return static_cast<std::size_t>(f - m_files.data());
+    }
+
+    static constexpr std::size_t FILE_SIZE = 64 * 1024;
+
+    TempTree                        m_tree{ "dups_io_scheduler_test" };
+    std::vector<fl::File>           m_files;
+    std::vector<const fl::File*>    m_ptrs;
+    std::uint64_t                   m_dev{ 0 };
+};
+
+//rotational device: cached files first, then by physical offset, unknown offsets last
+TEST_F(IoSchedulerTest, Order)
+{
+    //every third file is cached, offsets are shuffled, the last one is unknown
+    std::vector<fl::IoScheduler::Placement> placements(FILES_NUM);
+    for (std::size_t i = 0; i < FILES_NUM; ++i) {
+        placements[i].resident = i % 3 == 0;
+        placements[i].physical = i + 1 == FILES_NUM ? UINT64_MAX : (i * 7 % FILES_NUM) * 4096;
+    }
+    fl::IoScheduler scheduler(fl::ReadOptions{}, [this, &placements](const fl::File& f) {
+        return placements[Index(&f)];
+    });
+
+    fl::IoScheduler::SetRotational(m_dev, true);
+    const auto resident = fl::Stats::Get(fl::Stats::Counter::ResidentFirst);
+    const auto seek = fl::Stats::Get(fl::Stats::Counter::SeekOrdered);
+    const auto ordered = scheduler.Order(m_ptrs);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::ResidentFirst) - resident, FILES_NUM / 3);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::SeekOrdered) - seek, FILES_NUM - FILES_NUM / 3);
+
+    std::vector<const fl::File*> expected;
+    for (bool cached : { true, false }) {
+        std::vector<const fl::File*> part;
+        for (std::size_t i = 0; i < FILES_NUM; ++i) {
+            if (placements[i].resident == cached) {
+                part.push_back(m_ptrs[i]);
+            }
+        }
+        std::sort(part.begin(), part.end(), [this, &placements](const fl::File* a, const fl::File* b) {
+            return placements[Index(a)].physical < placements[Index(b)].physical;
+        });
+        expected.insert(expected.end(), part.begin(), part.end());
+    }
+    EXPECT_EQ(ordered, expected);
+    EXPECT_EQ(ordered.back(), m_ptrs.back());
+
+    //probing by many threads gives the same order
+    EXPECT_EQ(scheduler.Order(m_ptrs, 4), expected);
+
+    //other devices keep order and are not probed
+    fl::IoScheduler::SetRotational(m_dev, false);
+    std::atomic<std::size_t> probes{ 0 };
+    fl::IoScheduler other(fl::ReadOptions{}, [&probes](const fl::File&) {
+        ++probes;
+        return fl::IoScheduler::Placement{};
+    });
+    EXPECT_EQ(other.Order(m_ptrs), m_ptrs);
+    EXPECT_EQ(probes, 0);
+}
+
+//real placement of files evicted from page cache on disk file system
+TEST(IoScheduler, DiskOrder)
+{
+    constexpr std::size_t FILES_NUM = 16;
+    constexpr std::size_t FILE_SIZE = 64 * 1024;
+    //page cache and extents are real only on disk file system, /tmp may be tmpfs
+    TempTree tree("dups_io_scheduler_test", "/var/tmp");
+    for (std::size_t i = FILES_NUM; i-- > 0;) {
+        tree.Put("f" + std::to_string(i), std::string(FILE_SIZE, static_cast<char>('a' + i)));
+    }
+    std::vector<fl::File> files;
+    for (std::size_t i = 0; i < FILES_NUM; ++i) {
+        files.emplace_back(tree.Path("f" + std::to_string(i)));
+        if (!Evict(files.back().GetFilePath(), FILE_SIZE)) {
+            GTEST_SKIP() << "eviction from page cache can't be confirmed";
+        }
+        if (PhysicalOffset(files.back().GetFilePath()) == UINT64_MAX) {
+            GTEST_SKIP() << "no FIEMAP";
+        }
+    }
+    std::vector<const fl::File*> ptrs;
+    for (const auto& f : files) {
+        ptrs.push_back(&f);
+    }
+
+    const auto dev = files.front().GetStamp().dev;
+    const bool rotational = fl::IoScheduler::IsRotational(dev);
+    fl::IoScheduler::SetRotational(dev, true);
+    const auto resident = fl::Stats::Get(fl::Stats::Counter::ResidentFirst);
+    const auto ordered = fl::IoScheduler(fl::ReadOptions{}).Order(ptrs);
+    fl::IoScheduler::SetRotational(dev, rotational);
+
+    auto sorted = ordered;
+    std::sort(sorted.begin(), sorted.end());
+    EXPECT_EQ(sorted, ptrs);
+    //probe by RWF_NOWAIT may start readahead of device, so files found in cache are only counted
+    const auto cached = fl::Stats::Get(fl::Stats::Counter::ResidentFirst) - resident;
+    for (std::size_t i = 1; i < ordered.size(); ++i) {
+        if (i != cached) {
+            EXPECT_LE(PhysicalOffset(ordered[i - 1]->GetFilePath()), PhysicalOffset(ordered[i]->GetFilePath()));
+        }
+    }
+}
+
+//unknown devices (tmpfs, overlay) are not rotational
+TEST(IoScheduler, Detection)
+{
+    EXPECT_FALSE(fl::IoScheduler::IsRotational(0));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "gtest/gtest.h"
+#include "live_index.h"
+#include "stats.h"
+#include "temp_tree.h"
+
+namespace fs = std::filesystem;
+
+//two watched directories "a" and "b" and directory "out" outside of them
+class LiveIndexTest : public testing::Test
+{
+protected:
+    void SetUp() override {
+        for (const auto* d : { "a", "b", "out" }) {
+            fs::create_directories(m_tree.Root() / d);
+        }
+        m_tree.Put("a/x", "same content");
+        m_tree.Put("b/x", "same content");
+        m_tree.Put("a/y", "other content");
+        m_searcher.SetRecursive(true);
+    }
+
+    //clusters as sorted lists of paths relative to root
+    std::vector<std::vector<std::string>> Clusters(fl::LiveIndex& index) const {
+        std::vector<std::vector<std::string>> res;
+        for (const auto& cl : index.Query(2)) {
+            std::vector<std::string> files;
+            for (const auto& f : cl.files) {
+                files.push_back(fs::path(f.file->GetFilePath()).lexically_relative(m_tree.Root()).string());
+            }
+            std::sort(files.begin(), files.end());
+            res.push_back(std::move(files));
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    using Result = std::vector<std::vector<std::string>>;
+
+    TempTree            m_tree{ "dups_live_index_test" };
+    fl::DupsSearcher    m_searcher;
+};
+
+//created, changed, moved and removed files are seen by the next query
+TEST_F(LiveIndexTest, FileChanges)
+{
+    fl::LiveIndex index(m_searcher, { m_tree.Path("a"), m_tree.Path("b") });
+    index.Build();
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "b/x" } }));
+
+    m_tree.Put("b/y", "other content");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "b/x" }, { "a/y", "b/y" } }));
+
+    //only the changed file is hashed again
+    const auto hashes = fl::Stats::Get(fl::Stats::Counter::FullHashes);
+    m_tree.Put("b/x", "same_content");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/y", "b/y" } }));
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::FullHashes) - hashes, 1);
+
+    fs::rename(m_tree.Root() / "b/y", m_tree.Root() / "out/y");
+    fs::rename(m_tree.Root() / "out/y", m_tree.Root() / "b/z");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/y", "b/z" } }));
+
+    fs::remove(m_tree.Root() / "a/y");
+    EXPECT_TRUE(Clusters(index).empty());
+    EXPECT_EQ(index.GetContents()[0].size(), 1);
+    EXPECT_EQ(index.GetContents()[1].size(), 2);
+    EXPECT_EQ(index.GetRescans(), 0);
+}
+
+//directories created and moved into watched tree are scanned and watched, removed ones are forgotten
+TEST_F(LiveIndexTest, DirectoryChanges)
+{
+    fl::LiveIndex index(m_searcher, { m_tree.Path("a"), m_tree.Path("b") });
+    index.Build();
+
+    fs::create_directories(m_tree.Root() / "out/sub/deeper");
+    m_tree.Put("out/sub/deeper/y", "other content");
+    fs::rename(m_tree.Root() / "out/sub", m_tree.Root() / "b/sub");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "b/x" }, { "a/y", "b/sub/deeper/y" } }));
+    EXPECT_EQ(index.GetRescans(), 1);
+
+    //subdirectory of moved directory is watched too
+    m_tree.Put("b/sub/deeper/x2", "same content");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "b/sub/deeper/x2", "b/x" }, { "a/y", "b/sub/deeper/y" } }));
+
+    fs::rename(m_tree.Root() / "b/sub", m_tree.Root() / "b/sub2");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "b/sub2/deeper/x2", "b/x" }, { "a/y", "b/sub2/deeper/y" } }));
+
+    fs::remove_all(m_tree.Root() / "b/sub2");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "b/x" } }));
+
+    fs::create_directories(m_tree.Root() / "a/new");
+    m_tree.Put("a/new/x3", "same content");
+    EXPECT_EQ(Clusters(index), (Result{ { "a/new/x3", "a/x", "b/x" } }));
+}
+
+//lost events are recovered by rescan, hashes of unchanged files are kept
+TEST_F(LiveIndexTest, Overflow)
+{
+    std::size_t max_events = 0;
+    std::ifstream("/proc/sys/fs/inotify/max_queued_events") >> max_events;
+    if (max_events == 0 || max_events > 100 * 1000) {
+        GTEST_SKIP() << "event queue is too long to overflow";
+    }
+
+    fl::LiveIndex index(m_searcher, { m_tree.Path("a"), m_tree.Path("b") });
+    index.Build();
+    EXPECT_EQ(Clusters(index).size(), 1);
+
+    //alternating events are not merged by kernel
+    const auto a = m_tree.Path("a/x");
+    const auto b = m_tree.Path("a/y");
+    for (std::size_t i = 0; i <= max_events; ++i) {
+        ::chmod(i % 2 ? a.c_str() : b.c_str(), i % 4 < 2 ? 0644 : 0600);
+    }
+    m_tree.Put("b/y", "other content");
+
+    const auto hashes = fl::Stats::Get(fl::Stats::Counter::FullHashes);
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "b/x" }, { "a/y", "b/y" } }));
+    EXPECT_GE(index.GetRescans(), 2);
+    //changed by chmod files have new ctime
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::FullHashes) - hashes, 3);
+}
+
+//one directory can be watched for several inputs
+TEST_F(LiveIndexTest, SameDirectory)
+{
+    fl::LiveIndex index(m_searcher, { m_tree.Path("a"), m_tree.Path("a") });
+    index.Build();
+    EXPECT_EQ(Clusters(index), (Result{ { "a/x", "a/x" }, { "a/y", "a/y" } }));
+
+    m_tree.Put("a/z", "third");
+    EXPECT_EQ(Clusters(index).size(), 3);
+    fs::remove(m_tree.Root() / "a/z");
+    EXPECT_EQ(Clusters(index).size(), 2);
+}
+
+TEST_F(LiveIndexTest, WrongDirectory)
+{
+    fl::LiveIndex index(m_searcher, { m_tree.Path("a"), m_tree.Path("no_such_dir") });
+    EXPECT_THROW(index.Build(), fs::filesystem_error);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
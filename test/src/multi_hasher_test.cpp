@@ -0,0 +1,183 @@
+#include <fstream>
+#include <iterator>
+
+#include "gtest/gtest.h"
+#include "md5_multi.h"
+#include "multi_hasher.h"
+#include "hasher.h"
+#include "io_scheduler.h"
+#include "searcher.h"
+#include "temp_tree.h"
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+namespace {
+    std::string Content(std::size_t size, std::size_t seed) {
+        std::string content(size, '\0');
+        for (std::size_t i = 0; i < size; ++i) {
+            content[i] = static_cast<char>((i * 31 + seed * 7 + i / 97) % 251);
+        }
+        return content;
+    }
+
+    fl::Digest Md5(const std::string& data) {
+        auto hasher = fl::Hasher::Create(fl::HashKind::MD5);
+        hasher->Add(data.data(), data.size());
+        return hasher->GetHash();
+    }
+}
+
+//every kernel supported by CPU gives the same digests as MD5 class for lengths around block and padding bounds
+TEST(MultiMD5, Kernels)
+{
+    using Kernel = fl::MultiMD5::Kernel;
+    for (auto kernel : { Kernel::Scalar, Kernel::SSE2, Kernel::AVX2, Kernel::AVX512 }) {
+        if (!fl::MultiMD5::IsSupported(kernel)) {
+            continue;
+        }
+        const auto lanes = fl::MultiMD5::LanesOf(kernel);
+        for (std::size_t size : { 0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000, 100 * 1000 + 3 }) {
+            for (std::size_t streams : { std::size_t{ 1 }, (lanes + 1) / 2, lanes }) {
+                std::vector<std::string> data;
+                std::vector<const void*> ptrs;
+                for (std::size_t s = 0; s < streams; ++s) {
+                    data.push_back(Content(size, s));
+                }
+
+                //data is added by uneven portions
+                fl::MultiMD5 md5(streams, kernel);
+                std::size_t pos = 0;
+                for (std::size_t step = 1; pos < size; step = step * 3 + 1) {
+                    const auto n = std::min(step, size - pos);
+                    ptrs.clear();
+                    for (const auto& d : data) {
+                        ptrs.push_back(d.data() + pos);
+                    }
+                    md5.Add(ptrs.data(), n);
+                    pos += n;
+                }
+
+                const auto hashes = md5.GetHashes();
+                ASSERT_EQ(hashes.size(), streams);
+                for (std::size_t s = 0; s < streams; ++s) {
+                    EXPECT_EQ(hashes[s], Md5(data[s])) << fl::MultiMD5::KernelName(kernel) << " size " << size << " stream " << s;
+                }
+            }
+        }
+    }
+}
+
+//files of the same size hashed together have the same MD5 as hashed one by one
+class MultiHasherTest : public testing::Test
+{
+protected:
+    void SetUp() override {
+        m_old_kind = fl::File::GetHashKind();
+        fl::File::SetHashKind(fl::HashKind::MD5);
+
+        std::size_t n = 0;
+        for (std::size_t size : { 0, 10, 4096, 300 * 1000 }) {
+            for (std::size_t k = 0; k < 20; ++k) {
+                const auto name = "f" + std::to_string(n++);
+                //some files are identical
+                m_tree.Put(name, Content(size, k % 7));
+                m_paths.push_back(m_tree.Path(name));
+            }
+        }
+        m_paths.push_back(TEST_DIR_PATH + "/f1");
+        m_paths.push_back(TEST_DIR_PATH + "/no_such_file");
+    }
+
+    void TearDown() override {
+        fl::File::SetHashKind(m_old_kind);
+    }
+
+    fl::HashKind                m_old_kind{ fl::HashKind::XXH3 };
+    TempTree                    m_tree{ "dups_multi_hasher_test" };
+    std::vector<std::string>    m_paths;
+};
+
+TEST_F(MultiHasherTest, Run)
+{
+    std::vector<fl::File> expected;
+    std::vector<fl::File> files;
+    for (const auto& p : m_paths) {
+        expected.emplace_back(p);
+        files.emplace_back(p);
+    }
+    std::vector<const fl::File*> ptrs;
+    for (const auto& f : files) {
+        ptrs.push_back(&f);
+    }
+
+    fl::ReadOptions options;
+    options.buffer_size = 1000;
+    std::size_t done = 0;
+    fl::MultiHasher(options).Run(ptrs, [&done](const fl::File*) { ++done; });
+    EXPECT_EQ(done, files.size());
+
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        EXPECT_EQ(files[i].IsOk(), expected[i].IsOk()) << m_paths[i];
+        EXPECT_EQ(files[i].GetHashSum(), expected[i].GetHashSum()) << m_paths[i];
+    }
+}
+
+TEST_F(MultiHasherTest, Batches)
+{
+    std::vector<fl::File> files;
+    for (const auto& p : m_paths) {
+        files.emplace_back(p);
+    }
+    std::vector<const fl::File*> ptrs;
+    for (const auto& f : files) {
+        ptrs.push_back(&f);
+    }
+
+    std::size_t total = 0;
+    for (const auto& batch : fl::MultiHasher::Batches(ptrs)) {
+        EXPECT_LE(batch.size(), fl::MultiHasher::Width());
+        for (const auto* f : batch) {
+            EXPECT_EQ(f->GetFileSize(), batch.front()->GetFileSize());
+            EXPECT_EQ(f->GetStamp().dev, batch.front()->GetStamp().dev);
+        }
+        total += batch.size();
+    }
+    EXPECT_EQ(total, files.size());
+}
+
+//searcher finds the same clusters with MD5 calculated in lanes
+TEST_F(MultiHasherTest, Searcher)
+{
+    //batches of rotational device are run by IoScheduler
+    const auto dev = fl::File(m_paths.front()).GetStamp().dev;
+    for (bool rotational : { false, true }) {
+        fl::IoScheduler::SetRotational(dev, rotational);
+        for (std::size_t jobs : { 1, 3 }) {
+            fl::DupsSearcher ds(jobs);
+            std::vector<std::vector<fl::File>> contents;
+            contents.push_back(ds.GetDirectoryContent(m_tree.Root().string()));
+            const auto clusters = ds.GetDuplicatedClusters(contents, 1);
+
+            //20 files of every size have 7 different contents
+            std::size_t non_empty = 0;
+            for (const auto& cl : clusters) {
+                if (cl.files.front().file->GetFileSize() != 0) {
+                    ++non_empty;
+                    for (const auto& tf : cl.files) {
+                        std::ifstream in(tf.file->GetFilePath(), std::ios::binary);
+                        const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                        EXPECT_EQ(tf.file->GetHashSum(), Md5(data));
+                    }
+                }
+            }
+            EXPECT_EQ(non_empty, 3 * 7);
+        }
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
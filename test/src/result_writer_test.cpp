@@ -0,0 +1,142 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "result_writer.h"
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+static std::string TempPath(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+//write all clusters of test dir and its d1 subdir in given format, return written bytes
+static std::string WriteResults(fl::OutputFormat format, bool pairs = false)
+{
+    fl::DupsSearcher ds;
+    std::vector<std::vector<fl::File>> contents;
+    contents.push_back(ds.GetDirectoryContent(TEST_DIR_PATH));
+    contents.push_back(ds.GetDirectoryContent(TEST_DIR_PATH + "/d1"));
+
+    const auto path = TempPath("dups_result_writer_test");
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    EXPECT_GE(fd, 0);
+    {
+        auto writer = fl::ResultWriter::Create(format, fd, pairs);
+        ds.GetDuplicatedClusters(contents, 2, [&writer](const fl::DupsSearcher::DupsCluster& cl) { writer->Write(cl); });
+    }
+    ::close(fd);
+
+    std::ifstream ifs(path, std::ios::binary);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    std::filesystem::remove(path);
+    return ss.str();
+}
+
+TEST(ResultWriter, ParseFormat)
+{
+    fl::OutputFormat format = fl::OutputFormat::Text;
+    EXPECT_TRUE(fl::ParseOutputFormat("jsonl", format));
+    EXPECT_EQ(format, fl::OutputFormat::JSONL);
+    EXPECT_TRUE(fl::ParseOutputFormat("binary", format));
+    EXPECT_EQ(format, fl::OutputFormat::Binary);
+    EXPECT_FALSE(fl::ParseOutputFormat("xml", format));
+}
+
+TEST(ResultWriter, OutputBuffer)
+{
+    const auto path = TempPath("dups_output_buffer_test");
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    {
+        //buffer is smaller than data
+        fl::OutputBuffer out(fd, 3);
+        out.Write("hello ");
+        out.Write(std::string("world"));
+        out.Put('\n');
+    }
+    ::close(fd);
+
+    std::ifstream ifs(path);
+    std::string line;
+    std::getline(ifs, line);
+    EXPECT_EQ(line, "hello world");
+    std::filesystem::remove(path);
+}
+
+TEST(ResultWriter, Text)
+{
+    auto res = WriteResults(fl::OutputFormat::Text, true);
+    EXPECT_NE(res.find(TEST_DIR_PATH + "/d1/f1 = " + TEST_DIR_PATH + "/f2\n"), std::string::npos);
+
+    res = WriteResults(fl::OutputFormat::Text);
+    EXPECT_EQ(res.find("[0] " + TEST_DIR_PATH + "/"), 0);
+    EXPECT_NE(res.find("\t= [1] " + TEST_DIR_PATH + "/d1/f1\n"), std::string::npos);
+}
+
+TEST(ResultWriter, JSONL)
+{
+    auto res = WriteResults(fl::OutputFormat::JSONL);
+    //one cluster - one line
+    ASSERT_FALSE(res.empty());
+    EXPECT_EQ(res.find('\n'), res.size() - 1);
+    EXPECT_EQ(res.find("{\"size\":"), 0);
+    EXPECT_NE(res.find("\"dirs\":2"), std::string::npos);
+    EXPECT_NE(res.find("{\"dir\":1,\"path\":\"" + TEST_DIR_PATH + "/d1/f1\"}"), std::string::npos);
+}
+
+TEST(ResultWriter, Nul)
+{
+    auto res = WriteResults(fl::OutputFormat::Nul);
+    //4 paths and end of cluster
+    EXPECT_EQ(std::count(res.begin(), res.end(), '\0'), 5);
+    EXPECT_EQ(res.substr(res.size() - 2), std::string(2, '\0'));
+}
+
+TEST(ResultWriter, Binary)
+{
+    auto res = WriteResults(fl::OutputFormat::Binary);
+    ASSERT_GT(res.size(), 8);
+    EXPECT_EQ(res.substr(0, 8), "DUPSRES1");
+
+    std::size_t pos = 8;
+    auto read = [&res, &pos](void* val, std::size_t len) {
+        ASSERT_LE(pos + len, res.size());
+        std::memcpy(val, res.data() + pos, len);
+        pos += len;
+    };
+
+    std::uint64_t size = 0;
+    std::uint8_t hash_size = 0;
+    std::uint32_t files = 0;
+    read(&size, sizeof(size));
+    read(&hash_size, sizeof(hash_size));
+    pos += hash_size;
+    read(&files, sizeof(files));
+    EXPECT_EQ(size, fl::File(TEST_DIR_PATH + "/f1").GetFileSize());
+    ASSERT_EQ(files, 4);
+
+    for (std::uint32_t i = 0; i < files; ++i) {
+        std::uint32_t dir = 0;
+        std::uint32_t len = 0;
+        read(&dir, sizeof(dir));
+        read(&len, sizeof(len));
+        pos += len;
+    }
+    EXPECT_EQ(pos, res.size());
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
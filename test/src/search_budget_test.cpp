@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "searcher.h"
+#include "temp_tree.h"
+
+namespace fs = std::filesystem;
+
+TEST(SearchBudget, Take)
+{
+    fl::SearchBudget budget;
+    budget.SetMaxRead(100);
+    EXPECT_TRUE(budget.Take(60));
+    EXPECT_TRUE(budget.Take(40));
+    EXPECT_EQ(budget.GetTaken(), 100);
+    EXPECT_FALSE(budget.IsExhausted());
+    //exhausted budget stays so even for files which would fit
+    EXPECT_FALSE(budget.Take(1));
+    EXPECT_TRUE(budget.IsExhausted());
+    EXPECT_FALSE(budget.Take(0));
+    EXPECT_FALSE(budget.IsCancelled());
+
+    //file bigger than the rest is refused alone
+    fl::SearchBudget partial;
+    partial.SetMaxRead(100);
+    EXPECT_FALSE(partial.Take(150));
+    EXPECT_FALSE(partial.IsExhausted());
+    EXPECT_TRUE(partial.Take(60));
+    EXPECT_FALSE(partial.Take(50));
+    EXPECT_TRUE(partial.Take(40));
+    EXPECT_EQ(partial.GetTaken(), 100);
+
+    fl::SearchBudget late;
+    late.SetDeadline(fl::SearchBudget::Clock::now());
+    EXPECT_FALSE(late.Take(0));
+    EXPECT_TRUE(late.IsExhausted());
+
+    fl::SearchBudget cancelled;
+    EXPECT_TRUE(cancelled.Take(1 << 30));
+    cancelled.Cancel();
+    EXPECT_FALSE(cancelled.Take(1));
+    EXPECT_TRUE(cancelled.IsCancelled());
+}
+
+//three pairs of duplicates between "a" and "b" of sizes bigger than two samples
+class BudgetedSearchTest : public testing::Test
+{
+protected:
+    static constexpr std::size_t SAMPLE = 4096;
+
+    void SetUp() override {
+        for (std::size_t size : { 20000, 30000, 40000 }) {
+            for (const auto* dir : { "a", "b" }) {
+                m_tree.Put(std::string(dir) + "/f" + std::to_string(size),
+                           std::string(size, static_cast<char>('a' + size / 10000)));
+            }
+        }
+        fl::File::SetSampleSize(SAMPLE);
+        m_options = fl::File::GetReadOptions();
+        m_kind = fl::File::GetHashKind();
+    }
+
+    void TearDown() override {
+        fl::File::SetReadOptions(m_options);
+        fl::File::SetHashKind(m_kind);
+    }
+
+    fl::DupsSearcher::PartialClusters Search(fl::SearchBudget& budget,
+                                             fl::DupsSearcher::CompareMode mode = fl::DupsSearcher::CompareMode::Hash) {
+        fl::DupsSearcher ds;
+        ds.SetCompareMode(mode);
+        m_contents.clear();
+        m_contents.push_back(ds.GetDirectoryContent(m_tree.Path("a")));
+        m_contents.push_back(ds.GetDirectoryContent(m_tree.Path("b")));
+        return ds.GetDuplicatedClusters(m_contents, 2, budget);
+    }
+
+    //every file is either in confirmed cluster of right files or unresolved
+    static void CheckCovered(const fl::DupsSearcher::PartialClusters& res) {
+        std::size_t files = 0;
+        for (const auto& cl : res.clusters) {
+            ASSERT_EQ(cl.files.size(), 2);
+            EXPECT_EQ(fs::path(cl.files[0].file->GetFilePath()).filename(),
+                      fs::path(cl.files[1].file->GetFilePath()).filename());
+            files += cl.files.size();
+        }
+        for (const auto& group : res.unresolved) {
+            ASSERT_FALSE(group.empty());
+            EXPECT_TRUE(std::all_of(group.begin(), group.end(), [&group](const fl::DupsSearcher::TaggedFile& tf) {
+                return tf.file->GetFileSize() == group.front().file->GetFileSize();
+            }));
+            files += group.size();
+        }
+        EXPECT_EQ(files, 6);
+    }
+
+    TempTree                                m_tree{ "dups_search_budget_test" };
+    std::vector<std::vector<fl::File>>      m_contents;
+    fl::ReadOptions                         m_options;
+    fl::HashKind                            m_kind{ fl::HashKind::XXH3 };
+};
+
+TEST_F(BudgetedSearchTest, Unlimited)
+{
+    fl::SearchBudget budget;
+    const auto res = Search(budget);
+    EXPECT_EQ(res.clusters.size(), 3);
+    EXPECT_TRUE(res.unresolved.empty());
+    CheckCovered(res);
+    EXPECT_EQ(budget.GetTaken(), 6 * 2 * SAMPLE + 2 * (20000 + 30000 + 40000));
+}
+
+//samples and one size group fit into budget, not all of them. Every engine admits files before reading
+TEST_F(BudgetedSearchTest, MaxRead)
+{
+    for (auto engine : { fl::IoEngine::Pread, fl::IoEngine::Uring }) {
+        for (auto kind : { fl::HashKind::XXH3, fl::HashKind::MD5 }) {
+            fl::ReadOptions options;
+            options.engine = engine;
+            fl::File::SetReadOptions(options);
+            fl::File::SetHashKind(kind);
+
+            fl::SearchBudget budget;
+            budget.SetMaxRead(6 * 2 * SAMPLE + 2 * 40000);
+            const auto res = Search(budget);
+            EXPECT_GE(res.clusters.size(), 1);
+            EXPECT_LT(res.clusters.size(), 3);
+            EXPECT_FALSE(res.unresolved.empty());
+            EXPECT_LE(budget.GetTaken(), 6 * 2 * SAMPLE + 2 * 40000);
+            CheckCovered(res);
+        }
+    }
+}
+
+//pairs which don't fit the rest of budget don't stop smaller pairs from being read
+TEST_F(BudgetedSearchTest, BigFileRefusedAlone)
+{
+    for (auto engine : { fl::IoEngine::Pread, fl::IoEngine::Uring }) {
+        fl::ReadOptions options;
+        options.engine = engine;
+        fl::File::SetReadOptions(options);
+
+        fl::SearchBudget budget;
+        budget.SetMaxRead(6 * 2 * SAMPLE + 2 * 20000);
+        const auto res = Search(budget);
+        ASSERT_EQ(res.clusters.size(), 1);
+        EXPECT_EQ(res.clusters.front().files.front().file->GetFileSize(), 20000);
+        EXPECT_EQ(res.unresolved.size(), 2);
+        EXPECT_EQ(budget.GetTaken(), 6 * 2 * SAMPLE + 2 * 20000);
+        CheckCovered(res);
+    }
+}
+
+//cancelled search reads nothing, all candidates are unresolved
+TEST_F(BudgetedSearchTest, Cancel)
+{
+    for (auto mode : { fl::DupsSearcher::CompareMode::Hash, fl::DupsSearcher::CompareMode::Bytes }) {
+        fl::SearchBudget budget;
+        budget.Cancel();
+        const auto res = Search(budget, mode);
+        EXPECT_TRUE(res.clusters.empty());
+        EXPECT_EQ(res.unresolved.size(), 3);
+        EXPECT_EQ(budget.GetTaken(), 0);
+        CheckCovered(res);
+    }
+}
+
+//deadline and cancellation stop files in the middle: pair of big sparse files would be read for seconds
+TEST_F(BudgetedSearchTest, StopInsideFile)
+{
+    constexpr std::uintmax_t BIG = 8ULL << 30;
+    for (const auto* dir : { "a", "b" }) {
+        const auto name = std::string(dir) + "/big";
+        m_tree.Put(name, "x");
+        fs::resize_file(m_tree.Path(name), BIG);
+    }
+    fl::File::SetHashKind(fl::HashKind::MD5);
+
+    using Clock = fl::SearchBudget::Clock;
+    constexpr auto DELAY = std::chrono::milliseconds(100);
+    for (auto engine : { fl::IoEngine::Pread, fl::IoEngine::Uring }) {
+        for (auto mode : { fl::DupsSearcher::CompareMode::Hash, fl::DupsSearcher::CompareMode::Bytes }) {
+            for (bool cancel : { false, true }) {
+                fl::ReadOptions options;
+                options.engine = engine;
+                fl::File::SetReadOptions(options);
+
+                fl::SearchBudget budget;
+                std::thread canceller;
+                if (cancel) {
+                    canceller = std::thread([&budget, DELAY]() {
+                        std::this_thread::sleep_for(DELAY);
+                        budget.Cancel();
+                    });
+                }
+                else {
+                    budget.SetDeadline(Clock::now() + DELAY);
+                }
+
+                const auto start = Clock::now();
+                const auto res = Search(budget, mode);
+                const auto elapsed = Clock::now() - start;
+                if (canceller.joinable()) {
+                    canceller.join();
+                }
+
+                EXPECT_LT(elapsed, std::chrono::seconds(2)) << static_cast<int>(engine) << static_cast<int>(mode) << cancel;
+                //small files can be done before the stop, big ones are unresolved but still valid
+                std::size_t big = 0;
+                for (const auto& group : res.unresolved) {
+                    for (const auto& tf : group) {
+                        if (tf.file->GetFileSize() == BIG) {
+                            EXPECT_TRUE(tf.file->IsOk());
+                            EXPECT_FALSE(tf.file->HasHashSum());
+                            ++big;
+                        }
+                    }
+                }
+                EXPECT_EQ(big, 2);
+                for (const auto& cl : res.clusters) {
+                    EXPECT_NE(cl.files.front().file->GetFileSize(), BIG);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "searcher.h"
+#include "dir_walker.h"
+#include "stats.h"
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+static std::vector<fl::DupsSearcher::TheSameFailsName> FindPairs(fl::DupsSearcher& ds,
+                                                                 const std::string& d1,
+                                                                 const std::string& d2)
+{
+    auto c1 = ds.GetDirectoryContent(d1);
+    auto c2 = ds.GetDirectoryContent(d2);
+    auto grouped = ds.GroupBySize(c1);
+    auto pairs = ds.GetDuplicatedPairs(c2, grouped);
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+TEST(DupsSearcher, DirectoryContent)
+{
+    fl::DupsSearcher ds;
+    auto content = ds.GetDirectoryContent(TEST_DIR_PATH);
+
+    //d1 is not a regular file
+    EXPECT_EQ(content.size(), 5);
+    for (const auto& f : content) {
+        EXPECT_TRUE(f.IsOk());
+    }
+}
+
+TEST(DupsSearcher, RecursiveDirectoryContent)
+{
+    fl::DupsSearcher ds(4);
+    ds.SetRecursive(true);
+    auto content = ds.GetDirectoryContent(TEST_DIR_PATH);
+
+    //5 files in root, 1 in d1, 2 in samples
+    EXPECT_EQ(content.size(), 8);
+}
+
+TEST(DupsSearcher, WrongDirectory)
+{
+    fl::DupsSearcher ds;
+    EXPECT_THROW(ds.GetDirectoryContent(TEST_DIR_PATH + "/f1"), std::filesystem::filesystem_error);
+    EXPECT_THROW(ds.GetDirectoryContent(TEST_DIR_PATH + "/no_such_dir"), std::filesystem::filesystem_error);
+}
+
+TEST(DirWalker, SymlinkLoop)
+{
+    namespace fs = std::filesystem;
+    const auto root = fs::temp_directory_path() / "dups_walker_loop";
+    fs::remove_all(root);
+    fs::create_directories(root / "a");
+    fs::copy_file(TEST_DIR_PATH + "/f1", root / "a" / "f");
+    //a/up -> .. makes a loop, b -> a is the same directory twice
+    fs::create_directory_symlink("..", root / "a" / "up");
+    fs::create_directory_symlink("a", root / "b");
+
+    fl::DirWalker::Options options;
+    options.jobs = 2;
+    auto files = fl::DirWalker(options).Walk(root.string());
+    EXPECT_EQ(files.size(), 1);
+
+    options.follow_symlinks = false;
+    files = fl::DirWalker(options).Walk(root.string());
+    EXPECT_EQ(files.size(), 1);
+
+    fs::remove_all(root);
+}
+
+TEST(DupsSearcher, DuplicatedPairs)
+{
+    fl::DupsSearcher ds;
+    auto pairs = FindPairs(ds, TEST_DIR_PATH, TEST_DIR_PATH + "/d1");
+
+    //d1/f1 is the same as f1, f1_link, f2
+    ASSERT_EQ(pairs.size(), 3);
+    for (const auto& p : pairs) {
+        EXPECT_EQ(p.first, TEST_DIR_PATH + "/d1/f1");
+    }
+}
+
+TEST(DupsSearcher, ParallelTheSameAsSerial)
+{
+    fl::DupsSearcher serial;
+    fl::DupsSearcher parallel(4);
+
+    auto p1 = FindPairs(serial, TEST_DIR_PATH, TEST_DIR_PATH);
+    auto p2 = FindPairs(parallel, TEST_DIR_PATH, TEST_DIR_PATH);
+
+    EXPECT_FALSE(p1.empty());
+    EXPECT_EQ(p1, p2);
+}
+
+TEST(DupsSearcher, SameInodePairs)
+{
+    namespace fs = std::filesystem;
+    const auto root = fs::temp_directory_path() / "dups_same_inode";
+    fs::remove_all(root);
+    fs::create_directories(root / "a");
+    fs::create_directories(root / "b");
+    fs::copy_file(TEST_DIR_PATH + "/f1", root / "a" / "f");
+    fs::create_hard_link(root / "a" / "f", root / "b" / "hard");
+    fs::copy_file(TEST_DIR_PATH + "/f1", root / "b" / "copy");
+
+    for (std::size_t jobs : { 1, 2 }) {
+        fl::DupsSearcher ds(jobs);
+        auto a = ds.GetDirectoryContent((root / "a").string());
+        auto b = ds.GetDirectoryContent((root / "b").string());
+
+        std::vector<fl::DupsSearcher::TheSameFailsName> same_inode;
+        auto pairs = ds.GetDuplicatedPairs(b, ds.GroupBySize(a), &same_inode);
+
+        ASSERT_EQ(pairs.size(), 1);
+        EXPECT_EQ(pairs[0].first, (root / "b" / "copy").string());
+        ASSERT_EQ(same_inode.size(), 1);
+        EXPECT_EQ(same_inode[0].first, (root / "b" / "hard").string());
+
+        //without separate list links are usual duplicates
+        EXPECT_EQ(ds.GetDuplicatedPairs(b, ds.GroupBySize(a)).size(), 2);
+    }
+
+    fs::remove_all(root);
+}
+
+//size group of links to one inode is reported without reading it
+TEST(DupsSearcher, SameInodeNotRead)
+{
+    namespace fs = std::filesystem;
+    const auto root = fs::temp_directory_path() / "dups_same_inode_not_read";
+    fs::remove_all(root);
+    fs::create_directories(root / "a");
+    fs::create_directories(root / "b");
+    std::ofstream(root / "a" / "f", std::ios::binary) << std::string(300000, 'x');
+    fs::create_hard_link(root / "a" / "f", root / "b" / "hard");
+
+    fl::DupsSearcher ds;
+    std::vector<std::vector<fl::File>> contents;
+    contents.push_back(ds.GetDirectoryContent((root / "a").string()));
+    contents.push_back(ds.GetDirectoryContent((root / "b").string()));
+
+    const auto read = fl::Stats::Get(fl::Stats::Counter::BytesRead);
+    const auto avoided = fl::Stats::Get(fl::Stats::Counter::AvoidedByInode);
+    std::vector<fl::DupsSearcher::TheSameFailsName> same_inode;
+    EXPECT_TRUE(ds.GetDuplicatedPairs(contents[1], ds.GroupBySize(contents[0]), &same_inode).empty());
+    ASSERT_EQ(same_inode.size(), 1);
+    EXPECT_EQ(same_inode[0].first, (root / "b" / "hard").string());
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::AvoidedByInode) - avoided, 2);
+
+    for (auto mode : { fl::DupsSearcher::CompareMode::Hash, fl::DupsSearcher::CompareMode::Bytes }) {
+        ds.SetCompareMode(mode);
+        const auto clusters = ds.GetDuplicatedClusters(contents, 2);
+        ASSERT_EQ(clusters.size(), 1);
+        EXPECT_EQ(clusters[0].files.size(), 2);
+        EXPECT_TRUE(clusters[0].shared);
+    }
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::BytesRead), read);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::AvoidedByInode) - avoided, 6);
+
+    fs::remove_all(root);
+}
+
+TEST(DupsSearcher, DuplicatedClasses)
+{
+    fl::DupsSearcher ds;
+    auto c1 = ds.GetDirectoryContent(TEST_DIR_PATH);
+    auto c2 = ds.GetDirectoryContent(TEST_DIR_PATH);
+    //classes refer to grouped files, they must be alive
+    auto grouped = ds.GroupBySize(c1);
+    auto classes = ds.GetDuplicatedClasses(c2, grouped);
+
+    //f1, f1_link, f2 are one class; empty_f and another_f match only themselves
+    ASSERT_EQ(classes.size(), 3);
+    std::size_t total = 0;
+    for (const auto& cl : classes) {
+        EXPECT_EQ(cl.content_files.size(), cl.grouped_files.size());
+        for (const auto* f : cl.grouped_files) {
+            EXPECT_EQ(f->GetHashSum(), cl.content_files.front()->GetHashSum());
+        }
+        total += cl.content_files.size();
+    }
+    EXPECT_EQ(total, 5);
+}
+
+TEST(DupsSearcher, DuplicatedClusters)
+{
+    fl::DupsSearcher ds;
+    std::vector<std::vector<fl::File>> contents;
+    contents.push_back(ds.GetDirectoryContent(TEST_DIR_PATH));
+    contents.push_back(ds.GetDirectoryContent(TEST_DIR_PATH + "/d1"));
+    contents.push_back(ds.GetDirectoryContent(TEST_DIR_PATH + "/samples"));
+
+    //f1, f1_link, f2 of root and d1/f1; mid_a and mid_b differ only in the middle
+    auto clusters = ds.GetDuplicatedClusters(contents, 2);
+    ASSERT_EQ(clusters.size(), 1);
+    EXPECT_EQ(clusters[0].dirs_num, 2);
+    ASSERT_EQ(clusters[0].files.size(), 4);
+    EXPECT_EQ(clusters[0].files.front().dir_idx, 0);
+    EXPECT_EQ(clusters[0].files.back().dir_idx, 1);
+    EXPECT_EQ(clusters[0].files.back().file->GetFilePath(), TEST_DIR_PATH + "/d1/f1");
+
+    EXPECT_EQ(ds.GetDuplicatedClusters(contents, 1).size(), 1);
+    //nothing is present in all dirs
+    EXPECT_TRUE(ds.GetDuplicatedClusters(contents, contents.size()).empty());
+
+    contents[2] = ds.GetDirectoryContent(TEST_DIR_PATH + "/d1");
+    clusters = fl::DupsSearcher(0).GetDuplicatedClusters(contents, contents.size());
+    ASSERT_EQ(clusters.size(), 1);
+    EXPECT_EQ(clusters[0].dirs_num, 3);
+    EXPECT_EQ(clusters[0].files.size(), 5);
+}
+
+TEST(DupsSearcher, DuplicatedFiles)
+{
+    fl::DupsSearcher ds(0);
+    auto c1 = ds.GetDirectoryContent(TEST_DIR_PATH + "/d1");
+    auto c2 = ds.GetDirectoryContent(TEST_DIR_PATH);
+    auto files = ds.GetDuplicatedFiles(c2, ds.GroupBySize(c1));
+
+    //f1, f1_link and f2 have duplicate in d1
+    EXPECT_EQ(files.size(), 3);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
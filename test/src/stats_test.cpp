@@ -0,0 +1,62 @@
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "stats.h"
+#include "searcher.h"
+
+const std::string TEST_DIR_PATH{ TEST_FILES_DIR };
+
+TEST(Stats, Counters)
+{
+    fl::Stats::Reset();
+    fl::DupsSearcher ds;
+    auto c1 = ds.GetDirectoryContent(TEST_DIR_PATH);
+    auto c2 = ds.GetDirectoryContent(TEST_DIR_PATH + "/d1");
+    auto grouped = ds.GroupBySize(c1);
+    auto pairs = ds.GetDuplicatedPairs(c2, grouped);
+    ASSERT_EQ(pairs.size(), 3);
+
+    EXPECT_GE(fl::Stats::Get(fl::Stats::Counter::StatCalls), c1.size() + c2.size());
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::DirsRead), 2);
+    //another_f and empty_f have no pair of the same size
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::AvoidedBySize), 2);
+    //f1, f1_link, f2 and d1/f1 are read once: they are smaller than sample, so sample hash is the full one
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::FilesOpened), 4);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::FullHashes), 4);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::LinksShared), 0);
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::BytesRead), 4 * c2.front().GetFileSize());
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::BytesHashed), fl::Stats::Get(fl::Stats::Counter::BytesRead));
+    EXPECT_GT(fl::Stats::GetWallTime(fl::Stats::Phase::Scan), 0);
+    EXPECT_GT(fl::Stats::GetPeakRss(), 0);
+
+    fl::Stats::Reset();
+    EXPECT_EQ(fl::Stats::Get(fl::Stats::Counter::StatCalls), 0);
+    EXPECT_EQ(fl::Stats::GetWallTime(fl::Stats::Phase::Scan), 0);
+}
+
+TEST(Stats, Reports)
+{
+    fl::Stats::Reset();
+    fl::Stats::Add(fl::Stats::Counter::BytesRead, 42);
+    fl::Stats::AddTime(fl::Stats::Phase::FullHash, 1500000000, 1000000000);
+
+    std::ostringstream json;
+    fl::Stats::PrintJson(json);
+    EXPECT_EQ(json.str().find("{\"phases\":{\"scan\":"), 0);
+    EXPECT_NE(json.str().find("\"full_hash\":{\"wall_ns\":1500000000,\"cpu_ns\":1000000000}"), std::string::npos);
+    EXPECT_NE(json.str().find("\"bytes_read\":42"), std::string::npos);
+    EXPECT_NE(json.str().find("\"peak_rss_bytes\":"), std::string::npos);
+
+    std::ostringstream summary;
+    fl::Stats::PrintSummary(summary);
+    EXPECT_NE(summary.str().find("full_hash"), std::string::npos);
+    EXPECT_NE(summary.str().find("1500.000 / 1000.000"), std::string::npos);
+    EXPECT_NE(summary.str().find("peak_rss_bytes"), std::string::npos);
+}
+
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,54 @@
+#ifndef __TEMP_TREE_H__
+#define __TEMP_TREE_H__
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+//Temporary directory of one test, removed with its content on destruction.
+//Its name is unique (mkdtemp), so tests run in parallel by ctest -j don't touch trees of each other
+class TempTree
+{
+public:
+    //directory prefix_XXXXXX in parent, temp_directory_path() by default
+    explicit TempTree(const std::string& prefix,
+                      const std::filesystem::path& parent = std::filesystem::temp_directory_path()) {
+        auto name = (parent / (prefix + "_XXXXXX")).string();
+        if (!::mkdtemp(name.data())) {
+            throw std::runtime_error("can't create temporary directory " + name);
+        }
+        m_root = name;
+    }
+
+    ~TempTree() {
+        std::error_code ec;
+        std::filesystem::remove_all(m_root, ec);
+    }
+
+    TempTree(const TempTree&) = delete;
+    TempTree& operator=(const TempTree&) = delete;
+
+    const std::filesystem::path& Root() const {
+        return m_root;
+    }
+
+    //path of name relative to the root
+    std::string Path(const std::string& name) const {
+        return (m_root / name).string();
+    }
+
+    //write file, its parent directories are created
+    void Put(const std::string& name, const std::string& content) const {
+        const auto path = m_root / name;
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << content;
+    }
+
+private:
+    std::filesystem::path   m_root;
+};
+
+#endif // ! __TEMP_TREE_H__